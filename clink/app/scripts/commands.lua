@@ -6,9 +6,10 @@
 
 --------------------------------------------------------------------------------
 local function collect_number_matches()
-    local matches = console.screengrab("[^%w]*(%w%w[%w]+)", "^%x+$")
-    matches["nosort"] = true
-    rl.setmatches(matches, "word")
+    -- Like passing console.screengrab("[^%w]*(%w%w[%w]+)", "^%x+$") to
+    -- rl.setmatches() with "nosort", but the screen is scanned natively and
+    -- duplicate numbers are skipped.
+    rl.set_number_matches()
 end
 
 --------------------------------------------------------------------------------
@@ -98,6 +99,7 @@ function clink._diagnostics(rl_buffer)
         clink._diag_classifiers()
         clink._diag_suggesters()
     end
+    clink._diag_profile()
     if clink._diag_custom then
         clink._diag_custom(arg)
     end
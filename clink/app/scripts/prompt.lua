@@ -11,6 +11,7 @@ local prompt_filters_unsorted = false
 --------------------------------------------------------------------------------
 local prompt_filter_current = nil       -- Current running prompt filter.
 local prompt_filter_coroutines = {}     -- Up to one coroutine per prompt filter, with cached return value.
+local prompt_filter_cache = {}          -- Last output per filter function, for filters that declare dependencies.
 
 --------------------------------------------------------------------------------
 local function set_current_prompt_filter(filter)
@@ -20,6 +21,73 @@ end
 
 
 
+--------------------------------------------------------------------------------
+-- Builds a key from the input prompt string plus the current values of the
+-- dependencies declared in filter.cachedeps.  Returns nil if the filter doesn't
+-- declare dependencies.
+local function get_cache_key(filter, input)
+    local deps = filter.cachedeps
+    if type(deps) ~= "table" then
+        return
+    end
+
+    local parts = { input or "" }
+    if deps.cwd then
+        table.insert(parts, os.getcwd())
+    end
+    if deps.errorlevel then
+        table.insert(parts, tostring(os.geterrorlevel()))
+    end
+    if deps.env then
+        for _,name in ipairs(deps.env) do
+            table.insert(parts, name.."="..(os.getenv(name) or ""))
+        end
+    end
+    if deps.files then
+        local files = deps.files
+        if type(files) == "function" then
+            files = files() or {}
+        end
+        for _,file in ipairs(files) do
+            table.insert(parts, file.."@"..(clink.get_file_stamp(file) or ""))
+        end
+    end
+    if deps.key then
+        table.insert(parts, tostring(deps.key()))
+    end
+
+    return table.concat(parts, "\0")
+end
+
+--------------------------------------------------------------------------------
+-- Calls a filter function, or reuses its previous output if the filter
+-- declares dependencies and none of them have changed.
+local function call_filter(call, filter, func, input)
+    local key = get_cache_key(filter, input)
+    if key then
+        local cached = prompt_filter_cache[func]
+        if cached and cached.key == key then
+            return cached.filtered, cached.onwards
+        end
+    end
+
+    local filtered, onwards = call(func, filter, input)
+
+    if key then
+        -- Don't cache intermediate output while the filter's prompt coroutine
+        -- is still running; the final output is cached when the coroutine
+        -- finishes and triggers the prompt to be filtered again.
+        local entry = prompt_filter_coroutines[filter]
+        if entry and not entry.done then
+            prompt_filter_cache[func] = nil
+        else
+            prompt_filter_cache[func] = { key=key, filtered=filtered, onwards=onwards }
+        end
+    end
+
+    return filtered, onwards
+end
+
 --------------------------------------------------------------------------------
 local function _do_filter_prompt(type, prompt, rprompt)
     -- Sort by priority if required.
@@ -36,6 +104,7 @@ local function _do_filter_prompt(type, prompt, rprompt)
     -- Protected call to prompt filters.
     local impl = function(prompt, rprompt)
         local filtered, onwards
+        local call = _profile_caller("promptfilter")
         for _, filter in ipairs(prompt_filters) do
             set_current_prompt_filter(filter)
 
@@ -46,7 +115,7 @@ local function _do_filter_prompt(type, prompt, rprompt)
             local func
             func = filter[filter_func_name]
             if func or #type == 0 then
-                filtered, onwards = func(filter, prompt)
+                filtered, onwards = call_filter(call, filter, func, prompt)
                 if filtered ~= nil then
                     prompt = filtered
                     if onwards == false then return prompt, rprompt end
@@ -55,7 +124,7 @@ local function _do_filter_prompt(type, prompt, rprompt)
 
             func = filter[right_filter_func_name]
             if func then
-                filtered, onwards = func(filter, rprompt)
+                filtered, onwards = call_filter(call, filter, func, rprompt)
                 if filtered ~= nil then
                     rprompt = filtered
                     if onwards == false then return prompt, rprompt end
@@ -117,6 +186,22 @@ end
 --- -show:  &nbsp;   -- Insert the date at the beginning of the prompt.
 --- -show:  &nbsp;   return os.date("%a %H:%M").." "..prompt
 --- -show:  end
+---
+--- In Clink v1.3.1 and higher, a prompt filter can set a
+--- <code>cachedeps</code> field on the promptfilter object to declare what its
+--- output depends on.  Clink then reuses the filter's previous output instead
+--- of calling the filter again, as long as the input prompt string and all of
+--- the declared dependencies are unchanged.  This also avoids starting a new
+--- <a href="#clink.promptcoroutine">clink.promptcoroutine()</a> when the
+--- previous result is still valid.  The <code>cachedeps</code> table can contain:
+--- -show:  local git_prompt = clink.promptfilter(50)
+--- -show:  git_prompt.cachedeps = {
+--- -show:  &nbsp;   cwd = true,                 -- The current directory.
+--- -show:  &nbsp;   errorlevel = true,          -- The exit code from the previous command.
+--- -show:  &nbsp;   env = { "GIT_DIR" },        -- Values of environment variables.
+--- -show:  &nbsp;   files = { ".git/HEAD" },    -- Modified times and sizes of files (or a function that returns a table of files).
+--- -show:  &nbsp;   key = function() ... end,   -- A function that returns any other value the output depends on.
+--- -show:  }
 function clink.promptfilter(priority)
     if priority == nil then priority = 999 end
 
@@ -12,13 +12,14 @@ local function _do_suggest(line, matches)
     -- Protected call to suggesters.
     local impl = function(line, matches)
         local suggested, onwards
+        local call = _profile_caller("suggester")
         local strategy = settings.get("autosuggest.strategy"):explode()
         for _, name in ipairs(strategy) do
             local suggester = suggesters[name]
             if suggester then
                 local func = suggester.suggest
                 if func then
-                    suggested, suggested_line = func(suggester, line, matches)
+                    suggested, suggested_line = call(func, suggester, line, matches)
                     if suggested ~= nil then
                         return suggested, suggested_line
                     end
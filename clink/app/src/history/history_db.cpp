@@ -1369,8 +1369,18 @@ template <typename T> void history_db::for_each_session(T&& callback) const
 //------------------------------------------------------------------------------
 void history_db::load_internal()
 {
+    // Expect about as many lines as last time, and at most as many bytes as
+    // the bank files hold.  Readline sizes its history list up front and
+    // allocates the entries in bulk.
+    const size_t prev_count = m_index_map.size();
+    size_t bytes = 0;
+    for (const auto& handles : m_bank_handles)
+        if (handles.m_handle_lines)
+            bytes += GetFileSize(handles.m_handle_lines, nullptr);
+
     clear_history();
     m_index_map.clear();
+    m_index_map.reserve(prev_count);
     m_master_len = 0;
     m_master_deleted_count = 0;
 
@@ -1378,6 +1388,8 @@ void history_db::load_internal()
 
     DIAG("... loading history\n");
 
+    begin_history_batch(int(prev_count), bytes);
+
     const history_db& const_this = *this;
     const_this.for_each_bank([&] (unsigned int bank_index, const read_lock& lock)
     {
@@ -1389,19 +1401,14 @@ void history_db::load_internal()
             extract_ctag(lock, m_master_ctag);
         }
 
-        // Subtract 1 from the size to accommodate the forced NUL termination
-        // prior to calling add_history.
-        read_lock::line_iter iter(lock, buffer.data(), buffer.size() - 1);
+        read_lock::line_iter iter(lock, buffer.data(), buffer.size());
 
         str_iter out;
         line_id_impl id;
         unsigned int num_lines = 0;
         while (id = iter.next(out))
         {
-            const char* line = out.get_pointer();
-            int buffer_offset = int(line - buffer.data());
-            buffer.data()[buffer_offset + out.length()] = '\0';
-            add_history(line);
+            add_history_batch(out.get_pointer(), out.length());
 
             num_lines++;
 
@@ -1422,6 +1429,8 @@ void history_db::load_internal()
         return true;
     });
 
+    end_history_batch();
+
     DIAG("... total lines active %zu\n", m_index_map.size());
 }
 
@@ -1431,11 +1440,11 @@ void history_db::load_rl_history(bool can_clean)
     load_internal();
 
     // The `clink history` command needs to be able to avoid cleaning the master
-    // history file.
+    // history file.  Only reload if compacting actually changed anything.
     if (can_clean && m_use_master_bank)
     {
-        compact();
-        load_internal();
+        if (compact())
+            load_internal();
     }
 }
 
@@ -1464,16 +1473,19 @@ void history_db::clear()
 }
 
 //------------------------------------------------------------------------------
-void history_db::compact(bool force, bool uniq, int _limit)
+// Returns true if any lines were removed or the master bank was rewritten.
+bool history_db::compact(bool force, bool uniq, int _limit)
 {
     if (!m_use_master_bank)
     {
         assert(false);
         LOG("History:  compact is disabled because master bank is disabled");
         DIAG("... compact:  nothing to do because master bank is disabled");
-        return;
+        return false;
     }
 
+    bool changed = false;
+
     const bool explicit_limit = (_limit >= 0);
 
     size_t limit;
@@ -1516,6 +1528,7 @@ void history_db::compact(bool force, bool uniq, int _limit)
             }
             LOG("History:  removed %u", removed);
             DIAG("... ... lines removed %u\n", removed);
+            changed = (removed > 0);
         }
     }
 
@@ -1525,6 +1538,7 @@ void history_db::compact(bool force, bool uniq, int _limit)
     if (force || m_master_deleted_count > threshold)
     {
         DIAG("... compact:  rewrite master bank\n");
+        changed = true;
 
         size_t kept, deleted, dups;
         assert(!m_master_ctag.empty());
@@ -1637,6 +1651,8 @@ void history_db::compact(bool force, bool uniq, int _limit)
     {
         DIAG("... skip compact; threshold is %zu, actual marked for delete is %zu\n", threshold, m_master_deleted_count);
     }
+
+    return changed;
 }
 
 //------------------------------------------------------------------------------
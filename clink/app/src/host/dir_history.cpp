@@ -0,0 +1,310 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "dir_history.h"
+
+#include <core/base.h>
+#include <core/os.h>
+#include <core/path.h>
+
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+// Reads a whole line, however long it is.
+static bool read_line(FILE* in, str_base& out)
+{
+    out.clear();
+
+    char buffer[1024];
+    while (fgets(buffer, sizeof_array(buffer), in))
+    {
+        out.concat(buffer);
+        if (out.length() && out.c_str()[out.length() - 1] == '\n')
+            break;
+    }
+
+    return !out.empty();
+}
+
+//------------------------------------------------------------------------------
+dir_history::dir_history(unsigned int capacity)
+: m_capacity(max<unsigned int>(capacity, 1))
+{
+}
+
+//------------------------------------------------------------------------------
+void dir_history::clear()
+{
+    m_entries.clear();
+    m_index.clear();
+    m_count = 0;
+    m_oldest = -1;
+    m_newest = -1;
+}
+
+//------------------------------------------------------------------------------
+void dir_history::set_capacity(unsigned int capacity)
+{
+    capacity = max<unsigned int>(capacity, 1);
+    if (capacity == m_capacity)
+        return;
+
+    // Shrinking drops the least recently used directories.  Slots are reused
+    // in place, so changing the capacity rebuilds the ring.
+    std::vector<entry> entries;
+    entries.reserve(m_count);
+    for (int i = m_oldest; i >= 0; i = m_entries[i].next)
+        entries.emplace_back(std::move(m_entries[i]));
+
+    clear();
+    m_capacity = capacity;
+
+    const size_t skip = (entries.size() > capacity) ? entries.size() - capacity : 0;
+    for (size_t i = skip; i < entries.size(); ++i)
+        insert(entries[i].dir.c_str(), entries[i].visits, entries[i].last);
+}
+
+//------------------------------------------------------------------------------
+// Returns whether the history changed.
+bool dir_history::add(const char* dir, long long now)
+{
+    if (!dir || !*dir)
+        return false;
+
+    // Staying in the same directory isn't another visit.
+    std::string key;
+    make_key(dir, key);
+    if (m_newest >= 0 && m_entries[m_newest].key == key)
+        return false;
+
+    insert(dir, 1, now);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void dir_history::insert(const char* dir, unsigned int visits, long long last)
+{
+    std::string key;
+    make_key(dir, key);
+
+    int index;
+    const auto found = m_index.find(key);
+    const bool existing = (found != m_index.end());
+    if (existing)
+    {
+        // Move to the most recent position.
+        index = found->second;
+        unlink(index);
+        visits += m_entries[index].visits;
+    }
+    else if (m_count < m_capacity)
+    {
+        index = int(m_entries.size());
+        m_entries.emplace_back();
+        m_count++;
+    }
+    else
+    {
+        // Reuse the least recently used slot.
+        index = m_oldest;
+        unlink(index);
+        m_index.erase(m_entries[index].key);
+    }
+
+    entry& e = m_entries[index];
+    e.dir = dir;
+    e.visits = visits;
+    e.last = last;
+    if (!existing)
+    {
+        e.key = std::move(key);
+        m_index.emplace(e.key, index);
+    }
+
+    link_newest(index);
+}
+
+//------------------------------------------------------------------------------
+// Returns the directory used before the current one, for `cd -`.
+const char* dir_history::get_previous() const
+{
+    if (m_newest < 0)
+        return nullptr;
+
+    const int prev = m_entries[m_newest].prev;
+    return (prev >= 0) ? m_entries[prev].dir.c_str() : nullptr;
+}
+
+//------------------------------------------------------------------------------
+// Gets the directories from least to most recently used.
+void dir_history::get_dirs(std::vector<const char*>& out) const
+{
+    out.clear();
+    out.reserve(m_count);
+    for (int i = m_oldest; i >= 0; i = m_entries[i].next)
+        out.push_back(m_entries[i].dir.c_str());
+}
+
+//------------------------------------------------------------------------------
+// Gets the directories from lowest to highest frecency.  Directories with the
+// same score are ordered from least to most recently used.
+void dir_history::get_ranked(std::vector<const char*>& out, long long now) const
+{
+    std::vector<std::pair<double, int>> ranked;
+    ranked.reserve(m_count);
+    for (int i = m_oldest; i >= 0; i = m_entries[i].next)
+        ranked.emplace_back(get_score(m_entries[i], now), i);
+
+    std::stable_sort(ranked.begin(), ranked.end(), [] (const std::pair<double, int>& a, const std::pair<double, int>& b) {
+        return a.first < b.first;
+    });
+
+    out.clear();
+    out.reserve(m_count);
+    for (const auto& r : ranked)
+        out.push_back(m_entries[r.second].dir.c_str());
+}
+
+//------------------------------------------------------------------------------
+// The file has one directory per line, from least to most recently used, as
+// "visits<tab>last<tab>dir".
+bool dir_history::load(const char* file)
+{
+    FILE* in = fopen(file, "rb");
+    if (!in)
+        return false;
+
+    clear();
+
+    str<> line;
+    while (read_line(in, line))
+    {
+        while (line.length() && (line.c_str()[line.length() - 1] == '\n' || line.c_str()[line.length() - 1] == '\r'))
+            line.truncate(line.length() - 1);
+
+        char* next;
+        const unsigned int visits = strtoul(line.c_str(), &next, 10);
+        if (*next != '\t')
+            continue;
+
+        const long long last = _strtoi64(next + 1, &next, 10);
+        if (*next != '\t' || !next[1] || !visits)
+            continue;
+
+        insert(next + 1, visits, last);
+    }
+
+    fclose(in);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Other sessions may have saved the file since this history was loaded, so
+// directories in the file that this history doesn't have are merged in by when
+// they were last used.  For directories in both, this history's entry wins, so
+// visits another session counted in the meantime are lost (last writer wins).
+// The file is written to a temp file and renamed over the original, so readers
+// never see a partially written file.
+bool dir_history::save(const char* file) const
+{
+    dir_history disk(m_capacity);
+    disk.load(file);
+
+    // Sort rather than merge, since the clock may have gone backwards and
+    // then neither list is in order by last use.
+    std::vector<const entry*> merged;
+    merged.reserve(disk.m_count + m_count);
+    for (int i = disk.m_oldest; i >= 0; i = disk.m_entries[i].next)
+        if (m_index.find(disk.m_entries[i].key) == m_index.end())
+            merged.push_back(&disk.m_entries[i]);
+    for (int i = m_oldest; i >= 0; i = m_entries[i].next)
+        merged.push_back(&m_entries[i]);
+
+    std::stable_sort(merged.begin(), merged.end(), [] (const entry* a, const entry* b) {
+        return a->last < b->last;
+    });
+
+    // The temp file goes next to the file so it can be renamed in place.
+    str<280> dir;
+    if (!path::get_directory(file, dir) || dir.empty())
+        dir = ".";
+    str<280> tmp;
+    FILE* out = os::create_temp_file(&tmp, "dirs", ".tmp", os::binary, dir.c_str());
+    if (!out)
+        return false;
+
+    const size_t skip = (merged.size() > m_capacity) ? merged.size() - m_capacity : 0;
+    for (size_t i = skip; i < merged.size(); ++i)
+    {
+        const entry& e = *merged[i];
+        fprintf(out, "%u\t%lld\t%s\n", e.visits, e.last, e.dir.c_str());
+    }
+
+    bool ok = !ferror(out);
+    ok = (fclose(out) == 0) && ok;
+    ok = ok && os::move(tmp.c_str(), file, true/*replace*/);
+
+    if (!ok)
+        os::unlink(tmp.c_str());
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+void dir_history::unlink(int index)
+{
+    entry& e = m_entries[index];
+    if (e.prev >= 0)
+        m_entries[e.prev].next = e.next;
+    else
+        m_oldest = e.next;
+    if (e.next >= 0)
+        m_entries[e.next].prev = e.prev;
+    else
+        m_newest = e.prev;
+    e.prev = e.next = -1;
+}
+
+//------------------------------------------------------------------------------
+void dir_history::link_newest(int index)
+{
+    entry& e = m_entries[index];
+    e.prev = m_newest;
+    e.next = -1;
+    if (m_newest >= 0)
+        m_entries[m_newest].next = index;
+    else
+        m_oldest = index;
+    m_newest = index;
+}
+
+//------------------------------------------------------------------------------
+// Directories are compared caselessly, like file names.
+void dir_history::make_key(const char* dir, std::string& out)
+{
+    out.clear();
+    for (; *dir; ++dir)
+    {
+        char c = *dir;
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        out.push_back(c);
+    }
+}
+
+//------------------------------------------------------------------------------
+double dir_history::get_score(const entry& e, long long now)
+{
+    const long long age = now - e.last;
+    double weight;
+    if (age < 60 * 60)
+        weight = 4;
+    else if (age < 24 * 60 * 60)
+        weight = 2;
+    else if (age < 7 * 24 * 60 * 60)
+        weight = 0.5;
+    else
+        weight = 0.25;
+
+    return e.visits * weight;
+}
@@ -0,0 +1,61 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <core/str.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Recently used directories, ordered from least to most recently used.
+//
+// The history holds up to a fixed number of directories.  Adding a directory
+// that's already present moves it to the most recent position instead of
+// adding a duplicate (directories are compared caselessly), and when the
+// history is full the least recently used directory is dropped.  Each
+// directory also counts its visits so the directories can be ranked by
+// "frecency", a combination of how frequently and how recently they were used.
+class dir_history
+{
+public:
+                    dir_history(unsigned int capacity=100);
+    void            clear();
+    void            set_capacity(unsigned int capacity);
+    unsigned int    get_capacity() const { return m_capacity; }
+    unsigned int    size() const { return m_count; }
+
+    bool            add(const char* dir, long long now);
+    const char*     get_previous() const;
+    void            get_dirs(std::vector<const char*>& out) const;
+    void            get_ranked(std::vector<const char*>& out, long long now) const;
+
+    bool            load(const char* file);
+    bool            save(const char* file) const;
+
+private:
+    struct entry
+    {
+        str_moveable dir;
+        std::string key;
+        long long   last = 0;
+        unsigned int visits = 0;
+        int         prev = -1;
+        int         next = -1;
+    };
+
+    void            insert(const char* dir, unsigned int visits, long long last);
+    void            unlink(int index);
+    void            link_newest(int index);
+    static void     make_key(const char* dir, std::string& out);
+    static double   get_score(const entry& e, long long now);
+
+    std::vector<entry> m_entries;
+    std::unordered_map<std::string, int> m_index;
+    unsigned int    m_capacity;
+    unsigned int    m_count = 0;
+    int             m_oldest = -1;
+    int             m_newest = -1;
+};
@@ -4,6 +4,7 @@
 #include "pch.h"
 #include "host.h"
 #include "host_lua.h"
+#include "dir_history.h"
 #include "version.h"
 
 #include <core/globber.h>
@@ -29,6 +30,7 @@
 
 #include <list>
 #include <memory>
+#include <time.h>
 
 extern "C" {
 #include <lua.h>
@@ -97,6 +99,23 @@ setting_bool g_save_history(
     "Changing this setting only takes effect for new instances.",
     true);
 
+static setting_int g_max_dirs(
+    "history.max_dirs",
+    "The number of recent directories to remember",
+    "The number of recent directories to remember for 'cd -' and the\n"
+    "clink-popup-directories command, or 0 for the maximum (10000).",
+    100);
+
+static setting_bool g_save_dirs(
+    "history.save_dirs",
+    "Save directory history between sessions",
+    "When enabled, the recent directories are saved in a clink_dir_history file\n"
+    "next to the history file.  Changing this setting only takes effect for new\n"
+    "instances.",
+    false);
+
+static constexpr int c_max_max_dirs = 10000;
+
 static setting_str g_exclude_from_history_cmds(
     "history.dont_add_to_history_cmds",
     "Commands not automatically added to the history",
@@ -145,6 +164,15 @@ extern str<> g_last_prompt;
 
 
 
+//------------------------------------------------------------------------------
+static bool s_settings_changed = true;
+static void on_setting_changed(const setting* s)
+{
+    s_settings_changed = true;
+}
+
+
+
 //------------------------------------------------------------------------------
 static void get_errorlevel_tmp_name(str_base& out, bool wild=false)
 {
@@ -169,44 +197,34 @@ static void get_errorlevel_tmp_name(str_base& out, bool wild=false)
 
 
 //------------------------------------------------------------------------------
-class dir_history_entry : public no_copy
-{
-public:
-                    dir_history_entry(const char* s);
-                    dir_history_entry(dir_history_entry&& d) { dir = d.dir; d.dir = nullptr; }
-                    ~dir_history_entry() { free(dir); }
-
-    const char*     get() const { return dir; }
-
-private:
-    char* dir;
-};
-
-//------------------------------------------------------------------------------
-dir_history_entry::dir_history_entry(const char* s)
-{
-    size_t alloc = strlen(s) + 1;
-    dir = (char *)malloc(alloc);
-    memcpy(dir, s, alloc);
-}
-
-//------------------------------------------------------------------------------
-const int c_max_dir_history = 100;
-static std::list<dir_history_entry> s_dir_history;
+static dir_history s_dir_history;
+static bool s_dir_history_loaded = false;
 
 //------------------------------------------------------------------------------
 static void update_dir_history()
 {
+    int capacity = g_max_dirs.get();
+    if (capacity <= 0 || capacity > c_max_max_dirs)
+        capacity = c_max_max_dirs;
+    s_dir_history.set_capacity(capacity);
+
+    // Saved directories are only loaded when the first prompt is shown.
+    str<280> file;
+    if (g_save_dirs.get())
+        app_context::get()->get_dir_history_path(file);
+    if (!s_dir_history_loaded)
+    {
+        s_dir_history_loaded = true;
+        if (file.length())
+            s_dir_history.load(file.c_str());
+    }
+
     str<> cwd;
     os::get_current_dir(cwd);
 
-    // Add cwd to tail.
-    if (!s_dir_history.size() || _stricmp(s_dir_history.back().get(), cwd.c_str()) != 0)
-        s_dir_history.push_back(cwd.c_str());
-
-    // Trim overflow from head.
-    while (s_dir_history.size() > c_max_dir_history)
-        s_dir_history.pop_front();
+    // Add cwd as the most recent directory.
+    if (s_dir_history.add(cwd.c_str(), time(nullptr)) && file.length())
+        s_dir_history.save(file.c_str());
 }
 
 //------------------------------------------------------------------------------
@@ -214,13 +232,11 @@ static void prev_dir_history(str_base& inout)
 {
     inout.clear();
 
-    if (s_dir_history.size() < 2)
+    const char* prev = s_dir_history.get_previous();
+    if (!prev)
         return;
 
-    auto a = s_dir_history.rbegin();
-    a++;
-
-    inout.format(" cd /d \"%s\"", a->get());
+    inout.format(" cd /d \"%s\"", prev);
 }
 
 
@@ -546,11 +562,15 @@ host::host(const char* name)
 {
     m_terminal = terminal_create();
     m_printer = new printer(*m_terminal.out);
+
+    settings::add_change_handler(on_setting_changed);
 }
 
 //------------------------------------------------------------------------------
 host::~host()
 {
+    settings::remove_change_handler(on_setting_changed);
+
     purge_old_files();
 
     delete m_prompt_filter;
@@ -706,18 +726,22 @@ bool host::call_lua_rl_global_function(const char* func_name, line_state* line)
 }
 
 //------------------------------------------------------------------------------
-const char** host::copy_dir_history(int* total)
+const char** host::copy_dir_history(int* total, bool ranked)
 {
     if (!s_dir_history.size())
         return nullptr;
 
+    std::vector<const char*> dirs;
+    if (ranked)
+        s_dir_history.get_ranked(dirs, time(nullptr));
+    else
+        s_dir_history.get_dirs(dirs);
+
     // Copy the directory list (just a shallow copy of the dir pointers).
-    const char** history = (const char**)malloc(sizeof(*history) * s_dir_history.size());
-    int i = 0;
-    for (auto const& it : s_dir_history)
-        history[i++] = it.get();
+    const char** history = (const char**)malloc(sizeof(*history) * dirs.size());
+    memcpy(history, dirs.data(), sizeof(*history) * dirs.size());
 
-    *total = i;
+    *total = int(dirs.size());
     return history;
 }
 
@@ -759,7 +783,12 @@ bool host::edit_line(const char* prompt, const char* rprompt, str_base& out)
     app->get_settings_path(settings_file);
     app->get_state_dir(state_dir);
     settings::load(settings_file.c_str());
-    reset_keyseq_to_name_map();
+    if (s_settings_changed)
+    {
+        // Settings can affect key sequence processing.
+        s_settings_changed = false;
+        reset_keyseq_to_name_map();
+    }
 
     // Set up the string comparison mode.
     static_assert(str_compare_scope::exact == 0, "g_ignore_case values must match str_compare_scope values");
@@ -43,7 +43,7 @@ public:
     void            suggest(line_state& line, matches& matches) override;
     void            filter_matches(char** matches) override;
     bool            call_lua_rl_global_function(const char* func_name, line_state* line) override;
-    const char**    copy_dir_history(int* total) override;
+    const char**    copy_dir_history(int* total, bool ranked) override;
     void            send_event(const char* event_name) override;
     void            get_app_context(int& id, str_base& binaries, str_base& profile, str_base& scripts) override;
 
@@ -276,6 +276,13 @@ void app_context::get_history_path(str_base& out) const
     }
 }
 
+//------------------------------------------------------------------------------
+void app_context::get_dir_history_path(str_base& out) const
+{
+    get_state_dir(out);
+    path::append(out, "clink_dir_history");
+}
+
 //------------------------------------------------------------------------------
 void app_context::get_script_path(str_base& out, bool readable) const
 {
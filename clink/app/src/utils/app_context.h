@@ -36,6 +36,7 @@ public:
     void        get_log_path(str_base& out) const;
     void        get_settings_path(str_base& out) const;
     void        get_history_path(str_base& out) const;
+    void        get_dir_history_path(str_base& out) const;
     void        get_script_path(str_base& out) const;
     void        get_script_path_readable(str_base& out) const;
     bool        update_env() const;
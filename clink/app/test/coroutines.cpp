@@ -7,6 +7,7 @@
 #include <core/str.h>
 #include <core/path.h>
 #include <core/settings.h>
+#include <lua/lua_input_idle.h>
 #include <lua/lua_script_loader.h>
 #include <lua/lua_state.h>
 #include <lua/prompt.h>
@@ -319,3 +320,512 @@ TEST_CASE("Lua coroutines.")
 
     set_prompt_async_default();
 }
+
+//------------------------------------------------------------------------------
+TEST_CASE("Lua concurrent popenyield.")
+{
+    lua_state lua;
+    prompt_filter prompt_filter(lua);
+    lua_load_script(lua, app, prompt);
+
+    setting* max_popen = settings::find("lua.max_concurrent_popen");
+    REQUIRE(max_popen);
+    max_popen->set("2");
+    set_prompt_async(true);
+
+    const char* script = "\
+    _ran = ''\
+    _yieldguards = {}\
+    \
+    function clink.refilterprompt()\
+    end\
+    \
+    function io.popenyield_internal(command, mode)\
+        local yieldguard = { _ready=false, _command=command }\
+        function yieldguard:ready()\
+            return self._ready\
+        end\
+        function yieldguard:command()\
+            return self._command\
+        end\
+        _yieldguards[command] = yieldguard\
+        _ran = _ran..'|'..command\
+        return 'fake_file', yieldguard\
+    end\
+    \
+    function resume_coroutines()\
+        clink._wait_duration()\
+        clink._resume_coroutines()\
+        return true\
+    end\
+    \
+    function set_all_ready()\
+        for _,yieldguard in pairs(_yieldguards) do\
+            yieldguard._ready = true\
+        end\
+        _yieldguards = {}\
+        return true\
+    end\
+    \
+    local function count_running()\
+        local n = 0\
+        for _,yieldguard in pairs(_yieldguards) do\
+            n = n + 1\
+        end\
+        return n\
+    end\
+    \
+    function verify_two_running()\
+        return count_running() == 2\
+    end\
+    \
+    function verify_all_ran()\
+        for _,name in ipairs({ 'a1', 'a2', 'b1', 'b2', 'c1', 'c2' }) do\
+            if not _ran:find('|'..name, 1, true) then\
+                return false\
+            end\
+        end\
+        return clink._has_coroutines() ~= true\
+    end\
+    \
+    for _,name in ipairs({ 'a', 'b', 'c' }) do\
+        local pf = clink.promptfilter(1)\
+        function pf:filter(prompt)\
+            local function run()\
+                io.popenyield(name..'1')\
+                io.popenyield(name..'2')\
+            end\
+            clink.promptcoroutine(run)\
+        end\
+    end\
+    ";
+
+    REQUIRE(lua.do_string(script));
+
+    str<> out;
+    lua.send_event("onbeginedit");
+    prompt_filter.filter("", out);
+
+    // Only two of the three prompt filters' commands run at once.
+    REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+    REQUIRE(verify_ret_true(lua, "verify_two_running"));
+
+    // As commands finish, queued commands start, subject to the limit of two.
+    REQUIRE(verify_ret_true(lua, "set_all_ready"));
+    REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+    REQUIRE(verify_ret_true(lua, "verify_two_running"));
+
+    REQUIRE(verify_ret_true(lua, "set_all_ready"));
+    REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+    REQUIRE(verify_ret_true(lua, "verify_two_running"));
+
+    // Finishing the last two commands lets all the coroutines complete.
+    REQUIRE(verify_ret_true(lua, "set_all_ready"));
+    REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+    REQUIRE(verify_ret_true(lua, "verify_all_ran"));
+
+    max_popen->set();
+    set_prompt_async_default();
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Lua popenyield across edit sessions.")
+{
+    lua_state lua;
+    prompt_filter prompt_filter(lua);
+    lua_load_script(lua, app, prompt);
+
+    set_prompt_async(true);
+
+    const char* script = "\
+    _ran = ''\
+    _gen = 0\
+    _yieldguards = {}\
+    \
+    function clink.refilterprompt()\
+    end\
+    \
+    function io.popenyield_internal(command, mode)\
+        local yieldguard = { _ready=false, _command=command }\
+        function yieldguard:ready()\
+            return self._ready\
+        end\
+        function yieldguard:command()\
+            return self._command\
+        end\
+        _yieldguards[command] = yieldguard\
+        _ran = _ran..'|'..command\
+        return 'fake_file', yieldguard\
+    end\
+    \
+    function resume_coroutines()\
+        clink._resume_coroutines()\
+        return true\
+    end\
+    \
+    function set_ready_1()\
+        _yieldguards['1']._ready = true\
+        return true\
+    end\
+    \
+    function verify_ran_1()\
+        return _ran == '|1'\
+    end\
+    \
+    function verify_ran_1_2()\
+        return _ran == '|1|2'\
+    end\
+    \
+    local pf = clink.promptfilter(1)\
+    function pf:filter(prompt)\
+        _gen = _gen + 1\
+        local command = tostring(_gen)\
+        clink.promptcoroutine(function()\
+            io.popenyield(command)\
+        end)\
+    end\
+    ";
+
+    REQUIRE(lua.do_string(script));
+
+    lua_input_idle idle(lua);
+    str<> out;
+
+    // Prompt 1 starts a popenyield.
+    lua.send_event("onbeginedit");
+    idle.reset();
+    prompt_filter.filter("", out);
+    REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+    REQUIRE(verify_ret_true(lua, "verify_ran_1"));
+
+    // Prompt 2's popenyield is queued behind the preserved one from prompt 1,
+    // which is still running after the wake event is replaced.
+    lua.send_event("onbeginedit");
+    idle.reset();
+    prompt_filter.filter("", out);
+    REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+    REQUIRE(verify_ret_true(lua, "verify_ran_1"));
+    REQUIRE(idle.is_enabled());
+    REQUIRE(idle.get_timeout() == INFINITE);
+
+    // The preserved popenyield finishes without signaling the wake event.  The
+    // next timeout releases it, so the queued coroutine is due immediately.
+    REQUIRE(verify_ret_true(lua, "set_ready_1"));
+    REQUIRE(idle.get_timeout() == 0);
+    REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+    REQUIRE(verify_ret_true(lua, "verify_ran_1_2"));
+
+    set_prompt_async_default();
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Lua coroutine scheduler.")
+{
+    lua_state lua;
+
+    const char* script = "\
+    _counts = {}\
+    _threads = {}\
+    \
+    function add_counted(name, interval)\
+        _counts[name] = 0\
+        local c = coroutine.create(function()\
+            while true do\
+                _counts[name] = _counts[name] + 1\
+                coroutine.yield()\
+            end\
+        end)\
+        _threads[name] = c\
+        clink.addcoroutine(c, interval)\
+    end\
+    \
+    function setup_idle_and_busy()\
+        for i = 1, 500 do\
+            add_counted('idle'..i, 60)\
+        end\
+        add_counted('busy', 0)\
+        return true\
+    end\
+    \
+    function resume_many()\
+        for i = 1, 1000 do\
+            clink._resume_coroutines()\
+        end\
+        return true\
+    end\
+    \
+    function verify_only_due_resumed()\
+        for i = 1, 500 do\
+            if _counts['idle'..i] ~= 1 then\
+                return false\
+            end\
+        end\
+        return _counts['busy'] == 1000\
+    end\
+    \
+    function verify_busy_is_due()\
+        local dur = clink._wait_duration()\
+        return dur ~= nil and dur <= 0\
+    end\
+    \
+    function remove_busy()\
+        clink.removecoroutine(_threads['busy'])\
+        return true\
+    end\
+    \
+    function verify_idle_wait_duration()\
+        local dur = clink._wait_duration()\
+        return dur ~= nil and dur > 0 and dur <= 60\
+    end\
+    \
+    function setup_timed()\
+        add_counted('timed', 10)\
+        clink._resume_coroutines()\
+        return _counts['timed'] == 1\
+    end\
+    \
+    function verify_timed_not_due()\
+        clink._resume_coroutines()\
+        local dur = clink._wait_duration()\
+        return _counts['timed'] == 1 and dur ~= nil and dur > 0 and dur <= 10\
+    end\
+    ";
+
+    REQUIRE(lua.do_string(script));
+
+    lua.send_event("onbeginedit");
+
+    SECTION("Due only")
+    {
+        // Only the coroutines that are due get resumed; the idle ones are
+        // resumed once at first and then not again until their interval.
+        REQUIRE(verify_ret_true(lua, "setup_idle_and_busy"));
+        REQUIRE(verify_ret_true(lua, "resume_many"));
+        REQUIRE(verify_ret_true(lua, "verify_only_due_resumed"));
+        REQUIRE(verify_ret_true(lua, "verify_busy_is_due"));
+
+        REQUIRE(verify_ret_true(lua, "remove_busy"));
+        REQUIRE(verify_ret_true(lua, "verify_idle_wait_duration"));
+    }
+
+    SECTION("Timeout")
+    {
+        REQUIRE(verify_ret_true(lua, "setup_timed"));
+        REQUIRE(verify_ret_true(lua, "verify_timed_not_due"));
+
+        // The idle timeout comes from the native schedule:  the coroutine isn't
+        // due yet, and is due within its interval.
+        lua_input_idle idle(lua);
+        idle.reset();
+        REQUIRE(idle.is_enabled());
+        unsigned timeout = idle.get_timeout();
+        REQUIRE(timeout > 0);
+        REQUIRE(timeout <= 10000);
+    }
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Lua prompt filter cachedeps.")
+{
+    lua_state lua;
+    prompt_filter prompt_filter(lua);
+    lua_load_script(lua, app, prompt);
+
+    // Fake the dependency sources so the test controls when they change.
+    const char* script = "\
+    _cwd = 'c:\\\\one'\
+    _errorlevel = 0\
+    _stamps = { ['cachedeps.txt']='100' }\
+    _custom = 'a'\
+    _runs = 0\
+    _started = 0\
+    _yieldguards = {}\
+    \
+    function os.getcwd()\
+        return _cwd\
+    end\
+    \
+    function os.geterrorlevel()\
+        return _errorlevel\
+    end\
+    \
+    function clink.get_file_stamp(file)\
+        return _stamps[file]\
+    end\
+    \
+    function clink.refilterprompt()\
+    end\
+    \
+    function io.popenyield_internal(command, mode)\
+        local yieldguard = { _ready=false, _command=command }\
+        function yieldguard:ready()\
+            return self._ready\
+        end\
+        function yieldguard:command()\
+            return self._command\
+        end\
+        _yieldguards[command] = yieldguard\
+        return 'fake_file', yieldguard\
+    end\
+    \
+    os.setenv('CLINK_TEST_CACHEDEPS', 'x')\
+    \
+    local function custom_key()\
+        return _custom\
+    end\
+    \
+    function add_sync_filter()\
+        local pf = clink.promptfilter(1)\
+        pf.cachedeps = {\
+            cwd = true,\
+            errorlevel = true,\
+            env = { 'CLINK_TEST_CACHEDEPS' },\
+            files = { 'cachedeps.txt' },\
+            key = custom_key,\
+        }\
+        function pf:filter(prompt)\
+            _runs = _runs + 1\
+            return 'run'.._runs\
+        end\
+        return true\
+    end\
+    \
+    function add_async_filter()\
+        local pf = clink.promptfilter(1)\
+        pf.cachedeps = { key = custom_key }\
+        function pf:filter(prompt)\
+            local function run()\
+                _started = _started + 1\
+                io.popenyield('git status')\
+                return 'done'.._started\
+            end\
+            return clink.promptcoroutine(run) or 'pending'\
+        end\
+        return true\
+    end\
+    \
+    function resume_coroutines()\
+        clink._resume_coroutines()\
+        return true\
+    end\
+    \
+    function set_all_ready()\
+        for _,yieldguard in pairs(_yieldguards) do\
+            yieldguard._ready = true\
+        end\
+        _yieldguards = {}\
+        return true\
+    end\
+    \
+    function verify_started_once()\
+        return _started == 1\
+    end\
+    \
+    function verify_started_twice()\
+        return _started == 2\
+    end\
+    \
+    function verify_no_coroutines()\
+        return clink._has_coroutines() ~= true\
+    end\
+    ";
+
+    REQUIRE(lua.do_string(script));
+
+    SECTION("Sync")
+    {
+        REQUIRE(verify_ret_true(lua, "add_sync_filter"));
+
+        str<> out;
+        lua.send_event("onbeginedit");
+        prompt_filter.filter("", out);
+        REQUIRE(out.equals("run1"));
+
+        // Nothing changed, so the previous output is reused.
+        lua.send_event("onbeginedit");
+        prompt_filter.filter("", out);
+        REQUIRE(out.equals("run1"));
+
+        // Each dependency makes the filter run again when it changes, and the
+        // new output is reused after that.
+        const char* changes[] = {
+            "_cwd = 'c:\\\\two'",
+            "os.setenv('CLINK_TEST_CACHEDEPS', 'y')",
+            "_errorlevel = 1",
+            "_stamps['cachedeps.txt'] = '200'",
+            "_custom = 'b'",
+        };
+
+        int runs = 1;
+        for (const char* change : changes)
+        {
+            REQUIRE(lua.do_string(change), [&] () {
+                printf("change:  %s\n", change);
+            });
+
+            str<> expected;
+            expected.format("run%d", ++runs);
+
+            lua.send_event("onbeginedit");
+            prompt_filter.filter("", out);
+            REQUIRE(out.equals(expected.c_str()), [&] () {
+                printf("change:  %s\nexpected:  %s\nactual:  %s\n", change, expected.c_str(), out.c_str());
+            });
+
+            lua.send_event("onbeginedit");
+            prompt_filter.filter("", out);
+            REQUIRE(out.equals(expected.c_str()), [&] () {
+                printf("change:  %s\nexpected reuse:  %s\nactual:  %s\n", change, expected.c_str(), out.c_str());
+            });
+        }
+
+        // A different input prompt string also makes the filter run again.
+        prompt_filter.filter("other", out);
+        REQUIRE(out.equals("run7"));
+    }
+
+    SECTION("Async")
+    {
+        set_prompt_async(true);
+        REQUIRE(verify_ret_true(lua, "add_async_filter"));
+
+        // The prompt coroutine's output isn't cached until it finishes.
+        str<> out;
+        lua.send_event("onbeginedit");
+        prompt_filter.filter("", out);
+        REQUIRE(out.equals("pending"));
+        REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+        REQUIRE(verify_ret_true(lua, "verify_started_once"));
+        REQUIRE(verify_ret_true(lua, "set_all_ready"));
+        REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+        REQUIRE(verify_ret_true(lua, "verify_no_coroutines"));
+
+        // Refilter after the coroutine finishes.
+        prompt_filter.filter("", out);
+        REQUIRE(out.equals("done1"));
+
+        // A new edit session reuses the output without starting the prompt
+        // coroutine again.
+        lua.send_event("onbeginedit");
+        prompt_filter.filter("", out);
+        REQUIRE(out.equals("done1"));
+        REQUIRE(verify_ret_true(lua, "verify_no_coroutines"));
+        REQUIRE(verify_ret_true(lua, "verify_started_once"));
+
+        // Changing the custom key starts the prompt coroutine again.
+        REQUIRE(lua.do_string("_custom = 'b'"));
+        lua.send_event("onbeginedit");
+        prompt_filter.filter("", out);
+        REQUIRE(out.equals("pending"));
+        REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+        REQUIRE(verify_ret_true(lua, "verify_started_twice"));
+        REQUIRE(verify_ret_true(lua, "set_all_ready"));
+        REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+        prompt_filter.filter("", out);
+        REQUIRE(out.equals("done2"));
+
+        set_prompt_async_default();
+    }
+
+    lua.do_string("os.setenv('CLINK_TEST_CACHEDEPS')");
+}
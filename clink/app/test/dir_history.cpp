@@ -0,0 +1,244 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "fs_fixture.h"
+
+#include <core/base.h>
+#include <core/path.h>
+#include <core/str.h>
+#include <host/dir_history.h>
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+static void verify_dirs(const std::vector<const char*>& dirs, const char** expected, int count)
+{
+    REQUIRE(dirs.size() == count);
+    for (int i = 0; i < count; ++i)
+        REQUIRE(strcmp(dirs[i], expected[i]) == 0, [&] () {
+            printf("index:     %d\nexpected:  %s\ngot:       %s\n", i, expected[i], dirs[i]);
+        });
+}
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("Directory history")
+{
+    dir_history history(4);
+    std::vector<const char*> dirs;
+
+    SECTION("Add")
+    {
+        REQUIRE(history.add("c:\\one", 0));
+        REQUIRE(history.add("c:\\two", 0));
+        REQUIRE(!history.add("C:\\TWO", 0));
+        REQUIRE(!history.add("", 0));
+        REQUIRE(history.size() == 2);
+
+        history.get_dirs(dirs);
+        const char* expected[] = { "c:\\one", "c:\\two" };
+        verify_dirs(dirs, expected, sizeof_array(expected));
+    }
+
+    SECTION("Move to front")
+    {
+        history.add("c:\\one", 0);
+        history.add("c:\\two", 0);
+        history.add("c:\\three", 0);
+        REQUIRE(history.add("C:\\One", 0));
+        REQUIRE(history.size() == 3);
+
+        history.get_dirs(dirs);
+        const char* expected[] = { "c:\\two", "c:\\three", "C:\\One" };
+        verify_dirs(dirs, expected, sizeof_array(expected));
+    }
+
+    SECTION("Previous")
+    {
+        REQUIRE(history.get_previous() == nullptr);
+        history.add("c:\\one", 0);
+        REQUIRE(history.get_previous() == nullptr);
+        history.add("c:\\two", 0);
+        REQUIRE(strcmp(history.get_previous(), "c:\\one") == 0);
+        history.add("c:\\one", 0);
+        REQUIRE(strcmp(history.get_previous(), "c:\\two") == 0);
+    }
+
+    SECTION("Capacity")
+    {
+        const char* names[] = { "c:\\a", "c:\\b", "c:\\c", "c:\\d", "c:\\e", "c:\\f" };
+        for (const char* name : names)
+            history.add(name, 0);
+        REQUIRE(history.size() == 4);
+
+        history.get_dirs(dirs);
+        const char* expected[] = { "c:\\c", "c:\\d", "c:\\e", "c:\\f" };
+        verify_dirs(dirs, expected, sizeof_array(expected));
+
+        // A dropped directory is added again as a new directory.
+        history.add("c:\\a", 0);
+        history.get_dirs(dirs);
+        const char* expected2[] = { "c:\\d", "c:\\e", "c:\\f", "c:\\a" };
+        verify_dirs(dirs, expected2, sizeof_array(expected2));
+
+        history.set_capacity(2);
+        REQUIRE(history.size() == 2);
+        history.get_dirs(dirs);
+        const char* expected3[] = { "c:\\f", "c:\\a" };
+        verify_dirs(dirs, expected3, sizeof_array(expected3));
+
+        history.set_capacity(10);
+        history.add("c:\\g", 0);
+        history.add("c:\\h", 0);
+        history.add("c:\\i", 0);
+        REQUIRE(history.size() == 5);
+    }
+
+    SECTION("Ranked")
+    {
+        const long long hour = 60 * 60;
+        const long long day = 24 * hour;
+
+        // Visited often, but a long time ago.
+        for (int i = 0; i < 6; ++i)
+        {
+            history.add("c:\\often", 0);
+            history.add("c:\\other", 0);
+        }
+
+        // Visited once, recently.
+        history.add("c:\\recent", 30 * day);
+        history.add("c:\\current", 30 * day);
+
+        history.get_ranked(dirs, 30 * day + 10);
+        const char* expected[] = { "c:\\often", "c:\\other", "c:\\recent", "c:\\current" };
+        verify_dirs(dirs, expected, sizeof_array(expected));
+
+        // Recency fades.
+        history.add("c:\\often", 30 * day + hour);
+        history.get_ranked(dirs, 40 * day);
+        const char* expected2[] = { "c:\\recent", "c:\\current", "c:\\other", "c:\\often" };
+        verify_dirs(dirs, expected2, sizeof_array(expected2));
+
+        // Ranking doesn't change the recency order.
+        history.get_dirs(dirs);
+        const char* expected3[] = { "c:\\other", "c:\\recent", "c:\\current", "c:\\often" };
+        verify_dirs(dirs, expected3, sizeof_array(expected3));
+    }
+
+    SECTION("Save/load")
+    {
+        fs_fixture fs;
+        str<> file(fs.get_root());
+        path::append(file, "dir_history");
+
+        history.add("c:\\one", 100);
+        history.add("c:\\two", 200);
+        history.add("c:\\one", 300);
+        history.add("c:\\three", 400);
+        REQUIRE(history.save(file.c_str()));
+
+        dir_history loaded(4);
+        REQUIRE(loaded.load(file.c_str()));
+        REQUIRE(loaded.size() == 3);
+
+        history.get_dirs(dirs);
+        std::vector<const char*> loaded_dirs;
+        loaded.get_dirs(loaded_dirs);
+        verify_dirs(loaded_dirs, dirs.data(), int(dirs.size()));
+
+        history.get_ranked(dirs, 500);
+        loaded.get_ranked(loaded_dirs, 500);
+        verify_dirs(loaded_dirs, dirs.data(), int(dirs.size()));
+
+        // Loading into a smaller history keeps the most recent directories.
+        dir_history small(2);
+        REQUIRE(small.load(file.c_str()));
+        small.get_dirs(dirs);
+        const char* expected[] = { "c:\\one", "c:\\three" };
+        verify_dirs(dirs, expected, sizeof_array(expected));
+
+        REQUIRE(!loaded.load("nope\\no_such_file"));
+    }
+
+    SECTION("Long lines")
+    {
+        fs_fixture fs;
+        str<> file(fs.get_root());
+        path::append(file, "dir_history");
+
+        str<> long_dir("c:\\");
+        while (long_dir.length() < 3000)
+            long_dir.concat("abcdefghij");
+
+        history.add("c:\\one", 100);
+        history.add(long_dir.c_str(), 200);
+        history.add("c:\\two", 300);
+        REQUIRE(history.save(file.c_str()));
+
+        dir_history loaded(4);
+        REQUIRE(loaded.load(file.c_str()));
+        loaded.get_dirs(dirs);
+        const char* expected[] = { "c:\\one", long_dir.c_str(), "c:\\two" };
+        verify_dirs(dirs, expected, sizeof_array(expected));
+    }
+
+    SECTION("Save merges")
+    {
+        fs_fixture fs;
+        str<> file(fs.get_root());
+        path::append(file, "dir_history");
+
+        // Two sessions save different directories to the same file.
+        dir_history other(4);
+        history.add("c:\\one", 100);
+        other.add("c:\\two", 200);
+        history.add("c:\\three", 300);
+        other.add("c:\\four", 400);
+        REQUIRE(history.save(file.c_str()));
+        REQUIRE(other.save(file.c_str()));
+
+        dir_history loaded(4);
+        REQUIRE(loaded.load(file.c_str()));
+        loaded.get_dirs(dirs);
+        const char* expected[] = { "c:\\one", "c:\\two", "c:\\three", "c:\\four" };
+        verify_dirs(dirs, expected, sizeof_array(expected));
+
+        // Merging doesn't change the session's own history.
+        other.get_dirs(dirs);
+        const char* expected2[] = { "c:\\two", "c:\\four" };
+        verify_dirs(dirs, expected2, sizeof_array(expected2));
+
+        // The most recent directories are kept when the merge is too big.
+        history.add("c:\\five", 500);
+        REQUIRE(history.save(file.c_str()));
+        REQUIRE(loaded.load(file.c_str()));
+        loaded.get_dirs(dirs);
+        const char* expected3[] = { "c:\\two", "c:\\three", "c:\\four", "c:\\five" };
+        verify_dirs(dirs, expected3, sizeof_array(expected3));
+    }
+
+    SECTION("Save after clock change")
+    {
+        fs_fixture fs;
+        str<> file(fs.get_root());
+        path::append(file, "dir_history");
+
+        dir_history other(4);
+        other.add("c:\\three", 300);
+        REQUIRE(other.save(file.c_str()));
+
+        // The clock went backwards between visits.
+        history.add("c:\\one", 500);
+        history.add("c:\\two", 100);
+        REQUIRE(history.save(file.c_str()));
+
+        dir_history loaded(4);
+        REQUIRE(loaded.load(file.c_str()));
+        loaded.get_dirs(dirs);
+        const char* expected[] = { "c:\\two", "c:\\three", "c:\\one" };
+        verify_dirs(dirs, expected, sizeof_array(expected));
+    }
+}
@@ -190,6 +190,48 @@ TEST_CASE("Doskey $? chars")
     }
 }
 
+//------------------------------------------------------------------------------
+TEST_CASE("Doskey redefined")
+{
+    // Macros are compiled once and reused; redefining an alias must still use
+    // the new text.
+    const char* const c_macros[][2] = {
+        { "one $1",         "one x" },
+        { "two $1 $$",      "two x $" },
+        { "three $",        "three " },
+        { "q \"$*\"",       "q \"x | y\"" },
+        { "one $1",         "one x" },
+    };
+
+    for (int i = 0; i < 2; ++i)
+    {
+        use_enhanced(i != 0);
+
+        doskey doskey("shell");
+        for (const auto& macro : c_macros)
+        {
+            doskey.add_alias("alias", macro[0]);
+
+            // The pipe only stays with the alias when $* is inside quotes
+            // (or enhanced doskey is off).
+            const bool quoted = (strchr(macro[0], '"') != nullptr);
+            str<> line((quoted || i == 0) ? "alias x | y" : "alias x");
+
+            doskey_alias alias;
+            doskey.resolve(line.c_str(), alias);
+            REQUIRE(alias);
+
+            REQUIRE(alias.next(line) == true);
+            REQUIRE(line.equals(macro[1]), [&] () {
+                printf("%smacro:    %s\nexpected: %s\nactual:   %s\n", i ? "(enhanced)\n" : "", macro[0], macro[1], line.c_str());
+            });
+            REQUIRE(alias.next(line) == false);
+        }
+
+        doskey.remove_alias("alias");
+    }
+}
+
 //------------------------------------------------------------------------------
 TEST_CASE("Doskey multi-command")
 {
@@ -383,6 +425,56 @@ TEST_CASE("Doskey cursor point")
     }
 }
 
+//------------------------------------------------------------------------------
+TEST_CASE("Doskey cursor point : tags")
+{
+    for (int i = 0; i < 2; ++i)
+    {
+        use_enhanced(i != 0);
+
+        str<> line;
+        doskey doskey("shell");
+
+        // A point in an arg goes to the first copy of the arg, whether that is
+        // from $1..9 or $*.  Tags that don't copy args don't move it.
+        static const int c_points[] =
+        {
+            0,  0,
+            1,  6,
+            2,  15,
+            4,  13,
+            6,  21,
+            16, 31,
+            18, 7,
+            20, 9,
+            22, 11,
+            23, 38,
+        };
+
+        doskey.add_alias("m", "echo$G$$ $9 $2$T$1 $*");
+        line.clear();
+        //                     1111111111222
+        //           01234567890123456789012
+        line.concat("m a b c d e f g h ninth");
+        //                     1111111111222222222233333333
+        //           01234567890123456789012345678901234567
+        //          "echo>$ ninth b\na a b c d e f g h ninth"
+        for (int j = 0; j < sizeof_array(c_points); j += 2)
+        {
+            const int from = c_points[j + 0];
+            const int expected = c_points[j + 1];
+            int point = from;
+            doskey_alias alias;
+            doskey.resolve(line.c_str(), alias, &point);
+            REQUIRE(alias.UNITTEST_get_stream().equals("echo>$ ninth b\na a b c d e f g h ninth"));
+            REQUIRE(point == expected, [&] () {
+                printf("%sFROM %d:\nexpected: %d\nactual:   %d", i ? "(enhanced)\n" : "", from, expected, point);
+            });
+        }
+        doskey.remove_alias("m");
+    }
+}
+
 //------------------------------------------------------------------------------
 TEST_CASE("Doskey cursor point : multiple commands")
 {
@@ -4,6 +4,7 @@
 #include "pch.h"
 #include "env_fixture.h"
 #include "fs_fixture.h"
+#include "history_fixture.h"
 #include "line_editor_tester.h"
 
 #include <core/base.h>
@@ -23,8 +24,12 @@ extern "C" {
 //------------------------------------------------------------------------------
 extern "C" {
 char* tgetstr(const char*, char**);
+int find_streqn(const char* a, const char* b, int n);
+extern int _rl_search_case_fold;
 }
 
+extern bool g_show_benchmarks;
+
 //------------------------------------------------------------------------------
 #define CTRL_A "\x01"
 #define CTRL_E "\x05"
@@ -918,3 +923,311 @@ TEST_CASE("history removals ctag")
         }
     }
 }
+
+//------------------------------------------------------------------------------
+TEST_CASE("history load")
+{
+    const char* master_path = "clink_history";
+
+    const char* empty_fs[] = { nullptr };
+    fs_fixture fs(empty_fs);
+
+    static const char* env_desc[] = {
+        "=clink.id", "493",
+        nullptr
+    };
+    env_fixture env(env_desc);
+
+    app_context::desc context_desc;
+    context_desc.inherit_id = true;
+    str_base(context_desc.state_dir).copy(fs.get_root());
+    app_context context(context_desc);
+
+    settings::find("history.shared")->set("false");
+
+    const unsigned int counts[] = { 10000, 100000, 1000000 };
+    for (unsigned int count : counts)
+    {
+        if (!use_history_size(count, counts[0]))
+            break;
+
+        test_history_db history;
+        history.clear();
+
+        {
+            FILE* file = fopen(master_path, "ab");
+            REQUIRE(file != nullptr);
+            write_history_lines(file, count);
+            fclose(file);
+        }
+
+        // Load twice, the way a prompt does after the first time.
+        double elapsed[2];
+        for (double& e : elapsed)
+        {
+            const double start = os::clock();
+            history.load_rl_history(false);
+            e = os::clock() - start;
+        }
+
+        REQUIRE(history_length == int(count));
+        REQUIRE(history.get_master_length() == count);
+        REQUIRE(strcmp(history_get(history_base)->line, "cmd0 --flag arg0") == 0);
+        REQUIRE(strcmp(history_get(history_base + 9999)->line, "cmd9999 --flag arg99") == 0);
+
+        if (g_show_benchmarks)
+            print_history_benchmark("history load", count, elapsed[0], elapsed[1]);
+
+        history.clear();
+        clear_history();
+    }
+}
+
+//------------------------------------------------------------------------------
+static int search_history(const char* string, int from, int dir, bool prefix)
+{
+    history_set_pos(from);
+    const int ret = prefix ? history_search_prefix(string, dir) : history_search(string, dir);
+    return (ret < 0) ? -1 : where_history();
+}
+
+//------------------------------------------------------------------------------
+// Finds the same line as search_history(), but by comparing every line instead
+// of going through the history index.
+static int linear_search_history(const char* string, int from, int dir, bool prefix)
+{
+    const int len = int(strlen(string));
+    for (int i = from; i >= 0 && i < history_length; i += dir)
+    {
+        const char* line = history_get(history_base + i)->line;
+        for (const char* p = line; *p; ++p)
+        {
+            if (find_streqn(string, p, len))
+                return i;
+            if (prefix)
+                break;
+        }
+    }
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+static void verify_folded_search(const char* string, bool prefix)
+{
+    const int last = history_length - 1;
+    for (int from : { last, last / 2, 0 })
+    {
+        for (int dir : { -1, 1 })
+        {
+            const int expected = linear_search_history(string, from, dir, prefix);
+            const int found = search_history(string, from, dir, prefix);
+            REQUIRE(found == expected, [&] () {
+                printf("string:    %s\nprefix:    %d\nfrom:      %d\ndir:       %d\nexpected:  %d\ngot:       %d\n",
+                       string, prefix, from, dir, expected, found);
+            });
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("history search")
+{
+    clear_history();
+
+    // Enough lines that searches go through the history index.
+    add_history_lines(1000);
+
+    SECTION("Substring")
+    {
+        REQUIRE(search_history("arg42", 999, -1, false) == 942);
+        REQUIRE(search_history("arg42", 941, -1, false) == 842);
+        REQUIRE(search_history("arg42", 0, 1, false) == 42);
+        REQUIRE(search_history("d500 --", 999, -1, false) == 500);
+        REQUIRE(search_history("d500 --", 499, -1, false) == -1);
+        REQUIRE(search_history("nomatch", 999, -1, false) == -1);
+        REQUIRE(search_history("ar", 999, -1, false) == 999);
+    }
+
+    SECTION("Prefix")
+    {
+        REQUIRE(search_history("cmd77 ", 999, -1, true) == 77);
+        REQUIRE(search_history("cmd77", 999, -1, true) == 779);
+        REQUIRE(search_history("cmd77", 0, 1, true) == 77);
+        REQUIRE(search_history("arg", 999, -1, true) == -1);
+    }
+
+    SECTION("Substring case folded")
+    {
+        _rl_search_case_fold = 1;
+        add_history("Find THE Needle");
+        add_history("\xc4\xb0stanbul to ANKARA");     // U+0130
+        add_history("kelvin \xe2\x84\xaa scale");      // U+212A
+        add_history_lines(300);
+
+        REQUIRE(search_history("the needle", history_length - 1, -1, false) == 1000);
+        verify_folded_search("the needle", false);
+        verify_folded_search("D500 --FLAG", false);
+        verify_folded_search("istanbul", false);
+        verify_folded_search("\xc4\xb0STANBUL", false);
+        verify_folded_search("ankara", false);
+        verify_folded_search("K scale", false);
+        verify_folded_search("\xe2\x84\xaa SCALE", false);
+        verify_folded_search("KELVIN", false);
+    }
+
+    SECTION("Prefix case folded")
+    {
+        _rl_search_case_fold = 1;
+        add_history("Find THE Needle");
+        add_history("\xc4\xb0stanbul to ANKARA");     // U+0130
+        add_history("\xe2\x84\xaaelvin scale");        // U+212A
+        add_history_lines(300);
+
+        REQUIRE(search_history("FIND the", history_length - 1, -1, true) == 1000);
+        verify_folded_search("FIND the", true);
+        verify_folded_search("CMD77", true);
+        verify_folded_search("istan", true);
+        verify_folded_search("\xc4\xb0STAN", true);
+        verify_folded_search("kelvin", true);
+        verify_folded_search("\xe2\x84\xaaELVIN", true);
+        verify_folded_search("Find THE Needle!", true);
+    }
+
+    SECTION("Changes")
+    {
+        // The index follows removals, replacements, and additions.
+        free_history_entry(remove_history(942));
+        REQUIRE(search_history("arg42", 998, -1, false) == 842);
+
+        free_history_entry(replace_history_entry(10, "replaced arg42", nullptr));
+        REQUIRE(search_history("replaced", 998, -1, false) == 10);
+        REQUIRE(search_history("cmd10 ", 0, 1, true) == -1);
+
+        add_history("newest arg42");
+        REQUIRE(search_history("arg42", 999, -1, false) == 999);
+        REQUIRE(search_history("newest", 0, 1, true) == 999);
+    }
+
+    SECTION("Benchmark")
+    {
+        if (g_show_benchmarks)
+        {
+            clear_history();
+            add_history_lines(1000000);
+            add_history("needle");
+
+            double elapsed[2];
+            for (double& e : elapsed)
+            {
+                const double start = os::clock();
+                REQUIRE(search_history("needle", 0, 1, false) == 1000000);
+                e = os::clock() - start;
+            }
+
+            print_history_benchmark("history search", 1000000, elapsed[0], elapsed[1]);
+        }
+    }
+
+    _rl_search_case_fold = 0;
+    clear_history();
+}
+
+
+
+//------------------------------------------------------------------------------
+static void verify_expansion(const char* in, const char* expected)
+{
+    // Expansions search back from the end of the history.
+    using_history();
+
+    char* out = nullptr;
+    const int ret = history_expand(const_cast<char*>(in), &out);
+    REQUIRE((ret > 0) == (expected != nullptr), [&] () {
+        printf("input:     %s\nret:       %d\noutput:    %s\n", in, ret, out);
+    });
+    if (expected)
+    {
+        REQUIRE(strcmp(out, expected) == 0, [&] () {
+            printf("input:     %s\nexpected:  %s\ngot:       %s\n", in, expected, out);
+        });
+    }
+    free(out);
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("history expansion")
+{
+    clear_history();
+
+    // Enough lines that event searches go through the history index.
+    add_history_lines(1000);
+
+    SECTION("Events")
+    {
+        verify_expansion("!cmd77", "cmd779 --flag arg79");
+        verify_expansion("!?d500 -?:0", "cmd500");
+        verify_expansion("!?arg42?:%", "arg42");
+        verify_expansion("!-3", "cmd997 --flag arg97");
+        verify_expansion("!nomatch", nullptr);
+        verify_expansion("!?nomatch?", nullptr);
+    }
+
+    SECTION("Words")
+    {
+        verify_expansion("!!:$", "arg99");
+        verify_expansion("!!:0-1 !!:*", "cmd999 --flag --flag arg99");
+        verify_expansion("!cmd5:1 !cmd5:$ !cmd5:2*", "--flag arg99 arg99");
+        verify_expansion("!?arg42?:0 !?arg42?:2", "cmd942 arg42");
+    }
+
+    SECTION("Changes")
+    {
+        // Remembered events and words follow changes to the history.
+        verify_expansion("!cmd77", "cmd779 --flag arg79");
+        verify_expansion("!?arg42?:0", "cmd942");
+
+        add_history("cmd77x new arg1");
+        verify_expansion("!cmd77", "cmd77x new arg1");
+        verify_expansion("!!:1", "new");
+
+        free_history_entry(remove_history(1000));
+        verify_expansion("!cmd77", "cmd779 --flag arg79");
+        verify_expansion("!!:1", "--flag");
+
+        free_history_entry(replace_history_entry(779, "cmd77 replaced", nullptr));
+        verify_expansion("!cmd77:1", "replaced");
+
+        free_history_entry(remove_history(942));
+        verify_expansion("!?arg42?:0", "cmd842");
+    }
+
+    SECTION("Benchmark")
+    {
+        if (g_show_benchmarks)
+        {
+            clear_history();
+            add_history("cmd9 --flag arg8 first line");
+            add_history_lines(1000000);
+
+            // Several references to the same events.
+            static const char* const c_input = "!?flag arg8 f?:0 !?flag arg8 f?:3 !?flag arg8 f?:$ !!:0 !!:1 !!:$";
+
+            static const char* const c_expected = "cmd9 first line cmd999999 --flag arg99";
+
+            double elapsed[2];
+            double start = os::clock();
+            verify_expansion(c_input, c_expected);
+            elapsed[0] = os::clock() - start;
+
+            const int count = 1000;
+            start = os::clock();
+            for (int i = 0; i < count; ++i)
+                verify_expansion(c_input, c_expected);
+            elapsed[1] = os::clock() - start;
+
+            print_history_benchmark("history expansion", 1000000, elapsed[0], elapsed[1] / count);
+        }
+    }
+
+    clear_history();
+}
@@ -55,7 +55,7 @@ bool    set_current_dir(const char* dir);
 bool    make_dir(const char* dir);
 bool    remove_dir(const char* dir);
 bool    unlink(const char* path);
-bool    move(const char* src_path, const char* dest_path);
+bool    move(const char* src_path, const char* dest_path, bool replace=false);
 bool    copy(const char* src_path, const char* dest_path);
 bool    get_temp_dir(str_base& out);
 FILE*   create_temp_file(str_base* out=nullptr, const char* prefix=nullptr, const char* ext=nullptr, temp_file_mode mode=normal, const char* path=nullptr);
@@ -4,25 +4,20 @@
 #pragma once
 
 #include "str.h"
-#include "str_map.h"
 
-#include <map>
 #include <vector>
 
 class setting;
 
-//------------------------------------------------------------------------------
-typedef str_map_caseless<setting*>::type setting_map;
-
 //------------------------------------------------------------------------------
 class setting_iter
 {
 public:
-                            setting_iter(setting_map& map);
+                            setting_iter(const std::vector<setting*>& list);
     setting*                next();
 private:
-    setting_map&            m_map;
-    setting_map::iterator   m_iter;
+    const std::vector<setting*>& m_list;
+    size_t                  m_index;
 };
 
 //------------------------------------------------------------------------------
@@ -32,11 +27,22 @@ namespace settings
 const unsigned int c_max_len_name = 32;
 const unsigned int c_max_len_short_desc = 48;
 
+// Handles identify a setting without looking up its name again.  A handle
+// stops resolving once its setting is removed, even if a setting by the same
+// name is added again later.
+typedef unsigned int handle;
+
 setting_iter        first();
 setting*            find(const char* name);
+handle              find_handle(const char* name);
+setting*            from_handle(handle h);
 bool                load(const char* file);
 bool                save(const char* file);
 
+typedef void (*change_handler)(const setting* s);
+void                add_change_handler(change_handler handler);
+void                remove_change_handler(change_handler handler);
+
 bool                sandboxed_set_setting(const char* name, const char* value);
 
 struct setting_name_value
@@ -14,8 +14,10 @@ public:
     explicit        str_iter_impl(const str_impl<T>& s, int len=-1);
                     str_iter_impl(const str_iter_impl<T>& i);
     const T*        get_pointer() const;
+    const T*        get_end() const;
     const T*        get_next_pointer();
     void            reset_pointer(const T* ptr);
+    void            skip_pointer(const T* ptr);
     void            truncate(unsigned int len);
     int             peek();
     int             next();
@@ -54,6 +56,14 @@ template <typename T> const T* str_iter_impl<T>::get_pointer() const
     return m_ptr;
 };
 
+//------------------------------------------------------------------------------
+// Returns nullptr if the iterator ends at a nul terminator instead of at a
+// known length.
+template <typename T> const T* str_iter_impl<T>::get_end() const
+{
+    return (m_end < m_ptr) ? nullptr : m_end;
+};
+
 //------------------------------------------------------------------------------
 template <typename T> const T* str_iter_impl<T>::get_next_pointer()
 {
@@ -72,6 +82,15 @@ template <typename T> void str_iter_impl<T>::reset_pointer(const T* ptr)
     m_ptr = ptr;
 }
 
+//------------------------------------------------------------------------------
+template <typename T> void str_iter_impl<T>::skip_pointer(const T* ptr)
+{
+    assert(ptr);
+    assert(ptr >= m_ptr);
+    assert(m_end < m_ptr || ptr <= m_end);
+    m_ptr = ptr;
+}
+
 //------------------------------------------------------------------------------
 template <typename T> void str_iter_impl<T>::truncate(unsigned int len)
 {
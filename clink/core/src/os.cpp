@@ -310,11 +310,12 @@ bool unlink(const char* path)
 }
 
 //------------------------------------------------------------------------------
-bool move(const char* src_path, const char* dest_path)
+bool move(const char* src_path, const char* dest_path, bool replace)
 {
     wstr<280> wsrc_path(src_path);
     wstr<280> wdest_path(dest_path);
-    if (MoveFileW(wsrc_path.c_str(), wdest_path.c_str()))
+    const DWORD flags = MOVEFILE_COPY_ALLOWED|(replace ? MOVEFILE_REPLACE_EXISTING : 0);
+    if (MoveFileExW(wsrc_path.c_str(), wdest_path.c_str(), flags))
         return true;
 
     map_errno();
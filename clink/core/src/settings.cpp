@@ -4,12 +4,15 @@
 #include "pch.h"
 #include "settings.h"
 #include "str.h"
+#include "str_hash.h"
 #include "str_tokeniser.h"
 #include "path.h"
 
 #include <assert.h>
+#include <algorithm>
 #include <string>
 #include <map>
+#include <vector>
 
 //------------------------------------------------------------------------------
 struct loaded_setting
@@ -24,9 +27,68 @@ struct loaded_setting
 typedef std::map<std::string, loaded_setting> loaded_settings_map;
 
 //------------------------------------------------------------------------------
-static setting_map* g_setting_map = nullptr;
+struct file_identity
+{
+    bool            operator == (const file_identity& rhs) const;
+    unsigned long long size = 0;
+    unsigned long long modified = 0;
+};
+
+//------------------------------------------------------------------------------
+// What the settings file contained the last time it was applied, so that
+// loading it again can skip an unchanged file and otherwise apply only the
+// settings whose values changed.
+struct applied_file
+{
+    str_moveable    name;
+    file_identity   identity;
+    unsigned int    hash = 0;
+    unsigned int    registered = 0;     // s_registered when the loaded map was synced.
+    loaded_settings_map values;
+};
+
+//------------------------------------------------------------------------------
+// Registered settings, found by name through an open addressed hash table.
+// Names are matched caselessly and are interned:  the table refers to each
+// setting's own name instead of copying it.  Each setting occupies a slot, and
+// a handle pairs the slot with the slot's generation so that callers can cache
+// handles and detect when the setting has been removed.
+class setting_registry
+{
+public:
+    setting*        find(const char* name) const;
+    setting*        find(settings::handle h) const;
+    settings::handle find_handle(const char* name) const;
+    void            add(setting* s);
+    bool            remove(setting* s);
+    const std::vector<setting*>& sorted();
+
+private:
+    struct slot
+    {
+        setting*    s;
+        unsigned int hash;
+        unsigned short generation;
+        unsigned char len;
+    };
+
+    int             lookup(const char* name) const;
+    void            grow();
+    std::vector<slot> m_slots;
+    std::vector<unsigned short> m_free;
+    std::vector<unsigned short> m_table;    // Slot index + 1, or 0 if empty.
+    std::vector<setting*> m_sorted;
+    unsigned int    m_count = 0;
+    bool            m_sorted_dirty = true;
+};
+
+//------------------------------------------------------------------------------
+static setting_registry* g_setting_map = nullptr;
 static loaded_settings_map* g_loaded_settings = nullptr;
 static str_moveable* g_last_file = nullptr;
+static applied_file* g_applied_file = nullptr;
+static std::vector<settings::change_handler>* g_change_handlers = nullptr;
+static unsigned int s_registered = 0;   // Changes when settings are added or removed.
 
 #ifdef DEBUG
 static bool s_ever_loaded = false;
@@ -36,7 +98,7 @@ static bool s_ever_loaded = false;
 static auto& get_map()
 {
     if (!g_setting_map)
-        g_setting_map = new setting_map;
+        g_setting_map = new setting_registry;
     return *g_setting_map;
 }
 
@@ -47,24 +109,239 @@ static auto& get_loaded_map()
     return *g_loaded_settings;
 }
 
+static auto& get_change_handlers()
+{
+    if (!g_change_handlers)
+        g_change_handlers = new std::vector<settings::change_handler>;
+    return *g_change_handlers;
+}
+
+
+
+//------------------------------------------------------------------------------
+bool file_identity::operator == (const file_identity& rhs) const
+{
+    return size == rhs.size && modified == rhs.modified;
+}
+
+//------------------------------------------------------------------------------
+static bool get_file_identity(const char* file, file_identity& out)
+{
+    wstr<280> wfile(file);
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    if (!GetFileAttributesExW(wfile.c_str(), GetFileExInfoStandard, &fad))
+        return false;
+
+    out.size = (unsigned long long)fad.nFileSizeHigh << 32 | fad.nFileSizeLow;
+    out.modified = (unsigned long long)fad.ftLastWriteTime.dwHighDateTime << 32 | fad.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Setting names are limited to c_max_len_name characters, so longer names are
+// looked up by their truncated form.
+static unsigned int name_length(const char* name)
+{
+    unsigned int len = 0;
+    while (len < settings::c_max_len_name && name[len])
+        ++len;
+    return len;
+}
+
+//------------------------------------------------------------------------------
+static unsigned int hash_name(const char* name, unsigned int len)
+{
+    unsigned int hash = 5381;
+    for (; len--; ++name)
+    {
+        int c = (unsigned char)*name;
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        hash = ((hash << 5) + hash) ^ c;
+    }
+    return hash;
+}
+
+//------------------------------------------------------------------------------
+int setting_registry::lookup(const char* name) const
+{
+    if (m_table.empty())
+        return -1;
+
+    const unsigned int len = name_length(name);
+    const unsigned int hash = hash_name(name, len);
+    const unsigned int mask = unsigned(m_table.size()) - 1;
+    for (unsigned int i = hash & mask; m_table[i]; i = (i + 1) & mask)
+    {
+        const slot& slot = m_slots[m_table[i] - 1];
+        if (slot.hash == hash && slot.len == len && strnicmp(slot.s->get_name(), name, len) == 0)
+            return m_table[i] - 1;
+    }
+
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+setting* setting_registry::find(const char* name) const
+{
+    const int index = lookup(name);
+    return (index >= 0) ? m_slots[index].s : nullptr;
+}
+
+//------------------------------------------------------------------------------
+setting* setting_registry::find(settings::handle h) const
+{
+    const unsigned int index = (h & 0xffff) - 1;
+    if (index >= m_slots.size())
+        return nullptr;
+
+    const slot& slot = m_slots[index];
+    if (slot.generation != (h >> 16))
+        return nullptr;
+
+    return slot.s;
+}
+
+//------------------------------------------------------------------------------
+settings::handle setting_registry::find_handle(const char* name) const
+{
+    const int index = lookup(name);
+    if (index < 0)
+        return 0;
+
+    return settings::handle(m_slots[index].generation) << 16 | (index + 1);
+}
+
+//------------------------------------------------------------------------------
+void setting_registry::add(setting* s)
+{
+    if ((m_count + 1) * 2 > m_table.size())
+        grow();
+
+    unsigned int index;
+    if (m_free.empty())
+    {
+        index = unsigned(m_slots.size());
+        assert(index < 0xffff);
+        m_slots.push_back({});
+    }
+    else
+    {
+        index = m_free.back();
+        m_free.pop_back();
+    }
+
+    slot& slot = m_slots[index];
+    slot.s = s;
+    slot.len = name_length(s->get_name());
+    slot.hash = hash_name(s->get_name(), slot.len);
+
+    const unsigned int mask = unsigned(m_table.size()) - 1;
+    unsigned int i = slot.hash & mask;
+    while (m_table[i])
+        i = (i + 1) & mask;
+    m_table[i] = index + 1;
+
+    m_count++;
+    m_sorted_dirty = true;
+}
+
+//------------------------------------------------------------------------------
+bool setting_registry::remove(setting* s)
+{
+    const int index = lookup(s->get_name());
+    if (index < 0 || m_slots[index].s != s)
+        return false;
+
+    // Find the table entry, then shift back any later entries in the probe
+    // sequence that would otherwise become unreachable.
+    const unsigned int mask = unsigned(m_table.size()) - 1;
+    unsigned int i = m_slots[index].hash & mask;
+    while (m_table[i] != index + 1)
+        i = (i + 1) & mask;
+
+    for (unsigned int j = (i + 1) & mask; m_table[j]; j = (j + 1) & mask)
+    {
+        const unsigned int home = m_slots[m_table[j] - 1].hash & mask;
+        if (((j - home) & mask) >= ((j - i) & mask))
+        {
+            m_table[i] = m_table[j];
+            i = j;
+        }
+    }
+    m_table[i] = 0;
+
+    slot& slot = m_slots[index];
+    slot.s = nullptr;
+    slot.generation++;
+    m_free.push_back(index);
+
+    m_count--;
+    m_sorted_dirty = true;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void setting_registry::grow()
+{
+    const unsigned int size = m_table.empty() ? 256 : unsigned(m_table.size()) * 2;
+    m_table.clear();
+    m_table.resize(size);
+
+    const unsigned int mask = size - 1;
+    for (unsigned int index = 0; index < m_slots.size(); ++index)
+    {
+        if (!m_slots[index].s)
+            continue;
+
+        unsigned int i = m_slots[index].hash & mask;
+        while (m_table[i])
+            i = (i + 1) & mask;
+        m_table[i] = index + 1;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Settings are only needed in name order when listing them, so the sorted list
+// is rebuilt on demand after settings are added or removed.
+const std::vector<setting*>& setting_registry::sorted()
+{
+    if (m_sorted_dirty)
+    {
+        m_sorted.clear();
+        m_sorted.reserve(m_count);
+        for (const auto& slot : m_slots)
+            if (slot.s)
+                m_sorted.push_back(slot.s);
+
+        std::sort(m_sorted.begin(), m_sorted.end(), [] (const setting* a, const setting* b) {
+            return stricmp(a->get_name(), b->get_name()) < 0;
+        });
+
+        m_sorted_dirty = false;
+    }
+
+    return m_sorted;
+}
+
 
 
 //------------------------------------------------------------------------------
-setting_iter::setting_iter(setting_map& map)
-: m_map(map)
-, m_iter(map.begin())
+setting_iter::setting_iter(const std::vector<setting*>& list)
+: m_list(list)
+, m_index(0)
 {
 }
 
 //------------------------------------------------------------------------------
 setting* setting_iter::next()
 {
-    if (m_iter == m_map.end())
+    if (m_index >= m_list.size())
         return nullptr;
 
-    auto* i = m_iter->second;
-    m_iter++;
-    return i;
+    return m_list[m_index++];
 }
 
 
@@ -75,25 +352,25 @@ namespace settings
 //------------------------------------------------------------------------------
 setting_iter first()
 {
-    return setting_iter(get_map());
+    return setting_iter(get_map().sorted());
 }
 
 //------------------------------------------------------------------------------
 setting* find(const char* name)
 {
-    auto i = get_map().find(name);
-    if (i != get_map().end())
-        return i->second;
+    return get_map().find(name);
+}
 
-    size_t len = strlen(name);
-    if (len > c_max_len_name)
-    {
-        str<> trunc_name(name);
-        trunc_name.truncate(c_max_len_name);
-        return find(trunc_name.c_str());
-    }
+//------------------------------------------------------------------------------
+handle find_handle(const char* name)
+{
+    return get_map().find_handle(name);
+}
 
-    return nullptr;
+//------------------------------------------------------------------------------
+setting* from_handle(handle h)
+{
+    return get_map().find(h);
 }
 
 //------------------------------------------------------------------------------
@@ -126,6 +403,68 @@ static bool set_setting(const char* name, const char* value, const char* comment
     return s->set(value);
 }
 
+//------------------------------------------------------------------------------
+// Resets a setting and applies a value to it; if the value is invalid the
+// setting is left at its default, the same as when loading all the settings.
+static void apply_setting(setting* s, const char* value)
+{
+    str<> before;
+    str<> after;
+    s->get(before);
+    s->set();
+    if (value)
+        s->set(value);
+    s->get(after);
+
+    if (!before.equals(after.c_str()))
+        for (auto handler : get_change_handlers())
+            handler(s);
+}
+
+//------------------------------------------------------------------------------
+// The loaded map holds the values from the file for settings that aren't
+// registered, e.g. settings declared by scripts that haven't been loaded (or
+// have been unloaded).  It only needs to be synced when settings have been
+// added or removed since the last time.
+static void sync_loaded_map(applied_file& applied, bool force=false)
+{
+    if (!force && applied.registered == s_registered)
+        return;
+
+    auto& loaded = get_loaded_map();
+    loaded.clear();
+    for (const auto& value : applied.values)
+        if (!settings::find(value.first.c_str()))
+            loaded.emplace(value.first, value.second);
+
+    applied.registered = s_registered;
+}
+
+//------------------------------------------------------------------------------
+static void forget_applied_file()
+{
+    delete g_applied_file;
+    g_applied_file = nullptr;
+}
+
+//------------------------------------------------------------------------------
+void add_change_handler(change_handler handler)
+{
+    get_change_handlers().push_back(handler);
+}
+
+//------------------------------------------------------------------------------
+void remove_change_handler(change_handler handler)
+{
+    auto& handlers = get_change_handlers();
+    for (auto iter = handlers.begin(); iter != handlers.end(); ++iter)
+        if (*iter == handler)
+        {
+            handlers.erase(iter);
+            break;
+        }
+}
+
 //------------------------------------------------------------------------------
 bool migrate_setting(const char* name, const char* value, std::vector<setting_name_value>& out)
 {
@@ -245,7 +584,7 @@ bool migrate_setting(const char* name, const char* value, std::vector<setting_na
 static bool save_internal(const char* file, bool migrating);
 
 //------------------------------------------------------------------------------
-bool load(const char* file)
+static bool load_internal(const char* file, bool use_applied)
 {
 #ifdef DEBUG
     s_ever_loaded = true;
@@ -256,7 +595,16 @@ bool load(const char* file)
     if (file != g_last_file->c_str())
         *g_last_file = file;
 
-    get_loaded_map().clear();
+    // Nothing needs to be applied if the file hasn't changed since the last
+    // time it was applied.
+    file_identity identity;
+    const bool have_identity = get_file_identity(file, identity);
+    applied_file* applied = (use_applied && g_applied_file && g_applied_file->name.equals(file)) ? g_applied_file : nullptr;
+    if (applied && have_identity && applied->identity == identity)
+    {
+        sync_loaded_map(*applied);
+        return true;
+    }
 
     // Maybe migrate settings.
     str<> old_file;
@@ -268,12 +616,18 @@ bool load(const char* file)
     {
         // If there's no (new name) settings file, try to migrate from the old
         // name settings file.
+        get_loaded_map().clear();
         path::get_directory(file, old_file);
         path::append(old_file, "settings");
         in = fopen(old_file.c_str(), "rb");
         if (in == nullptr)
+        {
+            if (use_applied)
+                forget_applied_file();
             return false;
+        }
         migrating = true;
+        applied = nullptr;
     }
 
     // Buffer the file.
@@ -284,6 +638,9 @@ bool load(const char* file)
     if (size == 0)
     {
         fclose(in);
+        get_loaded_map().clear();
+        if (use_applied)
+            forget_applied_file();
         return false;
     }
 
@@ -295,11 +652,17 @@ bool load(const char* file)
     fclose(in);
     data[size] = '\0';
 
-    // Reset settings to default.
-    for (auto iter = settings::first(); auto* next = iter.next();)
-        next->set();
+    // The file may have been written again without changing.
+    const unsigned int hash = str_hash(buffer.c_str(), size);
+    if (applied && hash == applied->hash)
+    {
+        applied->identity = identity;
+        sync_loaded_map(*applied);
+        return true;
+    }
 
     // Split at new lines.
+    loaded_settings_map values;
     bool was_comment = false;
     str<> comment;
     str<256> line;
@@ -349,24 +712,82 @@ bool load(const char* file)
             if (migrate_setting(line_data, value, migrated_settings))
             {
                 for (const auto& pair : migrated_settings)
-                    set_setting(pair.name.c_str(), pair.value.c_str());
+                    values[pair.name.c_str()].value = pair.value.c_str();
             }
             continue;
         }
 
-        // Find the setting and set its value.
-        set_setting(line_data, value, comment.c_str());
+        loaded_setting& loaded = values[line_data];
+        loaded.comment = comment.c_str();
+        loaded.value = value;
+    }
+
+    if (!applied)
+    {
+        // Reset settings to default and apply all of the values.
+        for (auto iter = settings::first(); auto* next = iter.next();)
+            next->set();
+        for (const auto& value : values)
+            if (setting* s = settings::find(value.first.c_str()))
+                s->set(value.second.value.c_str());
+
+        if (use_applied)
+            for (auto handler : get_change_handlers())
+                handler(nullptr);
+    }
+    else
+    {
+        // Apply only the values that were removed, added, or changed.
+        for (const auto& old_value : applied->values)
+            if (values.find(old_value.first) == values.end())
+                if (setting* s = settings::find(old_value.first.c_str()))
+                    apply_setting(s, nullptr);
+
+        for (const auto& value : values)
+        {
+            const auto old_value = applied->values.find(value.first);
+            if (old_value != applied->values.end() && old_value->second.value == value.second.value)
+                continue;
+            if (setting* s = settings::find(value.first.c_str()))
+                apply_setting(s, value.second.value.c_str());
+        }
+    }
+
+    // Remember what was applied.  Sandboxed loads and migrations only need
+    // the loaded map.
+    applied_file temp;
+    applied_file* remember = &temp;
+    if (use_applied && !migrating)
+    {
+        if (!g_applied_file)
+            g_applied_file = new applied_file;
+        remember = g_applied_file;
     }
+    remember->name = file;
+    remember->identity = identity;
+    remember->hash = hash;
+    remember->values = std::move(values);
+    sync_loaded_map(*remember, true/*force*/);
 
     // When migrating, ensure the new settings file is created so that the old
     // settings file can be deleted.  Some users or distributions may naturally
     // clean up the old settings file, so don't rely on it staying around.
     if (migrating)
+    {
         save_internal(file, migrating);
+        if (use_applied)
+            forget_applied_file();
+    }
 
     return true;
 }
 
+//------------------------------------------------------------------------------
+bool load(const char* file)
+{
+    return load_internal(file, true/*use_applied*/);
+}
+
 //------------------------------------------------------------------------------
 static bool save_internal(const char* file, bool migrating)
 {
@@ -382,9 +803,8 @@ static bool save_internal(const char* file, bool migrating)
         iter.second.saved = false;
 
     // Iterate over each setting and write it out to the file.
-    for (auto i : get_map())
+    for (setting* iter : get_map().sorted())
     {
-        setting* iter = i.second;
         auto loaded = get_loaded_map().find(iter->get_name());
         if (loaded != get_loaded_map().end())
             loaded->second.saved = true;
@@ -467,11 +887,12 @@ bool sandboxed_set_setting(const char* name, const char* value)
     const char* file = g_last_file->c_str();
 
     // Swap real settings data structures with new temporary versions.
-    rollback<setting_map*> rb_map(g_setting_map, new setting_map);
+    rollback<setting_registry*> rb_map(g_setting_map, new setting_registry);
     rollback<loaded_settings_map*> rb_loaded(g_loaded_settings, new loaded_settings_map);
 
-    // Load settings.
-    return (load(file) &&
+    // Load settings.  The temporary maps are empty, so the file must be read
+    // again regardless whether it changed.
+    return (load_internal(file, false/*use_applied*/) &&
             set_setting(name, value) &&
             save(file));
 }
@@ -495,16 +916,15 @@ setting::setting(
     assert(strlen(short_desc) == m_short_desc.length());
     assert(!settings::find(m_name.c_str()));
 
-    get_map()[m_name.c_str()] = this;
+    get_map().add(this);
+    s_registered++;
 }
 
 //------------------------------------------------------------------------------
 setting::~setting()
 {
-    auto i = settings::find(m_name.c_str());
-
-    if (i && i == this)
-        get_map().erase(m_name.c_str());
+    if (get_map().remove(this))
+        s_registered++;
 }
 
 //------------------------------------------------------------------------------
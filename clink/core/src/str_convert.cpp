@@ -9,6 +9,21 @@
 #include <assert.h>
 #endif
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#   define STR_CONVERT_USE_SSE2
+#   include <emmintrin.h>
+#endif
+
+// The aligned loads in ascii_run() can read past a nul terminator within the
+// same 16 byte block, which is safe but looks like an overflow to ASan.
+#if defined(__SANITIZE_ADDRESS__) && defined(_MSC_VER)
+#   define NO_SANITIZE_ADDRESS __declspec(no_sanitize_address)
+#elif defined(__SANITIZE_ADDRESS__)
+#   define NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#else
+#   define NO_SANITIZE_ADDRESS
+#endif
+
 //------------------------------------------------------------------------------
 template <typename TYPE>
 struct builder
@@ -62,6 +77,126 @@ builder<char>& builder<char>::operator << (int value)
 
 
 
+//------------------------------------------------------------------------------
+#if defined(STR_CONVERT_USE_SSE2)
+static unsigned int first_set_bit(unsigned int mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Returns how many of the first max units of s are ASCII (1-0x7f).  ASCII
+// converts one-to-one between UTF8 and UTF16, so a run of it can be copied
+// directly instead of being decoded and encoded one codepoint at a time.
+NO_SANITIZE_ADDRESS static unsigned int ascii_run(const char* s, unsigned int max)
+{
+    unsigned int i = 0;
+
+#if defined(STR_CONVERT_USE_SSE2)
+    // Use aligned loads, so that an unbounded run can scan to the nul
+    // terminator without knowing the length:  an aligned block that contains
+    // part of the string can't cross into an unmapped page.
+    for (; i < max && (uintptr_t(s + i) & 15); ++i)
+    {
+        const unsigned char c = s[i];
+        if (!c || c >= 0x80)
+            return i;
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    for (; max - i >= 16; i += 16)
+    {
+        // The high bit is set for non-ASCII, and for nul after the compare.
+        const __m128i v = _mm_load_si128((const __m128i*)(s + i));
+        const unsigned int mask = _mm_movemask_epi8(_mm_or_si128(v, _mm_cmpeq_epi8(v, zero)));
+        if (mask)
+            return i + first_set_bit(mask);
+    }
+#endif
+
+    for (; i < max; ++i)
+    {
+        const unsigned char c = s[i];
+        if (!c || c >= 0x80)
+            break;
+    }
+
+    return i;
+}
+
+//------------------------------------------------------------------------------
+NO_SANITIZE_ADDRESS static unsigned int ascii_run(const wchar_t* s, unsigned int max)
+{
+    unsigned int i = 0;
+
+#if defined(STR_CONVERT_USE_SSE2)
+    for (; i < max && (uintptr_t(s + i) & 15); ++i)
+    {
+        const wchar_t c = s[i];
+        if (!c || c >= 0x80)
+            return i;
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i high = _mm_set1_epi16(short(0xff80));
+    for (; max - i >= 8; i += 8)
+    {
+        // Each unit yields two mask bits, set when the unit is 1-0x7f.
+        const __m128i v = _mm_load_si128((const __m128i*)(s + i));
+        const __m128i ascii = _mm_andnot_si128(_mm_cmpeq_epi16(v, zero), _mm_cmpeq_epi16(_mm_and_si128(v, high), zero));
+        const unsigned int mask = _mm_movemask_epi8(ascii) ^ 0xffff;
+        if (mask)
+            return i + first_set_bit(mask) / 2;
+    }
+#endif
+
+    for (; i < max; ++i)
+    {
+        const wchar_t c = s[i];
+        if (!c || c >= 0x80)
+            break;
+    }
+
+    return i;
+}
+
+//------------------------------------------------------------------------------
+// Copies the run of ASCII at the iterator into the builder, and returns whether
+// anything was copied.
+template <typename FROM, typename TO>
+static bool copy_ascii_run(str_iter_impl<FROM>& iter, builder<TO>& builder)
+{
+    // An unbounded iterator ends at its nul terminator, which ends the run.
+    const FROM* ptr = iter.get_pointer();
+    const FROM* end = iter.get_end();
+    unsigned int max = end ? unsigned(end - ptr) : ~0u;
+    if (builder.start)
+        max = min<unsigned int>(max, unsigned(builder.end - builder.write));
+
+    const unsigned int run = ascii_run(ptr, max);
+    if (!run)
+        return false;
+
+    if (builder.start)
+    {
+        for (unsigned int i = 0; i < run; ++i)
+            builder.write[i] = TO(ptr[i]);
+    }
+
+    builder.write += run;
+    iter.skip_pointer(ptr + run);
+    return true;
+}
+
+
+
 //------------------------------------------------------------------------------
 int to_utf8(char* out, int max_count, wstr_iter& iter)
 {
@@ -98,8 +233,14 @@ int to_utf8(char* out, int max_count, wstr_iter& iter)
     builder<char> builder(out, max_count);
 
     int c;
-    while (!builder.truncated() && (c = iter.next()))
+    while (!builder.truncated())
     {
+        if (copy_ascii_run(iter, builder))
+            continue;
+
+        if (!(c = iter.next()))
+            break;
+
         if (c < 0x80)
         {
             builder << c;
@@ -199,8 +340,16 @@ int to_utf16(wchar_t* out, int max_count, str_iter& iter)
     builder<wchar_t> builder(out, max_count);
 
     int c;
-    while (!builder.truncated() && (c = iter.next()))
+    while (!builder.truncated())
+    {
+        if (copy_ascii_run(iter, builder))
+            continue;
+
+        if (!(c = iter.next()))
+            break;
+
         builder << c;
+    }
 
     return builder.get_written();
 }
@@ -2,10 +2,15 @@
 // License: http://opensource.org/licenses/MIT
 
 #include "pch.h"
+#include "fs_fixture.h"
 
 #include <core/base.h>
+#include <core/os.h>
+#include <core/path.h>
 #include <core/settings.h>
 
+extern bool g_show_benchmarks;
+
 //------------------------------------------------------------------------------
 TEST_CASE("settings : basic")
 {
@@ -68,6 +73,119 @@ TEST_CASE("settings : list")
     REQUIRE(settings::first().next() == first);
 }
 
+//------------------------------------------------------------------------------
+TEST_CASE("settings : find")
+{
+    auto* test = new setting_int("!find.Setting", "", nullptr, 0);
+
+    SECTION("Name")
+    {
+        REQUIRE(settings::find("!find.Setting") == test);
+        REQUIRE(settings::find("!FIND.setting") == test);
+        REQUIRE(settings::find("!find.Settin") == nullptr);
+        REQUIRE(settings::find("!find.Settings") == nullptr);
+    }
+
+    SECTION("Truncated")
+    {
+        // Names longer than the limit are looked up by their truncated form.
+        setting_int trunc("!find.01234567890123456789012345", "", nullptr, 0);
+        REQUIRE(strlen(trunc.get_name()) == settings::c_max_len_name);
+        REQUIRE(settings::find(trunc.get_name()) == &trunc);
+        REQUIRE(settings::find("!find.0123456789012345678901234567890123") == &trunc);
+    }
+
+    SECTION("Handle")
+    {
+        const settings::handle h = settings::find_handle("!FIND.SETTING");
+        REQUIRE(h != 0);
+        REQUIRE(settings::from_handle(h) == test);
+        REQUIRE(settings::find_handle("!find.nope") == 0);
+        REQUIRE(settings::from_handle(0) == nullptr);
+
+        // Handles don't resolve once their setting is removed, even if another
+        // setting reuses its name.
+        delete test;
+        test = nullptr;
+        REQUIRE(settings::from_handle(h) == nullptr);
+
+        setting_int again("!find.Setting", "", nullptr, 0);
+        REQUIRE(settings::from_handle(h) == nullptr);
+        REQUIRE(settings::from_handle(settings::find_handle("!find.setting")) == &again);
+    }
+
+    SECTION("Many")
+    {
+        // Enough settings to grow the table and reuse removed slots.
+        std::vector<setting_int*> many;
+        str<> name;
+        for (int i = 0; i < 1000; ++i)
+        {
+            name.format("!find.many%d", i);
+            many.push_back(new setting_int(name.c_str(), "", nullptr, i));
+        }
+
+        for (int i = 0; i < 1000; i += 2)
+        {
+            delete many[i];
+            many[i] = nullptr;
+        }
+
+        for (int i = 0; i < 1000; ++i)
+        {
+            name.format("!find.many%d", i);
+            REQUIRE(settings::find(name.c_str()) == many[i]);
+        }
+
+        REQUIRE(settings::find("!find.setting") == test);
+
+        for (auto* s : many)
+            delete s;
+    }
+
+    delete test;
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("settings : lookup benchmark")
+{
+    if (!g_show_benchmarks)
+        return;
+
+    const char* names[] = {
+        "!bench.color.input", "!bench.clink.colorize_input", "!bench.match.ignore_case",
+        "!bench.history.dupe_mode", "!bench.color.argmatcher", "!bench.terminal.emulation",
+    };
+
+    std::vector<setting_int*> added;
+    for (const char* name : names)
+        added.push_back(new setting_int(name, "", nullptr, 0));
+
+    const settings::handle h = settings::find_handle(names[0]);
+    REQUIRE(h != 0);
+
+    const int count = 1000000;
+    const setting* found = nullptr;
+
+    double start = os::clock();
+    for (int i = 0; i < count; ++i)
+        found = settings::find(names[i % sizeof_array(names)]);
+    const double by_name = os::clock() - start;
+    REQUIRE(found != nullptr);
+
+    start = os::clock();
+    for (int i = 0; i < count; ++i)
+        found = settings::from_handle(h);
+    const double by_handle = os::clock() - start;
+    REQUIRE(found != nullptr);
+
+    printf("\nsettings lookup x%d:  %.1f msec by name, %.1f msec by handle\n",
+           count, by_name * 1000, by_handle * 1000);
+
+    for (auto* s : added)
+        delete s;
+}
+
 //------------------------------------------------------------------------------
 TEST_CASE("settings : bool")
 {
@@ -204,3 +322,99 @@ TEST_CASE("settings : color")
     test.get_descriptive(tmp);
     REQUIRE(tmp.equals("bright yellow"));
 }
+
+//------------------------------------------------------------------------------
+static void write_settings_file(const char* file, const char* content)
+{
+    FILE* f = fopen(file, "wb");
+    REQUIRE(f != nullptr);
+    fputs(content, f);
+    fclose(f);
+}
+
+//------------------------------------------------------------------------------
+static int s_changes = 0;
+static const setting* s_last_changed = nullptr;
+static void on_setting_changed(const setting* s)
+{
+    s_changes++;
+    s_last_changed = s;
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("settings : reload")
+{
+    const char* empty_fs[] = { nullptr };
+    fs_fixture fs(empty_fs);
+
+    str<> file;
+    path::join(fs.get_root(), "clink_settings", file);
+
+    setting_int test_int("!reload.int", "", "", 1);
+    setting_str test_str("!reload.str", "", "", "abc");
+
+    write_settings_file(file.c_str(), "!reload.int = 5\n!reload.str = xyz\n!reload.later = 42\n");
+    REQUIRE(settings::load(file.c_str()));
+    REQUIRE(test_int.get() == 5);
+    REQUIRE(strcmp(test_str.get(), "xyz") == 0);
+
+    settings::add_change_handler(on_setting_changed);
+    s_changes = 0;
+    s_last_changed = nullptr;
+
+    SECTION("Unchanged")
+    {
+        // An unchanged file isn't applied again.
+        REQUIRE(test_int.set("7"));
+        REQUIRE(settings::load(file.c_str()));
+        REQUIRE(test_int.get() == 7);
+
+        write_settings_file(file.c_str(), "!reload.int = 5\n!reload.str = xyz\n!reload.later = 42\n");
+        REQUIRE(settings::load(file.c_str()));
+        REQUIRE(test_int.get() == 7);
+        REQUIRE(s_changes == 0);
+    }
+
+    SECTION("Changed")
+    {
+        // Only the settings whose values changed in the file are applied.
+        REQUIRE(test_str.set("in memory"));
+        write_settings_file(file.c_str(), "!reload.int = 16\n!reload.str = xyz\n!reload.later = 42\n");
+        REQUIRE(settings::load(file.c_str()));
+        REQUIRE(test_int.get() == 16);
+        REQUIRE(strcmp(test_str.get(), "in memory") == 0);
+        REQUIRE(s_changes == 1);
+        REQUIRE(s_last_changed == &test_int);
+    }
+
+    SECTION("Removed")
+    {
+        // Settings removed from the file revert to their defaults.
+        write_settings_file(file.c_str(), "!reload.str = xyz\n");
+        REQUIRE(settings::load(file.c_str()));
+        REQUIRE(test_int.get() == 1);
+        REQUIRE(strcmp(test_str.get(), "xyz") == 0);
+        REQUIRE(s_changes == 1);
+        REQUIRE(s_last_changed == &test_int);
+    }
+
+    SECTION("Not registered")
+    {
+        // Values for settings that aren't registered are available when the
+        // settings are added, even after being removed and added again.
+        {
+            setting_int later("!reload.later", "", "", 0);
+            later.deferred_load();
+            REQUIRE(later.get() == 42);
+        }
+
+        REQUIRE(settings::load(file.c_str()));
+
+        setting_int later("!reload.later", "", "", 0);
+        later.deferred_load();
+        REQUIRE(later.get() == 42);
+        REQUIRE(s_changes == 0);
+    }
+
+    settings::remove_change_handler(on_setting_changed);
+}
@@ -3,9 +3,93 @@
 
 #include "pch.h"
 
+#include <core/os.h>
 #include <core/str.h>
 #include <core/str_iter.h>
 
+#include <string>
+#include <vector>
+
+extern bool g_show_benchmarks;
+
+//------------------------------------------------------------------------------
+// Straightforward one codepoint at a time conversions, with the same
+// truncation and termination behavior as to_utf16() and to_utf8().
+static int reference_to_utf16(wchar_t* out, int max_count, str_iter& iter)
+{
+    int written = 0;
+    auto put = [&] (int value) {
+        if (!out)
+            written++;
+        else if (written < max_count - 1)
+            out[written++] = wchar_t(value);
+    };
+
+    int c;
+    while ((!out || written < max_count - 1) && (c = iter.next()))
+    {
+        if (c > 0xffff)
+        {
+            put((c >> 10) + 0xd7c0);
+            put((c & 0x3ff) + 0xdc00);
+        }
+        else
+            put(c);
+    }
+
+    if (out && max_count > 0)
+        out[written] = '\0';
+    return written;
+}
+
+//------------------------------------------------------------------------------
+static int reference_to_utf8(char* out, int max_count, wstr_iter& iter)
+{
+    int written = 0;
+    auto put = [&] (int value) {
+        if (!out)
+            written++;
+        else if (written < max_count - 1)
+            out[written++] = char(value);
+    };
+
+    int c;
+    while ((!out || written < max_count - 1) && (c = iter.next()))
+    {
+        if (c < 0x80)
+            put(c);
+        else if (c < 0x800)
+        {
+            put(0xc0 | (c >> 6));
+            put(0x80 | (c & 0x3f));
+        }
+        else if (c < 0x10000)
+        {
+            put(0xe0 | ((c >> 12) & 0x0f));
+            put(0x80 | ((c >> 6) & 0x3f));
+            put(0x80 | (c & 0x3f));
+        }
+        else
+        {
+            put(0xf0 | ((c >> 18) & 0x07));
+            put(0x80 | ((c >> 12) & 0x3f));
+            put(0x80 | ((c >> 6) & 0x3f));
+            put(0x80 | (c & 0x3f));
+        }
+    }
+
+    if (out && max_count > 0)
+        out[written] = '\0';
+    return written;
+}
+
+//------------------------------------------------------------------------------
+struct fuzz_random
+{
+    unsigned int next(unsigned int n) { seed = seed * 1103515245 + 12345; return (seed >> 8) % n; }
+    unsigned int seed = 1;
+};
+
 //------------------------------------------------------------------------------
 TEST_CASE("Wide character/UTF-8 conversion")
 {
@@ -168,3 +252,126 @@ TEST_CASE("Wide character/UTF-8 conversion")
         }
     }
 }
+
+//------------------------------------------------------------------------------
+TEST_CASE("Wide character/UTF-8 conversion fast path")
+{
+    fuzz_random rand;
+
+    SECTION("Fuzz to UTF-16")
+    {
+        for (int round = 0; round < 2000; ++round)
+        {
+            // Mix ASCII runs with valid, overlong, truncated, and stray
+            // multibyte sequences, and the occasional nul.
+            std::string in;
+            while (in.length() < 100)
+            {
+                switch (rand.next(8))
+                {
+                case 0:     in.push_back(char(0x80 + rand.next(0x80))); break;
+                case 1:     in.append("\xc3\xa9"); break;
+                case 2:     in.append("\xe2\x94\x80"); break;
+                case 3:     in.append("\xf0\x9f\x98\x80"); break;
+                case 4:     in.append("\xc0\x8a"); break;
+                case 5:     if (!rand.next(4)) in.push_back('\0'); break;
+                default:
+                    for (unsigned int n = rand.next(40); n--;)
+                        in.push_back(char(0x20 + rand.next(0x5f)));
+                    break;
+                }
+            }
+
+            const int len = rand.next(2) ? int(in.length()) : -1;
+            const int max_count = rand.next(4) ? rand.next(160) : 0;
+            wchar_t out[160];
+            wchar_t expected[160];
+
+            str_iter iter(in.c_str(), len);
+            str_iter expected_iter(in.c_str(), len);
+            const int written = to_utf16(max_count ? out : nullptr, max_count, iter);
+            REQUIRE(written == reference_to_utf16(max_count ? expected : nullptr, max_count, expected_iter));
+            REQUIRE(iter.get_pointer() == expected_iter.get_pointer());
+            if (max_count)
+                REQUIRE(memcmp(out, expected, (written + 1) * sizeof(*out)) == 0);
+        }
+    }
+
+    SECTION("Fuzz to UTF-8")
+    {
+        for (int round = 0; round < 2000; ++round)
+        {
+            // Mix ASCII runs with BMP characters, surrogate pairs, lone
+            // surrogates, and the occasional nul.
+            std::wstring in;
+            while (in.length() < 100)
+            {
+                switch (rand.next(8))
+                {
+                case 0:     in.push_back(wchar_t(0x80 + rand.next(0xff80))); break;
+                case 1:     in.append(L"\xd83d\xde00"); break;
+                case 2:     in.push_back(wchar_t(0xd800 + rand.next(0x800))); break;
+                case 3:     in.push_back(wchar_t(0x80 + rand.next(0x780))); break;
+                case 4:     if (!rand.next(4)) in.push_back('\0'); break;
+                default:
+                    for (unsigned int n = rand.next(40); n--;)
+                        in.push_back(wchar_t(0x20 + rand.next(0x5f)));
+                    break;
+                }
+            }
+
+            const int len = rand.next(2) ? int(in.length()) : -1;
+            const int max_count = rand.next(4) ? rand.next(400) : 0;
+            char out[400];
+            char expected[400];
+
+            wstr_iter iter(in.c_str(), len);
+            wstr_iter expected_iter(in.c_str(), len);
+            const int written = to_utf8(max_count ? out : nullptr, max_count, iter);
+            REQUIRE(written == reference_to_utf8(max_count ? expected : nullptr, max_count, expected_iter));
+            REQUIRE(iter.get_pointer() == expected_iter.get_pointer());
+            if (max_count)
+                REQUIRE(memcmp(out, expected, written + 1) == 0);
+        }
+    }
+
+    SECTION("Benchmark")
+    {
+        if (g_show_benchmarks)
+        {
+            // Mostly ASCII text, such as file names, history lines, and console
+            // output, round tripped through a large buffer many times.
+            std::string in;
+            while (in.length() < 256 * 1024)
+            {
+                in.append("c:\\src\\clink\\clink\\core\\src\\str_convert.cpp ");
+                if (!rand.next(16))
+                    in.append("\xc3\xa9\xe2\x94\x80 ");
+            }
+
+            std::vector<wchar_t> wide(in.length() + 1);
+            std::vector<char> narrow(in.length() + 1);
+            const int passes = 50;
+            double elapsed[2] = {};
+            for (int pass = 0; pass < passes; ++pass)
+            {
+                // Unbounded, like most callers.
+                double start = os::clock();
+                str_iter iter(in.c_str());
+                const int wide_len = to_utf16(wide.data(), int(wide.size()), iter);
+                elapsed[0] += os::clock() - start;
+                REQUIRE(!iter.more());
+
+                start = os::clock();
+                wstr_iter witer(wide.data());
+                const int narrow_len = to_utf8(narrow.data(), int(narrow.size()), witer);
+                elapsed[1] += os::clock() - start;
+                REQUIRE(narrow_len == int(in.length()));
+            }
+
+            REQUIRE(memcmp(narrow.data(), in.c_str(), in.length() + 1) == 0);
+            printf("\nstr convert, %u bytes:  %.3f msec to_utf16, %.3f msec to_utf8\n",
+                   unsigned(in.length()), elapsed[0] * 1000 / passes, elapsed[1] * 1000 / passes);
+        }
+    }
+}
@@ -19,7 +19,7 @@ public:
     virtual void suggest(line_state& line, matches& matches) = 0;
     virtual void filter_matches(char** matches) = 0;
     virtual bool call_lua_rl_global_function(const char* func_name, line_state* line) = 0;
-    virtual const char** copy_dir_history(int* total) = 0;
+    virtual const char** copy_dir_history(int* total, bool ranked) = 0;
     virtual void send_event(const char* event_name) = 0;
     virtual void get_app_context(int& id, str_base& binaries, str_base& profile, str_base& scripts) = 0;
 };
@@ -0,0 +1,54 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+class match_builder;
+
+//------------------------------------------------------------------------------
+// Provides the screen text scanned by screen_grab().  Lines are fixed width
+// rows of characters, and are read in blocks of consecutive rows.
+class screen_line_source
+{
+public:
+    virtual         ~screen_line_source() = default;
+    virtual bool    get_range(int& top, int& bottom, int& width) = 0;
+    virtual bool    read_lines(int first, int count, wchar_t* out) = 0;
+};
+
+//------------------------------------------------------------------------------
+// Reads the visible lines of the console screen buffer.
+class console_line_source : public screen_line_source
+{
+public:
+                    console_line_source(void* handle);
+    virtual bool    get_range(int& top, int& bottom, int& width) override;
+    virtual bool    read_lines(int first, int count, wchar_t* out) override;
+
+private:
+    void*           m_handle;
+    int             m_width = 0;
+};
+
+//------------------------------------------------------------------------------
+// Tokens are maximal runs of token characters that are at least a minimum
+// length, and a token is accepted when all of its characters are accept
+// characters.  Only ASCII characters can be token characters.
+class screen_token_pattern
+{
+public:
+                    screen_token_pattern(int (*is_token)(int), int (*is_accept)(int), unsigned int min_length);
+    bool            is_token(wchar_t c) const { return c < 128 && (m_classes[c] & token_char); }
+    bool            is_accept(wchar_t c) const { return c < 128 && (m_classes[c] & accept_char); }
+    unsigned int    get_min_length() const { return m_min_length; }
+
+    static const screen_token_pattern& numbers();
+
+private:
+    enum : unsigned char { token_char = 0x01, accept_char = 0x02 };
+    unsigned char   m_classes[128];
+    unsigned int    m_min_length;
+};
+
+//------------------------------------------------------------------------------
+unsigned int screen_grab(screen_line_source& source, const screen_token_pattern& pattern, match_builder& builder);
@@ -59,6 +59,7 @@ public:
     bool            get_word_class(unsigned int index, word_class& wc) const;
     char            get_face(unsigned int pos) const;
     const char*     get_face_output(char face) const;
+    const char*     get_face_sgr(char face) const;
 
     char            ensure_face(const char* sgr);
     void            apply_face(unsigned int start, unsigned int len, char face, bool overwrite=true);
@@ -66,8 +67,10 @@ public:
     bool            is_word_classified(unsigned int index);
 
 private:
+    char            add_face(const char* sgr);
     std::vector<word_class_info> m_info;
     std::vector<str_moveable> m_face_definitions;
+    std::vector<str_moveable> m_face_sgr;   // Complete SGR escape codes, parallel to m_face_definitions.
     char*           m_faces = nullptr;
     unsigned int    m_length = 0;
     faces_map       m_face_map;             // Points into m_face_definitions.
@@ -0,0 +1,189 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "alias_cache.h"
+
+#include <core/base.h>
+#include <core/str.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <wctype.h>
+
+//------------------------------------------------------------------------------
+class console_alias_provider : public alias_provider
+{
+public:
+    virtual void    begin(const wchar_t* shell_name) override;
+    virtual bool    next(const wchar_t*& name, const wchar_t*& text) override;
+
+private:
+    std::vector<wchar_t> m_buffer;
+    size_t          m_next = 0;
+};
+
+//------------------------------------------------------------------------------
+void console_alias_provider::begin(const wchar_t* shell_name)
+{
+    m_buffer.clear();
+    m_next = 0;
+
+    // Not const because Windows' alias API won't accept it.
+    wchar_t* shell = const_cast<wchar_t*>(shell_name);
+
+    // The lengths are in bytes.
+    const DWORD bytes = GetConsoleAliasesLengthW(shell);
+    if (!bytes)
+        return;
+
+    m_buffer.resize(bytes / sizeof(wchar_t) + 1);
+    const DWORD got = GetConsoleAliasesW(m_buffer.data(), DWORD(m_buffer.size() * sizeof(wchar_t)), shell);
+    m_buffer.resize(got / sizeof(wchar_t));
+    m_buffer.push_back('\0');
+}
+
+//------------------------------------------------------------------------------
+bool console_alias_provider::next(const wchar_t*& name, const wchar_t*& text)
+{
+    // The buffer holds "name=text" strings, each followed by a nul.
+    while (m_next + 1 < m_buffer.size())
+    {
+        wchar_t* entry = m_buffer.data() + m_next;
+        m_next += wcslen(entry) + 1;
+
+        wchar_t* equals = wcschr(entry, '=');
+        if (!equals || equals == entry)
+            continue;
+
+        *equals = '\0';
+        name = entry;
+        text = equals + 1;
+        return true;
+    }
+
+    return false;
+}
+
+
+
+//------------------------------------------------------------------------------
+struct alias_snapshot
+{
+    wstr_moveable   shell_name;
+    unsigned int    generation;
+    std::unordered_map<std::wstring, std::string> aliases;
+};
+
+//------------------------------------------------------------------------------
+static console_alias_provider s_console_provider;
+static alias_provider* s_provider = &s_console_provider;
+static std::vector<alias_snapshot> s_snapshots;
+static unsigned int s_generation = 1;
+
+//------------------------------------------------------------------------------
+// The console matches alias names caselessly.
+static void fold_name(const wchar_t* name, std::wstring& out)
+{
+    out.clear();
+    for (; *name; ++name)
+        out.push_back(wchar_t(towlower(*name)));
+}
+
+//------------------------------------------------------------------------------
+static alias_snapshot& get_snapshot(const wchar_t* shell_name)
+{
+    alias_snapshot* snapshot = nullptr;
+    for (auto& s : s_snapshots)
+    {
+        if (wcscmp(s.shell_name.c_str(), shell_name) == 0)
+        {
+            snapshot = &s;
+            break;
+        }
+    }
+
+    if (!snapshot)
+    {
+        s_snapshots.emplace_back();
+        snapshot = &s_snapshots.back();
+        snapshot->shell_name = shell_name;
+        snapshot->generation = 0;
+    }
+
+    if (snapshot->generation != s_generation)
+    {
+        snapshot->aliases.clear();
+        snapshot->generation = s_generation;
+
+        std::wstring key;
+        const wchar_t* name;
+        const wchar_t* text;
+        s_provider->begin(shell_name);
+        while (s_provider->next(name, text))
+        {
+            // An alias with no text doesn't exist.
+            if (!*text)
+                continue;
+
+            str<> utf8;
+            utf8 = text;
+            fold_name(name, key);
+            snapshot->aliases.emplace(key, utf8.c_str());
+        }
+    }
+
+    return *snapshot;
+}
+
+
+
+namespace alias_cache
+{
+
+//------------------------------------------------------------------------------
+void invalidate()
+{
+    s_generation++;
+}
+
+//------------------------------------------------------------------------------
+unsigned int get_generation()
+{
+    return s_generation;
+}
+
+//------------------------------------------------------------------------------
+bool find(const wchar_t* shell_name, const char* name, str_base& out)
+{
+    if (!name || !*name)
+        return false;
+
+    const alias_snapshot& snapshot = get_snapshot(shell_name);
+    if (snapshot.aliases.empty())
+        return false;
+
+    wstr<32> wname(name);
+    static std::wstring key;
+    fold_name(wname.c_str(), key);
+
+    const auto alias = snapshot.aliases.find(key);
+    if (alias == snapshot.aliases.end())
+        return false;
+
+    out = alias->second.c_str();
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Returns the previous provider.  Passing nullptr restores the console provider.
+alias_provider* set_provider(alias_provider* provider)
+{
+    alias_provider* prev = s_provider;
+    s_provider = provider ? provider : &s_console_provider;
+    invalidate();
+    return prev;
+}
+
+} // namespace alias_cache
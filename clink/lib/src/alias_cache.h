@@ -0,0 +1,34 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+class str_base;
+
+//------------------------------------------------------------------------------
+// Supplies the doskey aliases (macros) for a shell.  The default provider reads
+// them from the console; tests can substitute their own.
+class alias_provider
+{
+public:
+    virtual         ~alias_provider() {}
+    virtual void    begin(const wchar_t* shell_name) = 0;
+    virtual bool    next(const wchar_t*& name, const wchar_t*& text) = 0;
+};
+
+//------------------------------------------------------------------------------
+// Aliases are looked up on every keystroke, for every command in the input
+// line.  Rather than asking the console each time, the cache snapshots all of
+// a shell's aliases at once and answers lookups from the snapshot until the
+// generation changes.  Adding or removing an alias through doskey invalidates
+// the snapshot, and so does beginning a new input line, since aliases can only
+// be changed by other programs while a command is running.
+namespace alias_cache
+{
+
+void                invalidate();
+unsigned int        get_generation();
+bool                find(const wchar_t* shell_name, const char* name, str_base& out);
+alias_provider*     set_provider(alias_provider* provider);
+
+};
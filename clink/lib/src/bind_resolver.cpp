@@ -77,10 +77,10 @@ bind_resolver::bind_resolver(const binder& binder)
 //------------------------------------------------------------------------------
 void bind_resolver::set_group(int group)
 {
-    if (unsigned(group) - 1 >= sizeof_array(m_binder.m_nodes) - 1)
+    if (unsigned(group) - 1 >= m_binder.m_nodes.size() - 1)
         return;
 
-    if (m_group == group || !m_binder.get_node(group - 1).is_group)
+    if (m_group == unsigned(group) || !m_binder.get_node(group - 1).is_group)
         return;
 
     m_group = group;
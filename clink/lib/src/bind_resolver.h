@@ -25,7 +25,7 @@ public:
                         binding() = default;
                         binding(bind_resolver* resolver, int node_index);
         bind_resolver*  m_outer = nullptr;
-        unsigned short  m_node_index;
+        unsigned int    m_node_index;
         unsigned char   m_module;
         unsigned char   m_depth;
         unsigned char   m_id;
@@ -44,8 +44,8 @@ private:
     void                claim(binding& binding);
     bool                step_impl(unsigned char key);
     const binder&       m_binder;
-    unsigned short      m_node_index = 1;
-    unsigned short      m_group = 1;
+    unsigned int        m_node_index = 1;
+    unsigned int        m_group = 1;
     bool                m_pending_input = false;
     unsigned char       m_tail = 0;
     unsigned char       m_key_count = 0;
@@ -105,12 +105,13 @@ template <int SIZE> static bool translate_chord(const char* chord, char (&out)[S
 //------------------------------------------------------------------------------
 binder::binder()
 {
-    // Initialise the default group.
-    m_nodes[0] = { 1 };
-    m_nodes[1] = { 0 };
-    m_next_node = 2;
-
     static_assert(sizeof(node) == sizeof(group_node), "Size assumption");
+
+    // Initialise the default group.
+    m_nodes.reserve(512);
+    alloc_nodes(2);
+    get_group_node(0)->is_group = 1;
+    get_group_node(0)->table = alloc_root_table();
 }
 
 //------------------------------------------------------------------------------
@@ -125,7 +126,7 @@ int binder::get_group(const char* name)
     while (index)
     {
         const group_node* node = get_group_node(index);
-        if (*(int*)(node->hash) == hash)
+        if (node->hash == hash)
             return index + 1;
 
         index = node->next;
@@ -140,14 +141,17 @@ int binder::create_group(const char* name)
     if (name == nullptr || name[0] == '\0')
         return -1;
 
-    int index = alloc_nodes(2);
-    if (index < 0)
+    int table = alloc_root_table();
+    if (table < 0)
         return -1;
 
+    int index = alloc_nodes(2);
+
     // Create a new group node;
     group_node* group = get_group_node(index);
-    *(int*)(group->hash) = str_hash(name);
+    group->hash = str_hash(name);
     group->is_group = 1;
+    group->table = table;
 
     // Link the new node into the front of the list.
     group_node* master = get_group_node(0);
@@ -168,7 +172,7 @@ bool binder::bind(
     unsigned char id)
 {
     // Validate input
-    if (group >= sizeof_array(m_nodes))
+    if (group >= m_nodes.size())
         return false;
 
     // Translate from ASCII representation to actual keys.
@@ -195,7 +199,7 @@ bool binder::bind(
 
     // If the insert point is already bound we'll duplicate the node at the end
     // of the list. Also check if this is a duplicate of the existing bind.
-    node* bindee = m_nodes + head;
+    node* bindee = &m_nodes[head];
     if (bindee->bound)
     {
         int check = head;
@@ -205,7 +209,7 @@ bool binder::bind(
                 return true;
 
             check = bindee->next;
-            bindee = m_nodes + check;
+            bindee = &m_nodes[check];
         }
 
         head = append(head, *chord);
@@ -214,7 +218,7 @@ bool binder::bind(
     if (!head)
         return false;
 
-    bindee = m_nodes + head;
+    bindee = &m_nodes[head];
     bindee->module = module_index;
     bindee->bound = 1;
     bindee->depth = depth;
@@ -285,12 +289,15 @@ int binder::insert_child(int parent, unsigned char key)
 //------------------------------------------------------------------------------
 int binder::find_child(int parent, unsigned char key) const
 {
-    const node* node = m_nodes + parent;
+    if (const unsigned int* table = get_root_table(parent))
+        return table[key];
+
+    const node* node = &m_nodes[parent];
 
     int index = node->child;
     for (; index > parent; index = node->next)
     {
-        node = m_nodes + index;
+        node = &m_nodes[index];
         if (node->key == key)
             return index;
     }
@@ -322,6 +329,14 @@ int binder::add_child(int parent, unsigned char key)
     }
 
     m_nodes[child] = addee;
+
+    if (parent > 0 && m_nodes[parent - 1].is_group)
+    {
+        unsigned int& slot = m_root_tables[get_group_node(parent - 1)->table * 256 + key];
+        if (!slot)
+            slot = child;
+    }
+
     return child;
 }
 
@@ -355,7 +370,7 @@ int binder::append(int head, unsigned char key)
 //------------------------------------------------------------------------------
 const binder::node& binder::get_node(unsigned int index) const
 {
-    if (index < sizeof_array(m_nodes))
+    if (index < m_nodes.size())
         return m_nodes[index];
 
     static const node zero = {};
@@ -365,21 +380,39 @@ const binder::node& binder::get_node(unsigned int index) const
 //------------------------------------------------------------------------------
 binder::group_node* binder::get_group_node(unsigned int index)
 {
-    if (index < sizeof_array(m_nodes))
-        return (group_node*)(m_nodes + index);
+    if (index < m_nodes.size())
+        return (group_node*)(&m_nodes[index]);
 
     return nullptr;
 }
 
+//------------------------------------------------------------------------------
+const unsigned int* binder::get_root_table(unsigned int index) const
+{
+    if (index - 1 >= m_nodes.size() - 1 || !m_nodes[index - 1].is_group)
+        return nullptr;
+
+    const group_node* group = (const group_node*)(&m_nodes[index - 1]);
+    return &m_root_tables[group->table * 256];
+}
+
 //------------------------------------------------------------------------------
 int binder::alloc_nodes(unsigned int count)
 {
-    int next = m_next_node + count;
-    if (next > sizeof_array(m_nodes))
+    const unsigned int index = static_cast<unsigned int>(m_nodes.size());
+    m_nodes.resize(index + count);
+    return index;
+}
+
+//------------------------------------------------------------------------------
+int binder::alloc_root_table()
+{
+    const size_t table = m_root_tables.size() / 256;
+    if (table > 0xffff)
         return -1;
 
-    m_next_node = next;
-    return m_next_node - count;
+    m_root_tables.resize(m_root_tables.size() + 256);
+    return int(table);
 }
 
 //------------------------------------------------------------------------------
@@ -5,6 +5,8 @@
 
 #include <core/array.h>
 
+#include <vector>
+
 class editor_module;
 
 //------------------------------------------------------------------------------
@@ -23,30 +25,31 @@ public:
     int                 is_bound(unsigned int group, const char* seq, int len) const;
 
 private:
-    static const int    link_bits = 9;
     static const int    module_bits = 6;
 
     struct node
     {
-        unsigned short  is_group    : 1;
-        unsigned short  next        : link_bits;
-        unsigned short  module      : module_bits;
-
-        unsigned short  child       : link_bits;
-        unsigned short  depth       : 4;
-        unsigned short  bound       : 1;
-        unsigned short              : 2;
-
+        unsigned int    next;
+        unsigned int    child;
         unsigned char   key;
         unsigned char   id;
+        unsigned char   module;
+        unsigned char   is_group    : 1;
+        unsigned char   bound       : 1;
+        unsigned char   depth       : 6;
     };
 
+    // A group's root node follows its group node.  Each root has a table of
+    // its children indexed by key, so input that starts a chord (e.g. every
+    // key while typing or pasting text) is found in one lookup.
     struct group_node
     {
-        unsigned short  is_group    : 1;
-        unsigned short  next        : link_bits;
-        unsigned short              : 6;
-        unsigned short  hash[2];
+        unsigned int    next;
+        unsigned int    hash;
+        unsigned short  table;
+        unsigned char   _unused;
+        unsigned char   is_group    : 1;
+        unsigned char               : 7;
     };
 
     typedef fixed_array<editor_module*, (1 << module_bits)> modules;
@@ -59,10 +62,12 @@ private:
     int                 append(int head, unsigned char key);
     const node&         get_node(unsigned int index) const;
     group_node*         get_group_node(unsigned int index);
+    const unsigned int* get_root_table(unsigned int index) const;
     int                 alloc_nodes(unsigned int count=1);
+    int                 alloc_root_table();
     int                 add_module(editor_module& module);
     editor_module*      get_module(unsigned int index) const;
     modules             m_modules;
-    node                m_nodes[1 << link_bits];
-    unsigned int        m_next_node;
+    std::vector<node>   m_nodes;
+    std::vector<unsigned int> m_root_tables;
 };
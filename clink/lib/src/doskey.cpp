@@ -3,7 +3,7 @@
 
 #include "pch.h"
 #include "doskey.h"
-#include "terminal_helpers.h"
+#include "alias_cache.h"
 
 #include <core/base.h>
 #include <core/settings.h>
@@ -11,7 +11,9 @@
 #include <core/str_iter.h>
 #include <core/str_tokeniser.h>
 
-#include "terminal/printer.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 //------------------------------------------------------------------------------
 static setting_bool g_enhanced_doskey(
@@ -65,18 +67,9 @@ fallback:
         return get_alias(shell_name, in, alias, text, true);
     }
 
-    // Find the alias' text. First check it exists.
-    wchar_t unused;
-    wstr<32> walias(alias.c_str());
-    if (!GetConsoleAliasW(walias.data(), &unused, sizeof(unused), const_cast<wchar_t*>(shell_name)))
-        if (GetLastError() != ERROR_INSUFFICIENT_BUFFER)
-            goto fallback;
-
-    // It does. Allocate space and fetch it.
-    wstr_moveable wtext;
-    wtext.reserve(8192, true/*exact*/);
-    GetConsoleAliasW(walias.data(), wtext.data(), wtext.size(), const_cast<wchar_t*>(shell_name));
-    text = wtext.c_str();
+    // Find the alias' text.
+    if (!alias_cache::find(shell_name, alias.c_str(), text))
+        goto fallback;
 
     // Advance the iterator.
     while (in.peek() == ' ')
@@ -117,6 +110,138 @@ static const char* find_command_end(const char* command, int len)
 
 
 
+//------------------------------------------------------------------------------
+// Macro text compiled into a list of operations, so that resolving an alias
+// doesn't need to parse its $ tags again on every keystroke.
+class doskey_macro
+{
+public:
+    enum op_type : unsigned char
+    {
+        op_text,                        // Literal text (with $G etc converted).
+        op_arg,                         // $1..9; arg is the zero-based index.
+        op_star,                        // $*.
+        op_newline,                     // $T.
+    };
+
+    struct op
+    {
+        op_type         type;
+        unsigned char   arg;
+        unsigned int    offset;         // Into m_text, for op_text.
+        unsigned int    length;
+    };
+
+    void                compile(const char* text);
+    const char*         get_text(const op& op) const { return m_text.c_str() + op.offset; }
+    const std::vector<op>& get_ops() const { return m_ops; }
+    bool                has_quoted_arg() const { return m_quoted_arg; }
+
+private:
+    void                add_text(const char* text, unsigned int length);
+    std::string         m_text;
+    std::vector<op>     m_ops;
+    bool                m_quoted_arg = false;
+};
+
+//------------------------------------------------------------------------------
+void doskey_macro::add_text(const char* text, unsigned int length)
+{
+    if (!m_ops.empty() && m_ops.back().type == op_text)
+        m_ops.back().length += length;
+    else
+        m_ops.push_back({ op_text, 0, unsigned(m_text.length()), length });
+    m_text.append(text, length);
+}
+
+//------------------------------------------------------------------------------
+void doskey_macro::compile(const char* text)
+{
+    m_text.clear();
+    m_ops.clear();
+    m_quoted_arg = false;
+
+    bool quote = false;
+    for (const char* read = text; int c = *read; ++read)
+    {
+        if (c == '\"')
+            quote = !quote;
+
+        if (c != '$')
+        {
+            add_text(read, 1);
+            continue;
+        }
+
+        c = *++read;
+        if (!c)
+            break;
+
+        // Convert $x tags.
+        char o = 0;
+        switch (c)
+        {
+        case '$':           o = '$';  break;
+        case 'g': case 'G': o = '>';  break;
+        case 'l': case 'L': o = '<';  break;
+        case 'b': case 'B': o = '|';  break;
+        case 't': case 'T': o = '\n'; break;
+        }
+        if (o == '\n')
+        {
+            m_ops.push_back({ op_newline, 0, 0, 0 });
+            continue;
+        }
+        if (o)
+        {
+            add_text(&o, 1);
+            continue;
+        }
+
+        // Unknown tag? Perhaps it is a argument one?
+        if (unsigned(c - '1') < 9)
+            m_ops.push_back({ op_arg, (unsigned char)(c - '1'), 0, 0 });
+        else if (c == '*')
+            m_ops.push_back({ op_star, 0, 0, 0 });
+        else
+        {
+            if (c == '\"')
+                quote = !quote;
+            add_text(read - 1, 2);
+            continue;
+        }
+
+        // $* or $1..9 exists inside quotes:  don't split.  Suppose
+        // `ps=powershell "$*"`, then the `|` should be passed to powershell
+        // when `ps applet |Format-Table` is used.
+        if (quote)
+            m_quoted_arg = true;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Compiled macros are cached by their text, so they stay valid regardless how
+// the aliases change.
+static const doskey_macro& get_macro(const str_base& text)
+{
+    static std::unordered_map<std::string, doskey_macro> s_macros;
+
+    std::string key(text.c_str(), text.length());
+    auto iter = s_macros.find(key);
+    if (iter != s_macros.end())
+        return iter->second;
+
+    // Keep the cache from growing without bound.
+    if (s_macros.size() >= 256)
+        s_macros.clear();
+
+    doskey_macro& macro = s_macros[key];
+    macro.compile(text.c_str());
+    return macro;
+}
+
+
+
 //------------------------------------------------------------------------------
 class str_stream
 {
@@ -275,6 +400,7 @@ bool doskey::add_alias(const char* alias, const char* text)
 {
     wstr<64> walias(alias);
     wstr<> wtext(text);
+    alias_cache::invalidate();
     return (AddConsoleAliasW(walias.data(), wtext.data(), m_shell_name.data()) == TRUE);
 }
 
@@ -282,11 +408,89 @@ bool doskey::add_alias(const char* alias, const char* text)
 bool doskey::remove_alias(const char* alias)
 {
     wstr<64> walias(alias);
+    alias_cache::invalidate();
     return (AddConsoleAliasW(walias.data(), nullptr, m_shell_name.data()) == TRUE);
 }
 
 //------------------------------------------------------------------------------
-//#define DEBUG_RESOLVEIMPL
+// Where each argument reference in a macro was copied into the output.  The
+// spans are recorded in output order while expanding, and afterwards the point
+// is mapped from the input command to the output through them.
+struct doskey_arg_desc
+{
+    const char*         ptr;
+    int                 length;
+    int                 delims;         // Length of the delimiters that follow.
+};
+
+struct doskey_point_span
+{
+    int                 arg;            // Arg index, or -1 for $*.
+    int                 src;            // Offset of the copied text in the command.
+    int                 out;            // Where the copy begins in the output.
+    int                 trimmed;        // Output length sans trailing spaces, before the copy.
+};
+
+//------------------------------------------------------------------------------
+// Maps 'point' (an offset into the command) to the output.  Returns -1 if the
+// point doesn't fall anywhere that can be mapped.
+static int map_point(int point, int alias_len, const char* command,
+    const doskey_arg_desc* args, int arg_count,
+    const std::vector<doskey_point_span>& spans)
+{
+    if (!arg_count)
+        return -1;
+
+    // Find which arg the point is in, or which arg follows the delimiters the
+    // point is in.  In the alias name counts as before arg 1.
+    int point_arg = (point < alias_len) ? 0 : -1;
+    int point_ofs = -1;
+    for (int i = 0; i < arg_count; ++i)
+    {
+        const int start = int(args[i].ptr - command);
+        const int end = start + args[i].length;
+        if (point < start)
+            continue;
+
+        if (point < end)
+        {
+            point_arg = i;
+            point_ofs = point - start;
+        }
+        else if (point < end + args[i].delims)
+        {
+            point_arg = i + 1;
+            point_ofs = -1;
+        }
+    }
+
+    if (point_arg == arg_count)
+        point_arg = -1;
+
+    // The first copy that contains the point determines where it goes.  A point
+    // between args goes after the output that precedes the next arg.
+    const int first = int(args[0].ptr - command);
+    int last_arg = -1;
+    for (const auto& span : spans)
+    {
+        if (span.arg < 0)
+            return (point < first) ? span.trimmed : span.out + point - first;
+
+        if (span.arg < arg_count)
+        {
+            if (span.arg == point_arg && point_ofs >= 0)
+                return span.out + point_ofs;
+            if (last_arg + 1 == point_arg && point_arg >= 0 && point_ofs < 0)
+                return span.trimmed;
+        }
+
+        last_arg = span.arg;
+    }
+
+    return -1;
+}
+
+//------------------------------------------------------------------------------
 bool doskey::resolve_impl(str_iter& s, str_stream& out, int* _point)
 {
     str_iter command = s;
@@ -298,74 +502,16 @@ bool doskey::resolve_impl(str_iter& s, str_stream& out, int* _point)
     if (!get_alias(m_shell_name.data(), in, alias, text))
         return false;
 
-    // Find the point range for the alias name.
-    int point_arg = -1;
-    int point_ofs = -1;
-    bool point_arg_star = false;
-    int point_ofs_star = -1;
-    if (_point)
-    {
-        const int alias_start = out.length();
-        const int alias_end = alias_start + int(in.get_pointer() - s.get_pointer());
-        if (*_point >= alias_start && *_point < alias_end)
-        {
-            // Put point at beginning of whitespace before arg 1.
-            point_arg = 0;
-            point_ofs = -1;
-        }
-    }
+    const doskey_macro& macro = get_macro(text);
+    const int alias_len = int(in.get_pointer() - s.get_pointer());
 
     // Point at beginning stays there.
     const int out_len = out.length();
     int* point = (_point && *_point == out_len) ? nullptr : _point;
 
-#ifdef DEBUG_RESOLVEIMPL
-    int dbg_row = 0;
-    str<> tmp;
-    if (g_printer)
-    {
-        dbg_row++;
-        tmp.format("\x1b[s\x1b[%dH\x1b[K", dbg_row);
-        g_printer->print(tmp.c_str(), tmp.length());
-        if (point_arg == 0 && point_ofs < 0)
-            g_printer->print("before arg1 \t");
-    }
-#endif
-
     // Either split the input at the next command separator, or use the entire
     // input, depending on the doskey.enhanced setting and the macro text.
-    bool split = g_enhanced_doskey.get();
-    if (split)
-    {
-        bool quote = false;
-        str_iter macro(text.c_str(), text.length());
-        while (macro.more())
-        {
-            const int c = macro.next();
-            if (c == '\"')
-                quote = !quote;
-            if (c != '$')
-                continue;
-
-            const int tag = macro.peek();
-            if ((tag == '*') || (tag >= '1' && tag <= '9'))
-            {
-                // $* or $1..9 exists inside quotes:  don't split.
-                // Suppose `ps=powershell "$*"`, then the `|` should be passed
-                // to powershell when `ps applet |Format-Table` is used.
-                if (quote)
-                {
-                    split = false;
-                    break;
-                }
-            }
-            else if (tag == '$')
-            {
-                // Skip both chars of '$$' tag.
-                macro.next();
-            }
-        }
-    }
+    const bool split = g_enhanced_doskey.get() && !macro.has_quoted_arg();
     if (split)
     {
         // Restrict to resolve only up to the command separator.
@@ -395,195 +541,63 @@ bool doskey::resolve_impl(str_iter& s, str_stream& out, int* _point)
     if (g_enhanced_doskey.get())
         tokens.add_quote_pair("\"");
 
-    struct arg_desc { const char* ptr; int length; };
-    fixed_array<arg_desc, 10> args;
-    arg_desc* desc;
+    fixed_array<doskey_arg_desc, 10> args;
+    doskey_arg_desc* desc;
     while (tokens.next(token) && (desc = args.push_back()))
     {
         desc->ptr = token.get_pointer();
         desc->length = short(token.length());
-
-        // Find the point range for the arg.
-        if (point)
-        {
-            const int token_start = out_len + int(desc->ptr - command.get_pointer());
-            if (*point >= token_start)
-            {
-                const int delim_len = tokens.peek_delims();
-                const int token_end = token_start + desc->length;
-                if (*point < token_end)
-                {
-                    point_arg = args.size() - 1;
-                    point_ofs = *point - token_start;
-                }
-                else if (*point < token_end + delim_len)
-                {
-                    point_arg = args.size();
-                    point_ofs = -1;
-                }
-            }
-        }
-    }
-
-    if (point && args.size())
-    {
-        if (point_arg == int(args.size()))
-            point_arg = -1;
-        point_arg_star = true;
-        if (*point < out_len + args.front()->ptr - command.get_pointer())
-            point_ofs_star = -1;
-        else
-            point_ofs_star = *point - int(out_len + args.front()->ptr - command.get_pointer());
-#ifdef DEBUG_RESOLVEIMPL
-        if (g_printer)
-        {
-            tmp.format("size\t%d\targ begin\t%d\targ end\t%d\tparg\t%d\tin_cmd\t%d\tofs_star %d\t", int(args.size()), int(out_len + args.front()->ptr - command.get_pointer()), int(out_len + args.back()->ptr - command.get_pointer() + args.back()->length), point_arg, point_arg_star, point_ofs_star);
-            g_printer->print(tmp.c_str(), tmp.length());
-        }
-#endif
+        desc->delims = point ? tokens.peek_delims() : 0;
     }
 
-#ifdef DEBUG_RESOLVEIMPL
-    if (g_printer)
-    {
-        dbg_row++;
-        tmp.format("\x1b[%dH\x1b[K", dbg_row);
-        g_printer->print(tmp.c_str(), tmp.length());
-    }
-#endif
-
     // Expand the alias' text into 'out'.
-    bool set_point = !!point;
     str_stream& stream = out;
-    const char* read = text.c_str();
-    int last_arg_resolved = -1;
-    for (int c = *read; c = *read; ++read)
+    std::vector<doskey_point_span> spans;
+    const int arg_count = args.size();
+    for (const auto& op : macro.get_ops())
     {
-        if (c != '$')
-        {
-            stream << c;
-            continue;
-        }
-
-        c = *++read;
-        if (!c)
-            break;
-
-        // Convert $x tags.
-        char o = 0;
-        switch (c)
-        {
-        case '$':           o = '$';  break;
-        case 'g': case 'G': o = '>';  break;
-        case 'l': case 'L': o = '<';  break;
-        case 'b': case 'B': o = '|';  break;
-        case 't': case 'T': o = '\n'; break;
-        }
-        if (o)
+        if (op.type == doskey_macro::op_text)
         {
-            if (o == '\n')
-                set_point = false; // Only adjust point for the first line.
-            stream << o;
+            stream << str_stream::range(macro.get_text(op), op.length);
             continue;
         }
 
-        // Unknown tag? Perhaps it is a argument one?
-        if (unsigned(c - '1') < 9)  c -= '1';
-        else if (c == '*')          c = -1;
-        else
+        if (op.type == doskey_macro::op_newline)
         {
-            stream << '$';
-            stream << c;
+            stream << '\n';
             continue;
         }
 
-        int arg_count = args.size();
         if (!arg_count)
             continue;
 
-        // Adjust point.
+        // 'c' is the arg index, or -1 for all of them.
+        const int c = (op.type == doskey_macro::op_arg) ? op.arg : -1;
+        const char* src = (c < 0) ? args.front()->ptr : (c < arg_count) ? args.front()[c].ptr : nullptr;
+
         if (point)
         {
-            if (c < 0)
-            {
-                if (point_arg_star || point_arg >= 0)
-                {
-#ifdef DEBUG_RESOLVEIMPL
-                    if (g_printer)
-                    {
-                        if (point)
-                        {
-                            if (point_ofs_star < 0)
-                                tmp.format("STAR:\tTlen\t%d\t", stream.trimmed_length());
-                            else
-                                tmp.format("STAR:\tslen\t%d\tofs\t%d\t", stream.length(), point_ofs_star);
-                            g_printer->print(tmp.c_str(), tmp.length());
-                        }
-                    }
-#endif
-                    if (point_ofs_star < 0)
-                        *point = stream.trimmed_length();
-                    else
-                        *point = stream.length() + point_ofs_star;
-                    point = nullptr;
-                }
-            }
-            else if (c < arg_count)
-            {
-                if (c == point_arg && point_arg >= 0 && point_ofs >= 0)
-                {
-#ifdef DEBUG_RESOLVEIMPL
-                    if (g_printer && point)
-                    {
-                        tmp.format("ARG%d:\tslen\t%d\tofs\t%d\t", c + 1, stream.length(), point_ofs);
-                        g_printer->print(tmp.c_str(), tmp.length());
-                    }
-#endif
-                    *point = stream.length() + point_ofs;
-                    point = nullptr;
-                }
-                else if (last_arg_resolved + 1 == point_arg && point_arg >= 0 && point_ofs < 0)
-                {
-#ifdef DEBUG_RESOLVEIMPL
-                    if (g_printer && point)
-                    {
-                        tmp.format("ARG%d:\tTlen\t%d\t\t\t", c + 1, stream.trimmed_length());
-                        g_printer->print(tmp.c_str(), tmp.length());
-                    }
-#endif
-                    *point = stream.trimmed_length();
-                    point = nullptr;
-                }
-            }
-
-            last_arg_resolved = c;
+            const int ofs = src ? int(src - command.get_pointer()) : -1;
+            spans.push_back({ c, ofs, int(stream.length()), int(stream.trimmed_length()) });
         }
 
-        // 'c' is now the arg index or -1 if it is all of them to be inserted.
         if (c < 0)
         {
             const char* end = command.get_pointer() + command.length();
-            const char* start = args.front()->ptr;
-            stream << str_stream::range(start, int(end - start));
+            stream << str_stream::range(src, int(end - src));
         }
         else if (c < arg_count)
         {
-            const arg_desc& desc = args.front()[c];
-            stream << str_stream::range(desc.ptr, desc.length);
+            stream << str_stream::range(src, args.front()[c].length);
         }
     }
 
-    // Couldn't figure out where the point belongs?  Put it at the end.
+    // Map the point into the output.  Couldn't figure out where the point
+    // belongs?  Put it at the end.
     if (point)
     {
-#ifdef DEBUG_RESOLVEIMPL
-        if (g_printer)
-        {
-            tmp.format("END:\tTlen\t%d\t", stream.trimmed_length());
-            g_printer->print(tmp.c_str(), tmp.length());
-        }
-#endif
-        *point = max<int>(out_len, stream.trimmed_length());
+        const int mapped = map_point(*point - out_len, alias_len, command.get_pointer(), args.front(), arg_count, spans);
+        *point = (mapped >= 0) ? mapped : max<int>(out_len, stream.trimmed_length());
     }
 
     // If the point is still ahead, adjust it by the current command delta.
@@ -593,11 +607,6 @@ bool doskey::resolve_impl(str_iter& s, str_stream& out, int* _point)
         *_point += out.length() - out_len;
     }
 
-#ifdef DEBUG_RESOLVEIMPL
-    if (g_printer)
-        g_printer->print("\x1b[u");
-#endif
-
     return true;
 }
 
@@ -4,6 +4,7 @@
 #include "pch.h"
 #include <assert.h>
 #include "line_editor_impl.h"
+#include "alias_cache.h"
 #include "line_buffer.h"
 #include "match_generator.h"
 #include "match_pipeline.h"
@@ -207,12 +208,12 @@ bool host_call_lua_rl_global_function(const char* func_name)
 }
 
 //------------------------------------------------------------------------------
-const char** host_copy_dir_history(int* total)
+const char** host_copy_dir_history(int* total, bool ranked)
 {
     if (!s_callbacks)
         return nullptr;
 
-    return s_callbacks->copy_dir_history(total);
+    return s_callbacks->copy_dir_history(total, ranked);
 }
 
 //------------------------------------------------------------------------------
@@ -330,6 +331,9 @@ void line_editor_impl::begin_line()
     m_keys_size = 0;
     m_prev_key.reset();
 
+    // Commands run since the last line may have changed the aliases.
+    alias_cache::invalidate();
+
     assert(!s_editor);
     assert(!g_word_collector);
     s_editor = this;
@@ -702,13 +702,15 @@ int clink_selectall_conhost(int count, int invoking_key)
 
 
 //------------------------------------------------------------------------------
-extern const char** host_copy_dir_history(int* total);
+extern const char** host_copy_dir_history(int* total, bool ranked);
 extern popup_results activate_directories_text_list(const char** dirs, int count);
 int clink_popup_directories(int count, int invoking_key)
 {
-    // Copy the directory list (just a shallow copy of the dir pointers).
+    // Copy the directory list (just a shallow copy of the dir pointers).  With
+    // a numeric argument the directories are ranked by how frequently and
+    // recently they've been used, instead of only how recently.
     int total = 0;
-    const char** history = host_copy_dir_history(&total);
+    const char** history = host_copy_dir_history(&total, rl_explicit_arg != 0);
     if (!history || !total)
     {
         free(history);
@@ -23,6 +23,7 @@ extern "C" {
 extern int complete_get_screenwidth(void);
 }
 
+#include <map>
 #include <vector>
 #include <assert.h>
 
@@ -665,10 +665,72 @@ inline const char* fallback_color(const char* preferred, const char* fallback)
 }
 
 //------------------------------------------------------------------------------
-static void puts_face_func(const char* s, const char* face, int n)
+// Ready-made SGR sequences for the built in faces, so the redisplay doesn't
+// rebuild them for every run of characters.  The colors are loaded at the
+// beginning of each line, so the cache is rebuilt then and invalidated at the
+// end of each line.
+static const char c_normal[] = "\x1b[m";
+static const char* s_face_sgr[128];
+static str_moveable s_command_sgr;
+static str_moveable s_alias_sgr;
+static bool s_face_sgr_valid = false;
+
+//------------------------------------------------------------------------------
+static void init_face_sgr()
+{
+    for (auto& sgr : s_face_sgr)
+        sgr = c_normal;
+
+    s_face_sgr['1'] = "\x1b[0;7m";
+
+    s_face_sgr['2'] = fallback_color(s_input_color, c_normal);
+    s_face_sgr['*'] = fallback_color(_rl_display_modmark_color, c_normal);
+    s_face_sgr['('] = fallback_color(_rl_display_message_color, c_normal);
+    s_face_sgr['<'] = fallback_color(_rl_display_horizscroll_color, c_normal);
+    s_face_sgr['#'] = fallback_color(s_selection_color, "\x1b[0;7m");
+    s_face_sgr['-'] = fallback_color(s_suggestion_color, "\x1b[0;90m");
+
+    s_face_sgr['o'] = fallback_color(s_input_color, c_normal);
+    if (_rl_command_color)
+    {
+        s_command_sgr.clear();
+        s_command_sgr << "\x1b[" << _rl_command_color << "m";
+        s_face_sgr['c'] = s_command_sgr.c_str();
+    }
+    if (_rl_alias_color)
+    {
+        s_alias_sgr.clear();
+        s_alias_sgr << "\x1b[" << _rl_alias_color << "m";
+        s_face_sgr['d'] = s_alias_sgr.c_str();
+    }
+    s_face_sgr['m'] = fallback_color(s_argmatcher_color, "");
+    s_face_sgr['a'] = fallback_color(s_arg_color, fallback_color(s_input_color, c_normal));
+    s_face_sgr['f'] = fallback_color(s_flag_color, c_normal);
+    s_face_sgr['n'] = fallback_color(s_none_color, c_normal);
+
+    s_face_sgr_valid = true;
+}
+
+//------------------------------------------------------------------------------
+static const char* get_face_sgr(char face)
 {
-    static const char c_normal[] = "\x1b[m";
+    const unsigned char index = face;
+    if (index >= sizeof_array(s_face_sgr))
+    {
+        const char* sgr = s_classifications ? s_classifications->get_face_sgr(face) : nullptr;
+        return sgr ? sgr : c_normal;
+    }
+
+    if (!s_face_sgr_valid)
+        init_face_sgr();
 
+    assert(face != 'm' || s_argmatcher_color); // Shouldn't reach here otherwise.
+    return s_face_sgr[index];
+}
+
+//------------------------------------------------------------------------------
+static void puts_face_func(const char* s, const char* face, int n)
+{
     str<280> out;
     char cur_face = '0';
 
@@ -678,51 +740,7 @@ static void puts_face_func(const char* s, const char* face, int n)
         if (cur_face != *face)
         {
             cur_face = *face;
-            switch (cur_face)
-            {
-            default:
-                if (s_classifications)
-                {
-                    const char* color = s_classifications->get_face_output(cur_face);
-                    if (color)
-                    {
-                        out << "\x1b[" << color << "m";
-                        break;
-                    }
-                }
-                // fall through
-            case '0':   out << c_normal; break;
-            case '1':   out << "\x1b[0;7m"; break;
-
-            case '2':   out << fallback_color(s_input_color, c_normal); break;
-            case '*':   out << fallback_color(_rl_display_modmark_color, c_normal); break;
-            case '(':   out << fallback_color(_rl_display_message_color, c_normal); break;
-            case '<':   out << fallback_color(_rl_display_horizscroll_color, c_normal); break;
-            case '#':   out << fallback_color(s_selection_color, "\x1b[0;7m"); break;
-            case '-':   out << fallback_color(s_suggestion_color, "\x1b[0;90m"); break;
-
-            case 'o':   out << fallback_color(s_input_color, c_normal); break;
-            case 'c':
-                if (_rl_command_color)
-                    out << "\x1b[" << _rl_command_color << "m";
-                else
-                    out << c_normal;
-                break;
-            case 'd':
-                if (_rl_alias_color)
-                    out << "\x1b[" << _rl_alias_color << "m";
-                else
-                    out << c_normal;
-                break;
-            case 'm':
-                assert(s_argmatcher_color); // Shouldn't reach here otherwise.
-                if (s_argmatcher_color) // But avoid crashing, just in case.
-                    out << s_argmatcher_color;
-                break;
-            case 'a':   out << fallback_color(s_arg_color, fallback_color(s_input_color, c_normal)); break;
-            case 'f':   out << fallback_color(s_flag_color, c_normal); break;
-            case 'n':   out << fallback_color(s_none_color, c_normal); break;
-            }
+            out << get_face_sgr(cur_face);
         }
 
         // Get run of characters with the same face.
@@ -761,7 +779,7 @@ void set_suggestion(line_state& line, const char* suggestion, unsigned int offse
 }
 
 //------------------------------------------------------------------------------
-void hook_display()
+static void display_with_suggestion()
 {
     if (!s_suggestion.more() || rl_point != rl_end)
     {
@@ -785,6 +803,20 @@ void hook_display()
     rl_redisplay();
 }
 
+//------------------------------------------------------------------------------
+void hook_display()
+{
+    // Collect the redisplay's output and write it to the terminal all at
+    // once, since the number of console writes dominates the cost.
+    if (g_printer)
+        g_printer->begin_frame();
+
+    display_with_suggestion();
+
+    if (g_printer)
+        g_printer->end_frame();
+}
+
 //------------------------------------------------------------------------------
 bool can_suggest(line_state& line)
 {
@@ -1366,32 +1398,19 @@ int clink_popup_history(int count, int invoking_key)
     rl_completion_invoking_key = invoking_key;
     rl_completion_matches_include_type = 0;
 
-    int current = -1;
     int orig_pos = where_history();
     int search_len = rl_point;
 
-    // Copy the history list (just a shallow copy of the line pointers).
-    char** history = (char**)malloc(sizeof(*history) * history_length);
-    entry_info* infos = (entry_info*)malloc(sizeof(*infos) * history_length);
-    int total = 0;
-    for (int i = 0; i < history_length; i++)
-    {
-        if (!find_streqn(g_rl_buffer->get_buffer(), list[i]->line, search_len))
-            continue;
-        history[total] = list[i]->line;
-        infos[total].index = i;
-        infos[total].marked = (list[i]->data != nullptr);
-        if (i == orig_pos)
-            current = total;
-        total++;
-    }
+    // The popup reads the history list directly instead of a copy of it.
+    history_text_source source(g_rl_buffer->get_buffer(), search_len);
+    const int total = source.get_count();
     if (!total)
     {
         rl_ding();
-        free(history);
-        free(infos);
         return 0;
     }
+
+    int current = source.find(orig_pos);
     if (current < 0)
         current = total - 1;
 
@@ -1399,15 +1418,20 @@ int clink_popup_history(int count, int invoking_key)
     popup_result result;
     if (!g_gui_popups.get())
     {
-        popup_results results = activate_history_text_list(const_cast<const char**>(history), total, current, infos, true);
+        popup_results results = activate_history_text_list(source, current, true);
         result = results.m_result;
         current = results.m_index;
     }
     else
     {
+        std::vector<const char*> history;
+        history.reserve(total);
+        for (int i = 0; i < total; i++)
+            history.push_back(source.get_entry(i));
+
         str<> choice;
         result = do_popup_list("History",
-            const_cast<const char**>(history), total, 0, 0,
+            history.data(), total, 0, 0,
             false/*completing*/, false/*auto_complete*/, true/*reverse_find*/,
             current, choice);
     }
@@ -1425,8 +1449,9 @@ int clink_popup_history(int count, int invoking_key)
             rl_maybe_save_line();
             rl_maybe_replace_line();
 
-            current = infos[current].index;
-            history_set_pos(current);
+            entry_info info;
+            source.get_info(current, info);
+            history_set_pos(info.index);
             rl_replace_from_history(current_history(), 0);
 
             bool point_at_end = (!search_len || _rl_history_point_at_end_of_anchored_search);
@@ -1442,9 +1467,6 @@ int clink_popup_history(int count, int invoking_key)
         break;
     }
 
-    free(history);
-    free(infos);
-
     return 0;
 }
 
@@ -2302,6 +2324,8 @@ void rl_module::on_begin_line(const context& context)
     if (!_rl_display_message_color)
         _rl_display_message_color = "\x1b[m";
 
+    init_face_sgr();
+
     auto handler = [] (char* line) { rl_module::get()->done(line); };
     rl_set_rprompt(m_rl_rprompt.length() ? m_rl_rprompt.c_str() : nullptr);
     rl_callback_handler_install(m_rl_prompt.c_str(), handler);
@@ -2367,6 +2391,7 @@ void rl_module::on_end_line()
     _rl_filtered_color = nullptr;
     _rl_arginfo_color = nullptr;
     _rl_selected_color = nullptr;
+    s_face_sgr_valid = false;
 
     // This prevents any partial Readline state leaking from one line to the next
     rl_readline_state &= ~RL_MORE_INPUT_STATES;
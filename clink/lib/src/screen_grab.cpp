@@ -0,0 +1,148 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "screen_grab.h"
+#include "matches.h"
+
+#include <core/base.h>
+
+#include <ctype.h>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Rows are read in blocks of up to this many characters.
+static const int c_block_chars = 0x4000;
+
+
+
+//------------------------------------------------------------------------------
+console_line_source::console_line_source(void* handle)
+: m_handle(handle)
+{
+}
+
+//------------------------------------------------------------------------------
+bool console_line_source::get_range(int& top, int& bottom, int& width)
+{
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    if (!GetConsoleScreenBufferInfo(m_handle, &csbi))
+        return false;
+
+    // The whole visible window, including the prompt and input line, like
+    // console.screengrab().
+    top = csbi.srWindow.Top;
+    bottom = min<int>(csbi.srWindow.Bottom, csbi.dwSize.Y - 1);
+    width = m_width = csbi.dwSize.X;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool console_line_source::read_lines(int first, int count, wchar_t* out)
+{
+    // Reading past the end of a row continues with the next row, so a block
+    // of rows can be read at once.
+    const DWORD chars = DWORD(count * m_width);
+    COORD coord = { 0, SHORT(first) };
+    DWORD len = 0;
+    if (!ReadConsoleOutputCharacterW(m_handle, out, chars, coord, &len))
+        return false;
+    return len == chars;
+}
+
+
+
+//------------------------------------------------------------------------------
+screen_token_pattern::screen_token_pattern(int (*is_token)(int), int (*is_accept)(int), unsigned int min_length)
+: m_min_length(max<unsigned int>(min_length, 1))
+{
+    for (int c = 0; c < sizeof_array(m_classes); ++c)
+    {
+        m_classes[c] = 0;
+        if (is_token(c))
+            m_classes[c] |= token_char;
+        if (is_accept(c))
+            m_classes[c] |= accept_char;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Words with 3 or more letters are candidates, and a candidate containing only
+// hexadecimal digits is accepted.  This matches the Lua patterns that number
+// completion has used with console.screengrab().
+const screen_token_pattern& screen_token_pattern::numbers()
+{
+    static const screen_token_pattern s_numbers(isalnum, isxdigit, 3);
+    return s_numbers;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Adds the accepted tokens from the screen as word matches, and returns how many
+// were added.  The tokens are ordered by distance from the bottom right of the
+// range, and duplicates are skipped.
+unsigned int screen_grab(screen_line_source& source, const screen_token_pattern& pattern, match_builder& builder)
+{
+    int top, bottom, width;
+    if (!source.get_range(top, bottom, width) || top > bottom || width <= 0)
+        return 0;
+
+    const int block_rows = max<int>(c_block_chars / width, 1);
+    const int min_length = int(pattern.get_min_length());
+
+    std::vector<wchar_t> block;
+    std::unordered_set<std::string> seen;
+    std::string token;
+    unsigned int added = 0;
+
+    for (int last = bottom; last >= top; last -= block_rows)
+    {
+        const int first = max<int>(last - block_rows + 1, top);
+        const int rows = last + 1 - first;
+        block.resize(size_t(rows) * width);
+        const bool read = source.read_lines(first, rows, block.data());
+
+        for (int row = rows; row-- > 0;)
+        {
+            // If the block couldn't be read, read its rows one at a time so
+            // that only the rows that can't be read are skipped.
+            wchar_t* line = block.data() + size_t(row) * width;
+            if (!read && (rows == 1 || !source.read_lines(first + row, 1, line)))
+                continue;
+
+            // Scan from right to left so tokens are found in proximity order.
+            // Tokens are maximal runs, so they're the same in either direction.
+            for (int end = width; end > 0;)
+            {
+                if (!pattern.is_token(line[end - 1]))
+                {
+                    --end;
+                    continue;
+                }
+
+                int start = end;
+                bool accept = true;
+                while (start > 0 && pattern.is_token(line[start - 1]))
+                {
+                    --start;
+                    accept = accept && pattern.is_accept(line[start]);
+                }
+
+                if (accept && end - start >= min_length)
+                {
+                    // Token characters are ASCII.
+                    token.assign(line + start, line + end);
+                    if (seen.insert(token).second && builder.add_match(token.c_str(), match_type::word))
+                        ++added;
+                }
+
+                end = start;
+            }
+        }
+    }
+
+    return added;
+}
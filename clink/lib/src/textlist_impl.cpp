@@ -17,11 +17,15 @@
 #include <terminal/printer.h>
 #include <terminal/ecma48_iter.h>
 
+#include <algorithm>
+
 extern "C" {
 #include <readline/readline.h>
 #include <readline/rlprivate.h>
 #include <readline/history.h>
+#include <readline/histlib.h>
 extern int _rl_last_v_pos;
+extern int find_streqn (const char *a, const char *b, int n);
 };
 
 
@@ -55,6 +59,7 @@ extern const char* get_popup_desc_colors();
 //------------------------------------------------------------------------------
 static textlist_impl* s_textlist = nullptr;
 const int min_screen_cols = 20;
+const int max_measured_items = 1000;
 
 //------------------------------------------------------------------------------
 static int make_item(const char* in, str_base& out)
@@ -166,6 +171,103 @@ static bool strstr_compare(const str_base& needle, const char* haystack)
 
 
 
+//------------------------------------------------------------------------------
+class array_text_source
+    : public textlist_source
+{
+public:
+                    array_text_source(const char** entries, int count, const entry_info* infos);
+    virtual int     get_count() const override { return m_count; }
+    virtual const char* get_entry(int index) const override { return m_entries[index]; }
+    virtual bool    get_info(int index, entry_info& info) const override;
+
+private:
+    const char** const m_entries;
+    const int       m_count;
+    const entry_info* const m_infos;
+};
+
+//------------------------------------------------------------------------------
+array_text_source::array_text_source(const char** entries, int count, const entry_info* infos)
+    : m_entries(entries)
+    , m_count(count)
+    , m_infos(infos)
+{
+}
+
+//------------------------------------------------------------------------------
+bool array_text_source::get_info(int index, entry_info& info) const
+{
+    if (!m_infos)
+        return false;
+
+    info = m_infos[index];
+    return true;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Lines that begin with the prefix are found through the history index, so
+// the cost depends on the number of candidates rather than on the size of the
+// history.  Without a prefix no work is needed up front at all.
+history_text_source::history_text_source(const char* prefix, int prefix_len)
+    : m_list(history_list())
+    , m_length(m_list ? history_length : 0)
+{
+    if (!prefix || prefix_len <= 0)
+        return;
+
+    m_filtered = true;
+    for (int i = 0; i < m_length; i++)
+    {
+        i = _hs_history_index_next(prefix, prefix_len, true/*anchored*/, i, 1);
+        if (i < 0)
+            break;
+        if (find_streqn(prefix, m_list[i]->line, prefix_len))
+            m_matches.push_back(i);
+    }
+}
+
+//------------------------------------------------------------------------------
+int history_text_source::get_count() const
+{
+    return m_filtered ? int(m_matches.size()) : m_length;
+}
+
+//------------------------------------------------------------------------------
+const char* history_text_source::get_entry(int index) const
+{
+    const int i = m_filtered ? m_matches[index] : index;
+    return m_list[i]->line;
+}
+
+//------------------------------------------------------------------------------
+bool history_text_source::get_info(int index, entry_info& info) const
+{
+    info.index = m_filtered ? m_matches[index] : index;
+    info.marked = (m_list[info.index]->data != nullptr);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Returns the entry for the history line at history_index, or -1 if the line
+// isn't in the list.
+int history_text_source::find(int history_index) const
+{
+    if (history_index < 0 || history_index >= m_length)
+        return -1;
+    if (!m_filtered)
+        return history_index;
+
+    const auto it = std::lower_bound(m_matches.begin(), m_matches.end(), history_index);
+    if (it == m_matches.end() || *it != history_index)
+        return -1;
+    return int(it - m_matches.begin());
+}
+
+
+
 //------------------------------------------------------------------------------
 textlist_impl::addl_columns::addl_columns(textlist_impl::item_store& store)
     : m_store(store)
@@ -237,6 +339,20 @@ textlist_impl::textlist_impl(input_dispatcher& dispatcher)
 
 //------------------------------------------------------------------------------
 popup_results textlist_impl::activate(const char* title, const char** entries, int count, int index, bool reverse, int history_mode, const entry_info* infos, bool has_columns)
+{
+    if (!entries || count <= 0)
+    {
+        reset();
+        m_results.clear();
+        return popup_result::error;
+    }
+
+    array_text_source source(entries, count, infos);
+    return activate(title, source, index, reverse, history_mode, has_columns);
+}
+
+//------------------------------------------------------------------------------
+popup_results textlist_impl::activate(const char* title, const textlist_source& source, int index, bool reverse, int history_mode, bool has_columns)
 {
     reset();
     m_results.clear();
@@ -245,7 +361,8 @@ popup_results textlist_impl::activate(const char* title, const char** entries, i
     if (!m_buffer)
         return popup_result::error;
 
-    if (!entries || count <= 0)
+    const int count = source.get_count();
+    if (count <= 0)
         return popup_result::error;
 
     // Doesn't make sense to record macro with a popup list.
@@ -265,20 +382,31 @@ popup_results textlist_impl::activate(const char* title, const char** entries, i
         return popup_result::error;
     }
 
-    // Gather the items.
+    // Items are escaped for display when they're first needed.  Columns need
+    // the widths of every row, so those lists are gathered up front.  A long
+    // list isn't measured; it uses the full width instead.
     str<> tmp;
-    m_entries = entries;
-    m_infos = infos;
+    entry_info info;
+    m_source = &source;
+    m_has_infos = source.get_info(0, info);
     m_count = count;
-    for (int i = 0; i < count; i++)
+    if (has_columns)
     {
-        const char* text;
-        if (has_columns)
-            text = m_columns.add_entry(m_entries[i]);
-        else
-            text = m_entries[i];
-        m_longest = max<int>(m_longest, make_item(text, tmp));
-        m_items.push_back(m_store.add(tmp.c_str()));
+        for (int i = 0; i < count; i++)
+        {
+            const char* text = m_columns.add_entry(source.get_entry(i));
+            m_longest = max<int>(m_longest, make_item(text, tmp));
+            m_items.emplace(i, m_store.add(tmp.c_str()));
+        }
+    }
+    else if (count <= max_measured_items)
+    {
+        for (int i = 0; i < count; i++)
+            m_longest = max<int>(m_longest, make_item(source.get_entry(i), tmp));
+    }
+    else
+    {
+        m_longest = m_screen_cols;
     }
     m_has_columns = has_columns;
 
@@ -502,10 +630,11 @@ find:
             if (input.id == bind_id_textlist_findnext || input.id == bind_id_textlist_findprev)
                 advance_index(i, direction, m_count);
 
+            str<> tmp;
             int original = i;
             while (true)
             {
-                bool match = strstr_compare(m_needle, m_items[i]);
+                bool match = strstr_compare(m_needle, peek_item(i, tmp));
                 if (m_has_columns)
                 {
                     for (int col = 0; !match && col < max_columns; col++)
@@ -534,7 +663,7 @@ find:
 
     case bind_id_textlist_copy:
         {
-            const char* text = m_entries[m_index];
+            const char* text = m_source->get_entry(m_index);
             os::set_clipboard_text(text, int(strlen(text)));
             set_input_clears_needle = false;
         }
@@ -638,16 +767,18 @@ update_needle:
                     m_override_title.clear();
                     m_override_title.format("enter history number: %-6s", m_needle.c_str());
                     int i = atoi(m_needle.c_str());
-                    if (m_infos)
+                    if (m_has_infos)
                     {
                         int lookup = 0;
                         char lookupstr[16];
                         char needlestr[16];
+                        entry_info info;
                         _itoa_s(i, needlestr, 10);
                         const int needlestr_len = int(strlen(needlestr));
                         while (lookup < m_count)
                         {
-                            _itoa_s(m_infos[lookup].index + 1, lookupstr, 10);
+                            get_info(lookup, info);
+                            _itoa_s(info.index + 1, lookupstr, 10);
                             if (strncmp(needlestr, lookupstr, needlestr_len) == 0)
                             {
                                 i = lookup;
@@ -682,6 +813,7 @@ update_needle:
             {
                 str_compare_scope _(str_compare_scope::caseless, true/*fuzzy_accent*/);
 
+                str<> tmp;
                 int i = m_index;
                 while (true)
                 {
@@ -691,7 +823,7 @@ update_needle:
                     if (i == m_index)
                         break;
 
-                    int cmp = str_compare(m_needle.c_str(), m_items[i]);
+                    int cmp = str_compare(m_needle.c_str(), peek_item(i, tmp));
                     if (cmp == -1 || cmp == m_needle.length())
                     {
                         m_index = i;
@@ -744,7 +876,7 @@ void textlist_impl::cancel(popup_result result)
         if (m_index >= 0 && m_index < m_count)
         {
             m_results.m_index = m_index;
-            m_results.m_text = m_entries[m_index];
+            m_results.m_text = m_source->get_entry(m_index);
         }
     }
 
@@ -813,10 +945,12 @@ void textlist_impl::update_display()
             m_has_override_title = !m_override_title.empty();
 
             str<> tmp;
+            entry_info info;
             int max_num_len = 0;
             if (m_history_mode)
             {
-                tmp.format("%u", m_infos ? m_infos[m_count - 1].index + 1 : m_count);
+                get_info(m_count - 1, info);
+                tmp.format("%u", info.index + 1);
                 max_num_len = tmp.length();
             }
 
@@ -953,8 +1087,9 @@ void textlist_impl::update_display()
 
                     if (m_history_mode)
                     {
-                        const int history_index = m_infos ? m_infos[i].index : i;
-                        const char* mark = (!m_infos || !m_infos[i].marked ? " " :
+                        get_info(i, info);
+                        const int history_index = info.index;
+                        const char* mark = (!info.marked ? " " :
                                             i == m_index ? "*" :
                                             modmark.c_str());
                         tmp.clear();
@@ -966,8 +1101,9 @@ void textlist_impl::update_display()
                     }
 
                     int cell_len;
-                    const int char_len = limit_cells(m_items[i], spaces, cell_len);
-                    m_printer->print(m_items[i], char_len);         // main text
+                    const char* item = get_item(i);
+                    const int char_len = limit_cells(item, spaces, cell_len);
+                    m_printer->print(item, char_len);               // main text
                     spaces -= cell_len;
 
                     if (m_has_columns)
@@ -1059,7 +1195,7 @@ void textlist_impl::set_top(int top)
 //------------------------------------------------------------------------------
 void textlist_impl::reset()
 {
-    std::vector<const char*> zap_items;
+    std::unordered_map<int, const char*> zap_items;
 
     // Don't reset screen row and cols; they stay in sync with the terminal.
 
@@ -1069,8 +1205,8 @@ void textlist_impl::reset()
     m_has_override_title = false;
 
     m_count = 0;
-    m_entries = nullptr;    // Don't free; is only borrowed.
-    m_infos = nullptr;      // Don't free; is only borrowed.
+    m_source = nullptr;     // Don't free; is only borrowed.
+    m_has_infos = false;
     m_items = std::move(zap_items);
     m_longest = 0;
     m_columns.clear();
@@ -1089,6 +1225,43 @@ void textlist_impl::reset()
     m_store.clear();
 }
 
+//------------------------------------------------------------------------------
+const char* textlist_impl::get_item(int index)
+{
+    const auto it = m_items.find(index);
+    if (it != m_items.end())
+        return it->second;
+
+    str<> tmp;
+    make_item(m_source->get_entry(index), tmp);
+    const char* item = m_store.add(tmp.c_str());
+    m_items.emplace(index, item);
+    return item;
+}
+
+//------------------------------------------------------------------------------
+// Returns the display text for an item without keeping it, so that searching
+// a long list doesn't hold on to every item.
+const char* textlist_impl::peek_item(int index, str_base& tmp) const
+{
+    const auto it = m_items.find(index);
+    if (it != m_items.end())
+        return it->second;
+
+    make_item(m_source->get_entry(index), tmp);
+    return tmp.c_str();
+}
+
+//------------------------------------------------------------------------------
+void textlist_impl::get_info(int index, entry_info& info) const
+{
+    if (!m_source->get_info(index, info))
+    {
+        info.index = index;
+        info.marked = false;
+    }
+}
+
 
 
 //------------------------------------------------------------------------------
@@ -1160,3 +1333,14 @@ popup_results activate_history_text_list(const char** history, int count, int cu
     assert(current < count);
     return s_textlist->activate("History", history, count, current, true/*reverse*/, history_mode, infos, false);
 }
+
+//------------------------------------------------------------------------------
+popup_results activate_history_text_list(const textlist_source& source, int current, int history_mode)
+{
+    if (!s_textlist)
+        return popup_result::error;
+
+    assert(current >= 0);
+    assert(current < source.get_count());
+    return s_textlist->activate("History", source, current, true/*reverse*/, history_mode, false);
+}
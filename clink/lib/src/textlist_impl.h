@@ -9,9 +9,11 @@
 
 #include <core/str.h>
 
+#include <unordered_map>
 #include <vector>
 
 class printer;
+typedef struct _hist_entry HIST_ENTRY;
 
 //------------------------------------------------------------------------------
 typedef const char* (*textlist_line_getter_t)(int index);
@@ -23,6 +25,37 @@ struct entry_info
     bool            marked;
 };
 
+//------------------------------------------------------------------------------
+// Supplies the entries for a textlist.  Entries are only requested when they
+// are displayed or searched, so a long list can be shown without copying it.
+class textlist_source
+{
+public:
+    virtual         ~textlist_source() {}
+    virtual int     get_count() const = 0;
+    virtual const char* get_entry(int index) const = 0;
+    virtual bool    get_info(int index, entry_info& info) const { return false; }
+};
+
+//------------------------------------------------------------------------------
+// The Readline history, optionally only the lines that begin with a prefix.
+class history_text_source
+    : public textlist_source
+{
+public:
+                    history_text_source(const char* prefix=nullptr, int prefix_len=0);
+    virtual int     get_count() const override;
+    virtual const char* get_entry(int index) const override;
+    virtual bool    get_info(int index, entry_info& info) const override;
+    int             find(int history_index) const;
+
+private:
+    HIST_ENTRY**    m_list;
+    int             m_length;
+    bool            m_filtered = false;
+    std::vector<int> m_matches;             // History indices, when filtered.
+};
+
 //------------------------------------------------------------------------------
 class textlist_impl
     : public editor_module
@@ -53,6 +86,7 @@ public:
                     textlist_impl(input_dispatcher& dispatcher);
 
     popup_results   activate(const char* title, const char** entries, int count, int index, bool reverse, int history_mode, const entry_info* infos, bool columns);
+    popup_results   activate(const char* title, const textlist_source& source, int index, bool reverse, int history_mode, bool columns);
 
 private:
     // editor_module.
@@ -70,6 +104,9 @@ private:
     void            update_display();
     void            set_top(int top);
     void            reset();
+    const char*     get_item(int index);
+    const char*     peek_item(int index, str_base& tmp) const;
+    void            get_info(int index, entry_info& info) const;
 
     // Result.
     popup_results   m_results;
@@ -91,9 +128,9 @@ private:
 
     // Entries.
     int             m_count = 0;
-    const char**    m_entries = nullptr;    // Original entries from caller.
-    const entry_info* m_infos = nullptr;    // Original entry numbers/etc from caller.
-    std::vector<const char*> m_items;       // Escaped entries for display.
+    const textlist_source* m_source = nullptr; // Original entries from caller.
+    bool            m_has_infos = false;
+    std::unordered_map<int, const char*> m_items; // Escaped entries for display.
     int             m_longest = 0;
     addl_columns    m_columns;
     bool            m_reverse = false;
@@ -134,3 +171,4 @@ private:
 
 //------------------------------------------------------------------------------
 popup_results activate_history_text_list(const char** history, int count, int index, const entry_info* infos, int history_mode);
+popup_results activate_history_text_list(const textlist_source& source, int index, int history_mode);
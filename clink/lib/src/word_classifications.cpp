@@ -25,9 +25,10 @@ word_classifications::word_classifications(word_classifications&& other)
 {
     m_info = std::move(other.m_info);
     m_face_definitions = std::move(other.m_face_definitions);
+    m_face_sgr = std::move(other.m_face_sgr);
     m_faces = other.m_faces;
     m_length = other.m_length;
-    m_face_map = std::move(m_face_map);
+    m_face_map = std::move(other.m_face_map);
 
     other.m_faces = nullptr;    // Transferred ownership above.
     other.clear();
@@ -40,6 +41,7 @@ void word_classifications::clear()
 
     m_info.clear();
     m_face_definitions.clear();
+    m_face_sgr.clear();
     m_faces = nullptr;
     m_length = 0;
     m_face_map.clear();
@@ -53,11 +55,7 @@ void word_classifications::init(size_t line_length, const word_classifications*
     if (face_defs)
     {
         for (auto const& def : face_defs->m_face_definitions)
-        {
-            char face = char(face_base + m_face_definitions.size());
-            m_face_definitions.emplace_back(def.c_str());
-            m_face_map.emplace(m_face_definitions.back().c_str(), face);
-        }
+            add_face(def.c_str());
     }
 
     if (line_length)
@@ -174,6 +172,15 @@ const char* word_classifications::get_face_output(char face) const
     return m_face_definitions[index].c_str();
 }
 
+//------------------------------------------------------------------------------
+const char* word_classifications::get_face_sgr(char face) const
+{
+    unsigned int index = static_cast<unsigned char>(face) - 128;
+    if (index >= m_face_sgr.size())
+        return nullptr;
+    return m_face_sgr[index].c_str();
+}
+
 //------------------------------------------------------------------------------
 char word_classifications::ensure_face(const char* sgr)
 {
@@ -186,9 +193,20 @@ char word_classifications::ensure_face(const char* sgr)
     if (m_face_definitions.size() >= face_max)
         return '\0';
 
+    return add_face(sgr);
+}
+
+//------------------------------------------------------------------------------
+char word_classifications::add_face(const char* sgr)
+{
     char face = char(face_base + m_face_definitions.size());
     m_face_definitions.emplace_back(sgr);
     m_face_map.emplace(m_face_definitions.back().c_str(), face);
+
+    // Build the complete escape code once, rather than each time the face is
+    // displayed.
+    m_face_sgr.emplace_back();
+    m_face_sgr.back() << "\x1b[" << sgr << "m";
     return face;
 }
 
@@ -2,6 +2,7 @@
 // License: http://opensource.org/licenses/MIT
 
 #include "pch.h"
+#include "alias_cache.h"
 #include "line_buffer.h"
 #include "line_state.h"
 #include "word_collector.h"
@@ -147,7 +148,7 @@ unsigned int word_collector::collect_words(const char* line_buffer, unsigned int
                 str<32> lookup;
                 str<32> alias;
                 lookup.concat(line_buffer + command.offset, first_word_len);
-                if (os::get_alias(lookup.c_str(), alias))
+                if (alias_cache::find(os::get_shellname(), lookup.c_str(), alias))
                 {
                     unsigned char delim = (doskey_len < command.length) ? line_buffer[command.offset + doskey_len] : 0;
                     doskey_len = first_word_len;
@@ -0,0 +1,221 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "alias_cache.h"
+
+#include <core/base.h>
+#include <core/os.h>
+#include <core/str.h>
+#include <lib/doskey.h>
+
+#include <map>
+#include <string>
+
+extern bool g_show_benchmarks;
+
+//------------------------------------------------------------------------------
+class memory_alias_provider : public alias_provider
+{
+public:
+    virtual void    begin(const wchar_t* shell_name) override;
+    virtual bool    next(const wchar_t*& name, const wchar_t*& text) override;
+
+    std::map<std::wstring, std::wstring> m_aliases;
+    int             m_begin_count = 0;
+
+private:
+    std::map<std::wstring, std::wstring>::const_iterator m_iter;
+};
+
+//------------------------------------------------------------------------------
+void memory_alias_provider::begin(const wchar_t* shell_name)
+{
+    m_iter = m_aliases.begin();
+    m_begin_count++;
+}
+
+//------------------------------------------------------------------------------
+bool memory_alias_provider::next(const wchar_t*& name, const wchar_t*& text)
+{
+    if (m_iter == m_aliases.end())
+        return false;
+
+    name = m_iter->first.c_str();
+    text = m_iter->second.c_str();
+    ++m_iter;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Resolves the line and joins the resulting commands with newlines.
+static void resolve(doskey& doskey, const char* line, str_base& out)
+{
+    out.clear();
+
+    str<> tmp(line);
+    doskey_alias alias;
+    doskey.resolve(tmp.c_str(), alias);
+    if (!alias)
+        return;
+
+    for (bool first = true; alias.next(tmp); first = false)
+    {
+        if (!first)
+            out.concat("\n");
+        out.concat(tmp.c_str(), tmp.length());
+    }
+}
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("Alias cache")
+{
+    memory_alias_provider provider;
+    provider.m_aliases[L"Alias"] = L"text $*";
+    provider.m_aliases[L"other"] = L"more $1";
+    provider.m_aliases[L"empty"] = L"";
+
+    alias_provider* prev = alias_cache::set_provider(&provider);
+
+    SECTION("Find")
+    {
+        str<> out;
+        REQUIRE(alias_cache::find(L"shell", "alias", out));
+        REQUIRE(out.equals("text $*"));
+        REQUIRE(alias_cache::find(L"shell", "ALIAS", out));
+        REQUIRE(out.equals("text $*"));
+        REQUIRE(!alias_cache::find(L"shell", "alia", out));
+        REQUIRE(!alias_cache::find(L"shell", "empty", out));
+        REQUIRE(!alias_cache::find(L"shell", "", out));
+    }
+
+    SECTION("Generation")
+    {
+        // Lookups reuse the snapshot until it's invalidated.
+        str<> out;
+        REQUIRE(alias_cache::find(L"shell", "other", out));
+        REQUIRE(alias_cache::find(L"shell", "alias", out));
+        REQUIRE(provider.m_begin_count == 1);
+
+        provider.m_aliases[L"new"] = L"added";
+        REQUIRE(!alias_cache::find(L"shell", "new", out));
+
+        const unsigned int generation = alias_cache::get_generation();
+        alias_cache::invalidate();
+        REQUIRE(alias_cache::get_generation() != generation);
+        REQUIRE(alias_cache::find(L"shell", "new", out));
+        REQUIRE(out.equals("added"));
+        REQUIRE(provider.m_begin_count == 2);
+
+        // Adding or removing an alias invalidates the snapshot.
+        doskey doskey("shell");
+        doskey.remove_alias("unused");
+        REQUIRE(alias_cache::find(L"shell", "new", out));
+        REQUIRE(provider.m_begin_count == 3);
+    }
+
+    SECTION("Resolve")
+    {
+        doskey doskey("shell");
+        str<> out;
+
+        resolve(doskey, "alias one two", out);
+        REQUIRE(out.equals("text one two"));
+
+        resolve(doskey, "OTHER one two", out);
+        REQUIRE(out.equals("more one"));
+
+        resolve(doskey, "nope one", out);
+        REQUIRE(out.empty());
+
+        resolve(doskey, " alias", out);
+        REQUIRE(out.empty());
+    }
+
+    SECTION("Unchanged")
+    {
+        // Resolving through the cache matches resolving through the console.
+        const char* lines[] = {
+            "alias", "alias one two", "Alias  x", "other a b c", "other",
+            "alias x & other y", "alias x | other y", "aliasx", "empty z",
+        };
+
+        str<> console[sizeof_array(lines)];
+        {
+            alias_cache::set_provider(nullptr);
+
+            doskey doskey("shell");
+            for (const auto& alias : provider.m_aliases)
+            {
+                str<> name, text;
+                name = alias.first.c_str();
+                text = alias.second.c_str();
+                doskey.add_alias(name.c_str(), text.c_str());
+            }
+
+            for (int i = 0; i < sizeof_array(lines); ++i)
+                resolve(doskey, lines[i], console[i]);
+
+            for (const auto& alias : provider.m_aliases)
+            {
+                str<> name;
+                name = alias.first.c_str();
+                doskey.remove_alias(name.c_str());
+            }
+        }
+
+        alias_cache::set_provider(&provider);
+
+        doskey doskey("shell");
+        str<> out;
+        for (int i = 0; i < sizeof_array(lines); ++i)
+        {
+            resolve(doskey, lines[i], out);
+            REQUIRE(out.equals(console[i].c_str()), [&] () {
+                printf("line:     '%s'\ncache:    '%s'\nconsole:  '%s'\n", lines[i], out.c_str(), console[i].c_str());
+            });
+        }
+    }
+
+    SECTION("Benchmark")
+    {
+        if (g_show_benchmarks)
+        {
+            str<> name;
+            for (int i = 0; i < 200; ++i)
+            {
+                name.format("alias%d", i);
+                wstr<> wname(name.c_str());
+                provider.m_aliases[wname.c_str()] = L"cmd /c $*";
+            }
+
+            const int snapshots = 1000;
+            const int count = 100000;
+            doskey doskey("shell");
+            str<> out;
+
+            // Cost of taking a snapshot, which happens once per input line.
+            double start = os::clock();
+            for (int i = 0; i < snapshots; ++i)
+            {
+                alias_cache::invalidate();
+                alias_cache::find(L"shell", "alias42", out);
+            }
+            const double snapshot = os::clock() - start;
+
+            // Cost of resolving from the snapshot, which happens per keystroke.
+            start = os::clock();
+            for (int i = 0; i < count; ++i)
+                resolve(doskey, "alias42 one two & nope three", out);
+            const double resolved = os::clock() - start;
+
+            REQUIRE(out.equals("cmd /c one two & nope three"));
+            printf("\nalias cache, %d aliases:  %.3f msec per snapshot, %.2f usec per resolve\n",
+                   int(provider.m_aliases.size()), snapshot * 1000 / snapshots, resolved * 1000000 / count);
+        }
+    }
+
+    alias_cache::set_provider(prev);
+}
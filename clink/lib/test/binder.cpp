@@ -30,12 +30,10 @@ TEST_CASE("Binder")
         REQUIRE(binder.get_group("group2") == groups[1]);
     }
 
-    SECTION("Overflow : group")
+    SECTION("Many groups")
     {
-        for (int i = 1; i < 256; ++i)
+        for (int i = 1; i < 1024; ++i)
             REQUIRE(binder.create_group("group") == (i * 2) + 1);
-
-        REQUIRE(binder.create_group("group") == -1);
     }
 
     SECTION("Overflow : module")
@@ -48,18 +46,31 @@ TEST_CASE("Binder")
         REQUIRE(!binder.bind(group, "", module, 0xff));
     }
 
-    SECTION("Overflow : bind")
+    SECTION("Many binds")
     {
         auto& null_module = *(editor_module*)0;
         int default_group = binder.get_group();
 
-        for (int i = 0; i < 508; ++i)
+        // Two key chords; 64 first keys with 64 second keys each.
+        const char* keys = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-=";
+        for (int i = 0; i < 4096; ++i)
         {
-            char chord[] = { char((i > 0xff) + 1), char((i % 0xfe) + 1), 0 };
-            REQUIRE(binder.bind(default_group, chord, null_module, 0x12));
+            char chord[] = { keys[i >> 6], keys[i & 0x3f], 0 };
+            REQUIRE(binder.bind(default_group, chord, null_module, i & 0x7f));
         }
 
-        REQUIRE(!binder.bind(default_group, "\x01\x02\x03", null_module, 0x12));
+        for (int i = 0; i < 4096; i += 97)
+        {
+            char chord[] = { keys[i >> 6], keys[i & 0x3f], 0 };
+
+            bind_resolver resolver(binder);
+            REQUIRE(!resolver.step(chord[0]));
+            REQUIRE(resolver.step(chord[1]));
+
+            auto binding = resolver.next();
+            REQUIRE(binding);
+            REQUIRE(binding.get_id() == (i & 0x7f));
+        }
     }
 
     SECTION("Valid chords")
@@ -0,0 +1,255 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "redisplay_tester.h"
+
+#include <core/str.h>
+#include <core/settings.h>
+#include <lib/line_state.h>
+#include <lib/word_classifier.h>
+#include <lib/word_classifications.h>
+
+#include <string>
+
+//------------------------------------------------------------------------------
+static int find_prompt_row(const redisplay_tester& tester)
+{
+    str<> line;
+    for (int row = 0; row < tester.get_screen().get_rows(); ++row)
+        if (tester.get_screen_line(row, line) && strncmp(line.c_str(), "clink $ ", 8) == 0)
+            return row;
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+// Returns the foreground color index of a cell, or -1 for the default color.
+static int get_cell_fg(const redisplay_tester& tester, int row, int column)
+{
+    const headless_screen_buffer& screen = tester.get_screen();
+    const headless_screen_buffer::cell* cell = screen.get_cell(column, screen.get_top() + row);
+    const auto fg = cell->attr.get_fg();
+    return (fg && !fg.is_default) ? fg->value : -1;
+}
+
+//------------------------------------------------------------------------------
+// Colors alternate words cyan and magenta, so inserting a space changes the
+// color of every word after it.
+class alternating_classifier : public word_classifier
+{
+public:
+    void classify(const std::vector<line_state>& commands, word_classifications& classifications) override
+    {
+        const char cyan = classifications.ensure_face("36");
+        const char magenta = classifications.ensure_face("35");
+        for (const auto& line : commands)
+        {
+            unsigned int index = 0;
+            for (const auto& word : line.get_words())
+            {
+                if (word.length)
+                    classifications.apply_face(word.offset, word.length, (index++ & 1) ? magenta : cyan);
+            }
+        }
+    }
+};
+
+//------------------------------------------------------------------------------
+TEST_CASE("Redisplay")
+{
+    // 8 columns of prompt leave 32 columns for input on the first row.
+    redisplay_tester tester(40, 10);
+
+    const char* text = "abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJKLMN";
+
+    SECTION("Wrap")
+    {
+        tester.type(text);
+
+        const int row = find_prompt_row(tester);
+        REQUIRE(row >= 0);
+
+        str<> line;
+        REQUIRE(tester.get_screen_line(row, line));
+        REQUIRE(line.equals("clink $ abcdefghijklmnopqrstuvwxyz012345"));
+        REQUIRE(tester.get_screen_line(row + 1, line));
+        REQUIRE(line.equals("6789ABCDEFGHIJKLMN"));
+
+        const headless_screen_buffer& screen = tester.get_screen();
+        REQUIRE(screen.get_cursor_row() == row + 1);
+        REQUIRE(screen.get_cursor_column() == 18);
+
+        const redisplay_stats& stats = tester.get_stats();
+        REQUIRE(stats.keystrokes == 50);
+        REQUIRE(stats.bytes >= 50);
+        REQUIRE(stats.cells_changed >= 50);
+    }
+
+    SECTION("Insert")
+    {
+        tester.type(text);
+        for (int i = 0; i < 20; ++i)
+            tester.press_key("\x02");   // backward-char
+
+        tester.type("<>");
+
+        const int row = find_prompt_row(tester);
+        REQUIRE(row >= 0);
+
+        str<> line;
+        REQUIRE(tester.get_screen_line(row, line));
+        REQUIRE(line.equals("clink $ abcdefghijklmnopqrstuvwxyz0123<>"));
+        REQUIRE(tester.get_screen_line(row + 1, line));
+        REQUIRE(line.equals("456789ABCDEFGHIJKLMN"));
+
+        const headless_screen_buffer& screen = tester.get_screen();
+        REQUIRE(screen.get_cursor_row() == row + 1);
+        REQUIRE(screen.get_cursor_column() == 0);
+    }
+
+    SECTION("Shift")
+    {
+        // Inserting or deleting near the start of a line that wraps across
+        // several rows shifts each row in place instead of rewriting it.
+        std::string long_text;
+        for (int i = 0; i < 3; ++i)
+            long_text += text;
+
+        tester.type(long_text.c_str());
+        for (int i = 0; i < 148; ++i)
+            tester.press_key("\x02");  // backward-char
+
+        const int row = find_prompt_row(tester);
+        REQUIRE(row >= 0);
+
+        str<> line;
+        tester.reset_stats();
+        tester.type("<");
+        REQUIRE(tester.get_stats().bytes < 96);
+        REQUIRE(tester.get_screen_line(row, line));
+        REQUIRE(line.equals("clink $ ab<cdefghijklmnopqrstuvwxyz01234"));
+        REQUIRE(tester.get_screen_line(row + 1, line));
+        REQUIRE(line.equals("56789ABCDEFGHIJKLMNabcdefghijklmnopqrstu"));
+        REQUIRE(tester.get_screen_line(row + 3, line));
+        REQUIRE(line.equals("lmnopqrstuvwxyz0123456789ABCDEFGHIJKLMN"));
+
+        tester.reset_stats();
+        tester.press_key("\x08");      // backward-delete-char
+        REQUIRE(tester.get_stats().bytes < 96);
+        REQUIRE(tester.get_screen_line(row, line));
+        REQUIRE(line.equals("clink $ abcdefghijklmnopqrstuvwxyz012345"));
+        REQUIRE(tester.get_screen_line(row + 3, line));
+        REQUIRE(line.equals("mnopqrstuvwxyz0123456789ABCDEFGHIJKLMN"));
+
+        const headless_screen_buffer& screen = tester.get_screen();
+        REQUIRE(screen.get_cursor_row() == row);
+        REQUIRE(screen.get_cursor_column() == 10);
+    }
+
+    SECTION("Benchmark")
+    {
+        // A line that wraps across several rows, then edits in the middle of
+        // it.  Run the tests with -b to see the results.
+        std::string long_text;
+        for (int i = 0; i < 6; ++i)
+            long_text += text;
+
+        tester.type(long_text.c_str());
+        tester.report("Redisplay: type wrapped line");
+
+        tester.reset_stats();
+        for (int i = 0; i < 150; ++i)
+            tester.press_key("\x02");   // backward-char
+        tester.report("Redisplay: move in wrapped line");
+
+        tester.reset_stats();
+        tester.type(text);
+        tester.report("Redisplay: insert in wrapped line");
+
+        tester.reset_stats();
+        for (int i = 0; i < 50; ++i)
+            tester.press_key("\x08");   // backward-delete-char
+        tester.report("Redisplay: delete in wrapped line");
+    }
+}
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("Redisplay colorized")
+{
+    // Wide enough that the whole line fits on the prompt's row.
+    redisplay_tester tester(100, 10);
+
+    settings::find("clink.colorize_input")->set("true");
+    alternating_classifier classifier;
+    tester.get_editor()->set_classifier(classifier);
+
+    const char* text = "git commit --amend --message fixed --author someone --date now";
+    const int len = int(strlen(text));
+    const int prompt_len = 8;
+
+    tester.type(text);
+    for (int i = 0; i < 30; ++i)
+        tester.press_key("\x02");     // backward-char
+
+    const int row = find_prompt_row(tester);
+    REQUIRE(row >= 0);
+
+    // "now" is the 10th word; the cursor is inside "fixed", the 5th word.
+    const int col_now = prompt_len + len - 1;
+    const int col_fixed = prompt_len + len - 30 - 1;
+    const int cyan = get_cell_fg(tester, row, prompt_len);
+    const int magenta = get_cell_fg(tester, row, col_now);
+    REQUIRE(cyan != magenta);
+    REQUIRE(get_cell_fg(tester, row, col_fixed) == cyan);
+
+    str<> line;
+
+    SECTION("Letter")
+    {
+        // Inserting or deleting a letter doesn't change the color of any other
+        // word, so the output covers only the letter, not the 30 cells after
+        // it that shift over.
+        tester.reset_stats();
+        tester.type("x");
+        REQUIRE(tester.get_stats().bytes < 24, [&] () {
+            printf("bytes:  %u\n", tester.get_stats().bytes);
+        });
+        REQUIRE(tester.get_screen_line(row, line));
+        REQUIRE(line.equals("clink $ git commit --amend --message fixexd --author someone --date now"));
+        REQUIRE(get_cell_fg(tester, row, col_fixed + 1) == cyan);
+        REQUIRE(get_cell_fg(tester, row, col_now + 1) == magenta);
+
+        tester.reset_stats();
+        tester.press_key("\x08");      // backward-delete-char
+        REQUIRE(tester.get_stats().bytes < 24, [&] () {
+            printf("bytes:  %u\n", tester.get_stats().bytes);
+        });
+        REQUIRE(tester.get_screen_line(row, line));
+        REQUIRE(line.equals(text));
+        REQUIRE(get_cell_fg(tester, row, col_now) == magenta);
+    }
+
+    SECTION("Space")
+    {
+        // Inserting a space splits a word, which changes the color of every
+        // word after it, so the output grows with the cells that changed.
+        tester.reset_stats();
+        tester.type(" ");
+        REQUIRE(tester.get_stats().bytes > 30);
+        REQUIRE(tester.get_screen_line(row, line));
+        REQUIRE(line.equals("clink $ git commit --amend --message fixe d --author someone --date now"));
+        REQUIRE(get_cell_fg(tester, row, col_fixed + 2) == magenta);
+        REQUIRE(get_cell_fg(tester, row, col_now + 1) == cyan);
+
+        tester.reset_stats();
+        tester.press_key("\x08");      // backward-delete-char
+        REQUIRE(tester.get_stats().bytes > 30);
+        REQUIRE(tester.get_screen_line(row, line));
+        REQUIRE(line.equals(text));
+        REQUIRE(get_cell_fg(tester, row, col_now) == magenta);
+    }
+
+    settings::find("clink.colorize_input")->set();
+}
@@ -0,0 +1,204 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "matches_impl.h"
+
+#include <core/base.h>
+#include <core/os.h>
+#include <core/str.h>
+#include <lib/screen_grab.h>
+
+#include <string>
+#include <vector>
+
+extern bool g_show_benchmarks;
+
+//------------------------------------------------------------------------------
+class memory_line_source : public screen_line_source
+{
+public:
+                    memory_line_source(int width) : m_width(width) {}
+    void            add(const wchar_t* line);
+    virtual bool    get_range(int& top, int& bottom, int& width) override;
+    virtual bool    read_lines(int first, int count, wchar_t* out) override;
+
+    int             m_top = 0;
+    int             m_bottom = -1;
+    int             m_reads = 0;
+    int             m_bad_row = -1;     // Reads that include this row fail.
+
+private:
+    std::vector<std::wstring> m_lines;
+    int             m_width;
+};
+
+//------------------------------------------------------------------------------
+void memory_line_source::add(const wchar_t* line)
+{
+    std::wstring row(line);
+    row.resize(m_width, ' ');
+    m_lines.emplace_back(std::move(row));
+    m_bottom = int(m_lines.size()) - 1;
+}
+
+//------------------------------------------------------------------------------
+bool memory_line_source::get_range(int& top, int& bottom, int& width)
+{
+    top = m_top;
+    bottom = m_bottom;
+    width = m_width;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool memory_line_source::read_lines(int first, int count, wchar_t* out)
+{
+    REQUIRE(first >= m_top);
+    REQUIRE(first + count - 1 <= m_bottom);
+
+    m_reads++;
+    if (m_bad_row >= first && m_bad_row < first + count)
+        return false;
+
+    for (int i = 0; i < count; ++i, out += m_width)
+        memcpy(out, m_lines[first + i].c_str(), m_width * sizeof(*out));
+    return true;
+}
+
+//------------------------------------------------------------------------------
+static void verify_matches(const matches_impl& matches, const char** expected, int count)
+{
+    REQUIRE(matches.get_match_count() == count);
+    for (int i = 0; i < count; ++i)
+    {
+        REQUIRE(strcmp(matches.get_match(i), expected[i]) == 0, [&] () {
+            printf("index:     %d\nexpected:  %s\ngot:       %s\n", i, expected[i], matches.get_match(i));
+        });
+        REQUIRE(matches.get_match_type(i) == match_type::word);
+    }
+}
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("Screen grab")
+{
+    matches_impl matches;
+    match_builder builder(matches);
+    const screen_token_pattern& numbers = screen_token_pattern::numbers();
+
+    SECTION("Numbers")
+    {
+        memory_line_source source(40);
+        source.add(L"commit 1a2b3c4 fixed #123 and 45");
+        source.add(L"see issue 8675309, abc; xyz12");
+        source.add(L"zz 123");
+
+        // Ordered by proximity to the bottom right, without duplicates.
+        REQUIRE(screen_grab(source, numbers, builder) == 4);
+        const char* expected[] = { "123", "abc", "8675309", "1a2b3c4" };
+        verify_matches(matches, expected, sizeof_array(expected));
+    }
+
+    SECTION("Range")
+    {
+        memory_line_source source(20);
+        source.add(L"aaa 111");
+        source.add(L"bbb 222");
+        source.add(L"ccc 333");
+        source.add(L"ddd 444");
+        source.m_top = 1;
+        source.m_bottom = 2;
+
+        REQUIRE(screen_grab(source, numbers, builder) == 4);
+        const char* expected[] = { "333", "ccc", "222", "bbb" };
+        verify_matches(matches, expected, sizeof_array(expected));
+    }
+
+    SECTION("Empty")
+    {
+        memory_line_source source(20);
+        REQUIRE(screen_grab(source, numbers, builder) == 0);
+        REQUIRE(matches.get_match_count() == 0);
+    }
+
+    SECTION("Boundaries")
+    {
+        // Only ASCII characters are token characters, so other characters
+        // separate tokens.  Tokens can touch the edges of the line.
+        memory_line_source source(12);
+        source.add(L"caf\u00e9beef");
+        source.add(L"dead_0x1234f");
+        source.add(L"ab 12 abcdef");
+
+        REQUIRE(screen_grab(source, numbers, builder) == 4);
+        const char* expected[] = { "abcdef", "dead", "beef", "caf" };
+        verify_matches(matches, expected, sizeof_array(expected));
+    }
+
+    SECTION("Blocks")
+    {
+        // Tall enough to need several block reads.
+        memory_line_source source(300);
+        str<> tmp;
+        for (int i = 0; i < 1000; ++i)
+        {
+            tmp.format("line: id %d", 1000 + i);
+            wstr<> wtmp(tmp.c_str());
+            source.add(wtmp.c_str());
+        }
+
+        REQUIRE(screen_grab(source, numbers, builder) == 1000);
+        REQUIRE(source.m_reads > 1);
+        for (int i = 0; i < 1000; ++i)
+        {
+            tmp.format("%d", 1999 - i);
+            REQUIRE(strcmp(matches.get_match(i), tmp.c_str()) == 0);
+        }
+    }
+
+    SECTION("Unreadable row")
+    {
+        // A row that can't be read doesn't lose the rest of its block.
+        memory_line_source source(20);
+        source.add(L"aaa 111");
+        source.add(L"bbb 222");
+        source.add(L"ccc 333");
+        source.m_bad_row = 1;
+
+        REQUIRE(screen_grab(source, numbers, builder) == 4);
+        const char* expected[] = { "333", "ccc", "111", "aaa" };
+        verify_matches(matches, expected, sizeof_array(expected));
+        REQUIRE(source.m_reads == 4);
+    }
+
+    SECTION("Benchmark")
+    {
+        if (g_show_benchmarks)
+        {
+            memory_line_source source(200);
+            str<> tmp;
+            for (int i = 0; i < 3000; ++i)
+            {
+                tmp.format("%08x  commit message number %d for issue #%d with some more text", i * 7919, i, i % 500);
+                wstr<> wtmp(tmp.c_str());
+                source.add(wtmp.c_str());
+            }
+
+            const int count = 20;
+            unsigned int added = 0;
+            const double start = os::clock();
+            for (int i = 0; i < count; ++i)
+            {
+                matches_impl bench_matches;
+                match_builder bench_builder(bench_matches);
+                added = screen_grab(source, numbers, bench_builder);
+            }
+            const double elapsed = os::clock() - start;
+
+            printf("\nscreen grab, %d lines:  %u matches, %.3f msec per scan\n",
+                   source.m_bottom + 1, added, elapsed * 1000 / count);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "history_fixture.h"
+#include "textlist_impl.h"
+
+#include <core/os.h>
+#include <core/str.h>
+
+extern "C" {
+#include <readline/history.h>
+};
+
+extern bool g_show_benchmarks;
+
+//------------------------------------------------------------------------------
+TEST_CASE("History text source")
+{
+    const int counts[] = { 1000, 1000000 };
+    for (int count : counts)
+    {
+        if (!use_history_size(count, counts[0]))
+            break;
+
+        clear_history();
+        add_history_lines(count);
+        add_history("needle");
+        add_history("cmd42 again");
+
+        double elapsed[2];
+
+        // Without a prefix the source is the history list itself.
+        {
+            const double start = os::clock();
+            history_text_source source;
+            elapsed[0] = os::clock() - start;
+
+            REQUIRE(source.get_count() == count + 2);
+            REQUIRE(strcmp(source.get_entry(0), "cmd0 --flag arg0") == 0);
+            REQUIRE(strcmp(source.get_entry(count), "needle") == 0);
+            REQUIRE(source.find(count) == count);
+            REQUIRE(source.find(count + 2) == -1);
+
+            entry_info info;
+            REQUIRE(source.get_info(count + 1, info));
+            REQUIRE(info.index == count + 1);
+            REQUIRE(!info.marked);
+        }
+
+        // With a prefix only the lines that begin with it are included.
+        {
+            const double start = os::clock();
+            history_text_source source("cmd42 ", 6);
+            elapsed[1] = os::clock() - start;
+
+            REQUIRE(source.get_count() == 2);
+            REQUIRE(strcmp(source.get_entry(0), "cmd42 --flag arg42") == 0);
+            REQUIRE(strcmp(source.get_entry(1), "cmd42 again") == 0);
+            REQUIRE(source.find(42) == 0);
+            REQUIRE(source.find(43) == -1);
+
+            entry_info info;
+            REQUIRE(source.get_info(1, info));
+            REQUIRE(info.index == count + 1);
+
+            history_text_source none("nomatch", 7);
+            REQUIRE(none.get_count() == 0);
+        }
+
+        if (g_show_benchmarks)
+            print_history_benchmark("history text source", count, elapsed[0], elapsed[1], "unfiltered", "prefix");
+
+        clear_history();
+    }
+}
@@ -22,6 +22,7 @@ public:
 
 private:
     bool            has_coroutines();
+    void            release_yieldguards();
     void            resume_coroutines();
     lua_state&      m_state;
     void*           m_event = 0;
@@ -40,8 +40,9 @@ function clink._classify(commands)
     local impl = function ()
         clink.classifier_stopped = nil
 
+        local call = _profile_caller("classifier")
         for _, classifier in ipairs(_classifiers) do
-            local ret = classifier:classify(commands)
+            local ret = call(classifier.classify, classifier, commands)
             if ret == true then
                 -- Remember the classifier function that stopped.
                 clink.classifier_stopped = classifier.classify
@@ -125,3 +125,151 @@ function clink.quote_split(str, ql, qr)
     _compat_warning("clink.quote_split() is not supported.")
     return {}
 end
+
+
+
+--------------------------------------------------------------------------------
+-- Profiling for callbacks registered by scripts (generators, classifiers,
+-- prompt filters, suggesters, and event handlers).  When the lua.profile
+-- setting is disabled, the caller returned by _profile_caller() simply invokes
+-- the function, so the cost is one extra call per callback.
+local _profile_data = {}
+
+--------------------------------------------------------------------------------
+local function _profile_plain_call(func, ...)
+    return func(...)
+end
+
+--------------------------------------------------------------------------------
+local function _profile_get_entry(category, func)
+    local by_func = _profile_data[category]
+    if not by_func then
+        by_func = {}
+        _profile_data[category] = by_func
+    end
+
+    local entry = by_func[func]
+    if not entry then
+        local info = debug.getinfo(func, 'S')
+        local src = info and (info.short_src..":"..info.linedefined) or "?"
+        entry = { category=category, source=src, calls=0, total=0, max=0, memory=0 }
+        by_func[func] = entry
+    end
+    return entry
+end
+
+--------------------------------------------------------------------------------
+local function _profile_finish(entry, clock, mem, ...)
+    local elapsed = os.clock() - clock
+    local delta = collectgarbage("count") - mem
+
+    entry.calls = entry.calls + 1
+    entry.total = entry.total + elapsed
+    if entry.max < elapsed then
+        entry.max = elapsed
+    end
+    if delta > 0 then
+        entry.memory = entry.memory + delta
+    end
+
+    return ...
+end
+
+--------------------------------------------------------------------------------
+-- Returns a function that calls func(...) and returns its results.  When the
+-- lua.profile setting is enabled, each call is also recorded under category.
+function _profile_caller(category)
+    if not settings.get("lua.profile") then
+        return _profile_plain_call
+    end
+
+    return function (func, ...)
+        if type(func) ~= "function" then
+            return func(...)
+        end
+        local entry = _profile_get_entry(category, func)
+        -- Arguments are evaluated left to right, so the clock and memory
+        -- samples are taken before func runs.
+        return _profile_finish(entry, os.clock(), collectgarbage("count"), func(...))
+    end
+end
+
+--------------------------------------------------------------------------------
+--- -name:  clink.getprofile
+--- -ver:   1.3.1
+--- -ret:   table
+--- Returns a table of profiling results for the callbacks that scripts have
+--- registered with Clink (generators, classifiers, prompt filters, suggesters,
+--- and event handlers).  Profiling data is only collected while the
+--- <code>lua.profile</code> setting is enabled.
+---
+--- Each entry in the table is a table with the following scheme:
+--- -show:  {
+--- -show:  &nbsp;   category = ...,     -- e.g. "generator", "promptfilter", "event:onbeginedit".
+--- -show:  &nbsp;   source = ...,       -- The file and line where the function is defined.
+--- -show:  &nbsp;   calls = ...,        -- Number of times the function was called.
+--- -show:  &nbsp;   total = ...,        -- Total elapsed seconds across all calls.
+--- -show:  &nbsp;   max = ...,          -- Longest elapsed seconds for a single call.
+--- -show:  &nbsp;   memory = ...,       -- Kilobytes of Lua memory allocated across all calls.
+--- -show:  }
+---
+--- The entries are sorted by total elapsed time, in descending order.
+function clink.getprofile()
+    local list = {}
+    for _,by_func in pairs(_profile_data) do
+        for _,entry in pairs(by_func) do
+            table.insert(list, {
+                category=entry.category,
+                source=entry.source,
+                calls=entry.calls,
+                total=entry.total,
+                max=entry.max,
+                memory=entry.memory,
+            })
+        end
+    end
+    table.sort(list, function(a, b)
+        if a.total ~= b.total then
+            return a.total > b.total
+        end
+        return a.source < b.source
+    end)
+    return list
+end
+
+--------------------------------------------------------------------------------
+--- -name:  clink.resetprofile
+--- -ver:   1.3.1
+--- Discards all profiling results collected so far.  See
+--- <a href="#clink.getprofile">clink.getprofile()</a> for more information.
+function clink.resetprofile()
+    _profile_data = {}
+end
+
+--------------------------------------------------------------------------------
+function clink._diag_profile()
+    local list = clink.getprofile()
+    if #list == 0 then
+        return
+    end
+
+    local bold = "\x1b[1m"          -- Bold (bright).
+    local norm = "\x1b[m"           -- Normal.
+
+    local max_cat = 0
+    for _,entry in ipairs(list) do
+        if max_cat < #entry.category then
+            max_cat = #entry.category
+        end
+    end
+
+    clink.print(bold.."profile:"..norm)
+    clink.print(string.format("  %-"..max_cat.."s  %8s  %10s  %10s  %10s  %s",
+                              "category", "calls", "total ms", "max ms", "alloc KB", "source"))
+    for _,entry in ipairs(list) do
+        clink.print(string.format("  %-"..max_cat.."s  %8d  %10.3f  %10.3f  %10.1f  %s",
+                                  entry.category, entry.calls,
+                                  entry.total * 1000, entry.max * 1000,
+                                  entry.memory, entry.source))
+    end
+end
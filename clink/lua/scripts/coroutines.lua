@@ -4,11 +4,15 @@
 --------------------------------------------------------------------------------
 clink = clink or {}
 local _coroutines = {}
+local _coroutine_ids = {}               -- Maps schedule ids to entries in _coroutines.
+local _next_coroutine_id = 0            -- Schedule ids are never reused, so stale ids can't alias.
 local _coroutines_created = {}          -- Remembers creation info for each coroutine, for use by clink.addcoroutine.
 local _after_coroutines = {}            -- Funcs to run after a pass resuming coroutines.
 local _coroutines_resumable = false     -- When false, coroutines will no longer run.
-local _coroutine_yieldguard = nil       -- Which coroutine is yielding inside popenyield.
+local _popen_active = {}                -- Active io.popenyield calls, keyed by coroutine.
+local _popen_queue = {}                 -- Queued io.popenyield calls, in arrival order.
 local _coroutine_context = nil          -- Context for queuing io.popenyield calls from a same source.
+local _no_context = {}                  -- Context key for coroutines created without a context.
 local _coroutine_canceled = false       -- Becomes true if an orphaned io.popenyield cancels the coroutine.
 local _coroutine_generation = 0         -- ID for current generation of coroutines.
 
@@ -25,6 +29,7 @@ local print = clink.print
 --      interval:       Interval at which to schedule the coroutine.
 --      context:        The context in which the coroutine was created.
 --      generation:     The generation to which this coroutine belongs.
+--      id:             The id by which the native scheduler knows the coroutine.
 --
 --  Updated by the coroutine management system:
 --      resumed:        Number of times the coroutine has been resumed.
@@ -34,48 +39,180 @@ local print = clink.print
 --      infinite:       Use INFINITE wait for this coroutine; it's actively inside popenyield.
 --      queued:         Use INFINITE wait for this coroutine; it's queued inside popenyield.
 
+--------------------------------------------------------------------------------
+local function next_entry_target(entry, now)
+    if not entry.lastclock then
+        return 0
+    else
+        -- Multiple kinds of throttling for coroutines that want to run more
+        -- frequently than every 5 seconds:
+        --  1.  Throttle if running for 5 or more seconds, but reset the elapsed
+        --      timer every time io.popenyield() finishes.
+        --  2.  Throttle if running for more than 30 seconds total.
+        -- Throttled coroutines can only run once every 5 seconds.
+        local interval = entry.interval
+        local throttleclock = entry.throttleclock or entry.firstclock
+        if now and interval < 5 then
+            if throttleclock and now - throttleclock > 5 then
+                interval = 5
+            elseif entry.firstclock and now - entry.firstclock > 30 then
+                interval = 5
+            end
+        end
+        return entry.lastclock + interval
+    end
+end
+
+--------------------------------------------------------------------------------
+-- The native scheduler keeps the entries ordered by next run time, so idle
+-- processing only resumes the entries that are due.  Entries waiting inside
+-- io.popenyield are unscheduled until their yieldguard or queue slot is
+-- released, and are marked as waiting so idle processing releases finished
+-- yieldguards before computing the timeout.
+local function schedule_entry(entry, now)
+    if entry.yieldguard or entry.queued then
+        clink._schedule_coroutine(entry.id, nil, true--[[waiting]])
+    else
+        clink._schedule_coroutine(entry.id, next_entry_target(entry, now or os.clock()))
+    end
+end
+
+--------------------------------------------------------------------------------
+local function forget_entry(entry)
+    clink._schedule_coroutine(entry.id, nil)
+    _coroutine_ids[entry.id] = nil
+end
+
 --------------------------------------------------------------------------------
 local function clear_coroutines()
-    local preserve
-    if _coroutine_yieldguard then
-        -- Preserve the active popenyield entry so the system can tell when to
-        -- dequeue the next one.
-        preserve = _coroutines[_coroutine_yieldguard.coroutine]
+    -- Preserve the entries with active popenyield calls so the system can tell
+    -- when to dequeue the next ones.  Their output is no longer needed, so
+    -- cancel them; they become ready as soon as the IO is cancelled.
+    local preserve = {}
+    for t,active in pairs(_popen_active) do
+        if active.yieldguard then
+            if active.yieldguard.cancel then
+                active.yieldguard:cancel()
+            end
+            if _coroutines[t] then
+                table.insert(preserve, _coroutines[t])
+            end
+        end
     end
 
     _coroutines = {}
+    _coroutine_ids = {}
     _coroutines_created = {}
     _after_coroutines = {}
     _coroutines_resumable = false
-    -- Don't touch _coroutine_yieldguard; it only gets cleared when the thread finishes.
+    -- Don't touch _popen_active; entries only get cleared when the threads finish.
+    _popen_queue = {}
     _coroutine_context = nil
     _coroutine_canceled = false
     _coroutine_generation = _coroutine_generation + 1
 
     _dead = (settings.get("lua.debug") or clink.DEBUG) and {} or nil
 
-    if preserve then
-        _coroutines[preserve.coroutine] = preserve
+    clink._clear_coroutine_schedule()
+    for _,entry in ipairs(preserve) do
+        _coroutines[entry.coroutine] = entry
+        _coroutine_ids[entry.id] = entry
+        schedule_entry(entry)
     end
 end
 clink.onbeginedit(clear_coroutines)
 
 --------------------------------------------------------------------------------
-local function release_coroutine_yieldguard()
-    if _coroutine_yieldguard and _coroutine_yieldguard.yieldguard:ready() then
-        local entry = _coroutines[_coroutine_yieldguard.coroutine]
-        if entry and entry.yieldguard == _coroutine_yieldguard.yieldguard then
-            entry.throttleclock = os.clock()
-            entry.yieldguard = nil
-            _coroutine_yieldguard = nil
-            for _,entry in pairs(_coroutines) do
-                if entry.queued then
-                    entry.queued = nil
-                    break
+local function get_max_concurrent_popen()
+    local max = settings.get("lua.max_concurrent_popen")
+    if type(max) ~= "number" or max < 1 then
+        return 1
+    end
+    return max
+end
+
+--------------------------------------------------------------------------------
+local function count_active_popens()
+    local total = 0
+    local contexts = {}
+    for _,active in pairs(_popen_active) do
+        total = total + 1
+        contexts[active.context] = true
+    end
+    return total, contexts
+end
+
+--------------------------------------------------------------------------------
+-- Starts queued popenyield calls in arrival order, as long as the concurrency
+-- limit allows.  For fairness, each context can have only one active call at a
+-- time, so a prompt filter can't starve other prompt filters and a stale
+-- generation of a prompt filter is serialized with the new generation.  Calls
+-- from coroutines that are no longer scheduled are dropped, since nothing will
+-- resume them.
+local function dequeue_popens()
+    local max = get_max_concurrent_popen()
+    local total, contexts = count_active_popens()
+    local i = 1
+    while total < max and i <= #_popen_queue do
+        local item = _popen_queue[i]
+        local entry = _coroutines[item.coroutine]
+        if not entry then
+            table.remove(_popen_queue, i)
+        elseif contexts[item.context] then
+            i = i + 1
+        else
+            table.remove(_popen_queue, i)
+            _popen_active[item.coroutine] = { coroutine=item.coroutine, context=item.context }
+            item.granted = true
+            entry.queued = nil
+            schedule_entry(entry)
+            total = total + 1
+            contexts[item.context] = true
+        end
+    end
+end
+
+--------------------------------------------------------------------------------
+local function release_coroutine_yieldguards()
+    for t,active in pairs(_popen_active) do
+        local entry = _coroutines[t]
+        if active.yieldguard then
+            if active.yieldguard:ready() then
+                if entry and entry.yieldguard == active.yieldguard then
+                    entry.throttleclock = os.clock()
+                    entry.yieldguard = nil
+                    schedule_entry(entry)
                 end
+                _popen_active[t] = nil
             end
+        elseif not entry then
+            -- The slot was granted to a coroutine that will never be resumed.
+            _popen_active[t] = nil
         end
     end
+    dequeue_popens()
+end
+
+--------------------------------------------------------------------------------
+-- Returns true if the running coroutine may start a popenyield call now.
+-- Otherwise the call is queued and the caller must yield until it's granted.
+local function acquire_popen(context)
+    local t = coroutine.running()
+    local total, contexts = count_active_popens()
+    if total < get_max_concurrent_popen() and not contexts[context] then
+        _popen_active[t] = { coroutine=t, context=context }
+        return true
+    end
+
+    local item = { coroutine=t, context=context }
+    table.insert(_popen_queue, item)
+    return false, item
+end
+
+--------------------------------------------------------------------------------
+local function release_popen()
+    _popen_active[coroutine.running()] = nil
+    dequeue_popens()
 end
 
 --------------------------------------------------------------------------------
@@ -90,9 +227,12 @@ end
 local function set_coroutine_yieldguard(yieldguard)
     local t = coroutine.running()
     if yieldguard then
-        _coroutine_yieldguard = { coroutine=t, yieldguard=yieldguard }
+        local active = _popen_active[t]
+        if active then
+            active.yieldguard = yieldguard
+        end
     else
-        release_coroutine_yieldguard()
+        release_coroutine_yieldguards()
     end
     if t and _coroutines[t] then
         _coroutines[t].yieldguard = yieldguard
@@ -108,35 +248,12 @@ local function set_coroutine_queued(queued)
 end
 
 --------------------------------------------------------------------------------
-local function cancel_coroutine(message)
+local function cancel_coroutine(command)
+    local message = (type(command) == "string") and command..": " or ""
     _coroutine_canceled = true
     error(message.."canceling popenyield; coroutine is orphaned")
 end
 
---------------------------------------------------------------------------------
-local function next_entry_target(entry, now)
-    if not entry.lastclock then
-        return 0
-    else
-        -- Multiple kinds of throttling for coroutines that want to run more
-        -- frequently than every 5 seconds:
-        --  1.  Throttle if running for 5 or more seconds, but reset the elapsed
-        --      timer every time io.popenyield() finishes.
-        --  2.  Throttle if running for more than 30 seconds total.
-        -- Throttled coroutines can only run once every 5 seconds.
-        local interval = entry.interval
-        local throttleclock = entry.throttleclock or entry.firstclock
-        if now and interval < 5 then
-            if throttleclock and now - throttleclock > 5 then
-                interval = 5
-            elseif entry.firstclock and now - entry.firstclock > 30 then
-                interval = 5
-            end
-        end
-        return entry.lastclock + interval
-    end
-end
-
 --------------------------------------------------------------------------------
 function clink._after_coroutines(func)
     if type(func) ~= "function" then
@@ -150,22 +267,18 @@ function clink._has_coroutines()
     return _coroutines_resumable
 end
 
+--------------------------------------------------------------------------------
+function clink._release_coroutine_yieldguards()
+    release_coroutine_yieldguards() -- Dequeue next if necessary.
+end
+
 --------------------------------------------------------------------------------
 function clink._wait_duration()
     if _coroutines_resumable then
-        local target
-        local now = os.clock()
-        release_coroutine_yieldguard()  -- Dequeue next if necessary.
-        for _,entry in pairs(_coroutines) do
-            local this_target = next_entry_target(entry, now)
-            if entry.yieldguard or entry.queued then
-                -- Yield until output is ready; don't influence the timeout.
-            elseif not target or target > this_target then
-                target = this_target
-            end
-        end
+        release_coroutine_yieldguards() -- Dequeue next if necessary.
+        local target = clink._next_coroutine_target()
         if target then
-            return target - now
+            return target - os.clock()
         end
     end
 end
@@ -184,14 +297,22 @@ function clink._resume_coroutines()
 
     -- Protected call to resume coroutines.
     local remove = {}
+    local due
+    local done = 0
     local impl = function()
-        for _,entry in pairs(_coroutines) do
-            if coroutine.status(entry.coroutine) == "dead" then
-                table.insert(remove, _)
-            else
-                _coroutines_resumable = true
-                local now = os.clock()
-                if next_entry_target(entry, now) <= now then
+        -- Release finished popenyield calls first, so their coroutines are
+        -- scheduled and can be resumed in this pass.
+        release_coroutine_yieldguards()
+        due = clink._get_due_coroutines(os.clock())
+        for i,id in ipairs(due) do
+            done = i
+            -- Skip ids whose entries were removed since they were scheduled.
+            local entry = _coroutine_ids[id]
+            if entry and _coroutines[entry.coroutine] == entry then
+                if coroutine.status(entry.coroutine) == "dead" then
+                    table.insert(remove, entry.coroutine)
+                else
+                    local now = os.clock()
                     if not entry.firstclock then
                         entry.firstclock = now
                     end
@@ -202,6 +323,11 @@ function clink._resume_coroutines()
                         -- Use live clock so the interval excludes the execution
                         -- time of the coroutine.
                         entry.lastclock = os.clock()
+                        if coroutine.status(entry.coroutine) == "dead" then
+                            table.insert(remove, entry.coroutine)
+                        elseif _coroutines[entry.coroutine] == entry then
+                            schedule_entry(entry, entry.lastclock)
+                        end
                     else
                         if _coroutine_canceled then
                             entry.canceled = true
@@ -211,7 +337,7 @@ function clink._resume_coroutines()
                             print(ret)
                             entry.error = ret
                         end
-                        table.insert(remove, _)
+                        table.insert(remove, entry.coroutine)
                     end
                 end
             end
@@ -219,7 +345,6 @@ function clink._resume_coroutines()
     end
 
     -- Prepare.
-    _coroutines_resumable = false
     clink._set_coroutine_context(nil)
 
     -- Protected call.
@@ -233,6 +358,15 @@ function clink._resume_coroutines()
 
     -- Cleanup.
     clink._set_coroutine_context(nil)
+    if due then
+        -- Reschedule any due entries that didn't get resumed due to an error.
+        for i = done + 1, #due do
+            local entry = _coroutine_ids[due[i]]
+            if entry then
+                schedule_entry(entry)
+            end
+        end
+    end
     for _,c in ipairs(remove) do
         clink.removecoroutine(c)
     end
@@ -330,17 +464,23 @@ function clink._diag_coroutines()
     end
 
     -- Only list coroutines if there are any, or if there's unfinished state.
-    if table_has_elements(threads) or _coroutines_resumable or _coroutine_yieldguard then
+    if table_has_elements(threads) or _coroutines_resumable or table_has_elements(_popen_active) then
         clink.print(bold.."coroutines:"..norm)
         if show_gen then
             print("  generation", (mixed_gen and yellow or norm).."gen ".._coroutine_generation..norm)
         end
         print("  resumable", _coroutines_resumable)
         print("  wait_duration", clink._wait_duration())
-        if _coroutine_yieldguard then
-            local yg = _coroutine_yieldguard.yieldguard
-            print("  yieldguard", (yg:ready() and green.."ready"..norm or yellow.."yield"..norm))
-            print("  yieldcommand", '"'..yg:command()..'"')
+        if table_has_elements(_popen_active) or #_popen_queue > 0 then
+            local total = count_active_popens()
+            print("  popen", total.." active, "..#_popen_queue.." queued, max "..get_max_concurrent_popen())
+        end
+        for _,active in pairs(_popen_active) do
+            local yg = active.yieldguard
+            if yg then
+                print("  yieldguard", (yg:ready() and green.."ready"..norm or yellow.."yield"..norm))
+                print("  yieldcommand", '"'..yg:command()..'"')
+            end
         end
         list_diag(threads, norm)
     end
@@ -361,27 +501,39 @@ function clink.addcoroutine(coroutine, interval)
         error("bad argument #2 (number or nil expected)")
     end
     local created_info = _coroutines_created[coroutine] or {}
-    _coroutines[coroutine] = {
+    if _coroutines[coroutine] then
+        forget_entry(_coroutines[coroutine])
+    end
+    _next_coroutine_id = _next_coroutine_id + 1
+    local entry = {
         coroutine=coroutine,
         interval=interval or 0,
         resumed=0,
         func=created_info.func,
         context=created_info.context,
         generation=created_info.generation,
-        src=created_info.src
+        src=created_info.src,
+        id=_next_coroutine_id,
     }
+    _coroutines[coroutine] = entry
+    _coroutine_ids[entry.id] = entry
     _coroutines_created[coroutine] = nil
     _coroutines_resumable = true
+    schedule_entry(entry)
 end
 
 --------------------------------------------------------------------------------
 function clink.removecoroutine(coroutine)
     if type(coroutine) == "thread" then
-        release_coroutine_yieldguard()
+        local entry = _coroutines[coroutine]
+        if entry then
+            forget_entry(entry)
+        end
         if _dead then
-            table.insert(_dead, _coroutines[coroutine])
+            table.insert(_dead, entry)
         end
         _coroutines[coroutine] = nil
+        release_coroutine_yieldguards()
         _coroutines_resumable = false
         for _ in pairs(_coroutines) do
             _coroutines_resumable = true
@@ -426,30 +578,50 @@ end
 --- -show:  &nbsp;   do_things_with(line)
 --- -show:  end
 --- -show:  file:close()
+---
+--- In Clink v1.3.1 and higher, multiple popenyield commands can run at the
+--- same time, up to the limit in the <code>lua.max_concurrent_popen</code>
+--- setting.  Commands from the same prompt filter still run one at a time.
 function io.popenyield(command, mode)
     -- This outer wrapper is implemented in Lua so that it can yield.
     if settings.get("prompt.async") and not clink.istransientpromptfilter() then
-        -- Yield to ensure only one popenyield active at a time.
-        if _coroutine_yieldguard then
+        -- Cancel if not from the current prompt filter generation.
+        if get_coroutine_generation() ~= _coroutine_generation then
+            cancel_coroutine(command)
+        end
+        -- Yield until the concurrency limit allows the command to start.
+        local ok, item = acquire_popen(_coroutine_context or _no_context)
+        if not ok then
             set_coroutine_queued(true)
-            while _coroutine_yieldguard do
+            while not item.granted do
                 coroutine.yield()
             end
             set_coroutine_queued(false)
+            if get_coroutine_generation() ~= _coroutine_generation then
+                release_popen()
+                cancel_coroutine(command)
+            end
         end
-        -- Cancel if not from the current prompt filter generation.
-        if get_coroutine_generation() ~= _coroutine_generation then
-            local message = (type(command) == string) and command..": " or ""
-            cancel_coroutine(message.."canceling popenyield; coroutine is orphaned")
+        -- Start the popenyield.  Release the slot if it can't start, otherwise
+        -- it would never be released.
+        local started, file, yieldguard = pcall(io.popenyield_internal, command, mode)
+        if not started then
+            release_popen()
+            error(file, 0)
         end
-        -- Start the popenyield.
-        local file, yieldguard = io.popenyield_internal(command, mode)
         if file and yieldguard then
             set_coroutine_yieldguard(yieldguard)
             while not yieldguard:ready() do
                 coroutine.yield()
             end
             set_coroutine_yieldguard(nil)
+            -- A popenyield from a previous generation gets canceled when a new
+            -- edit session begins, so its output may be incomplete.
+            if get_coroutine_generation() ~= _coroutine_generation then
+                cancel_coroutine(command)
+            end
+        else
+            release_popen()
         end
         return file
     else
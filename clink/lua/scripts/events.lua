@@ -10,9 +10,10 @@ clink._event_callbacks = clink._event_callbacks or {}
 function clink._send_event(event, ...)
     local callbacks = clink._event_callbacks[event]
     if callbacks ~= nil then
+        local call = _profile_caller("event:"..event)
         local _, func
         for _, func in ipairs(callbacks) do
-            func(...)
+            call(func, ...)
         end
     end
 end
@@ -23,9 +24,10 @@ end
 function clink._send_event_cancelable(event, ...)
     local callbacks = clink._event_callbacks[event]
     if callbacks ~= nil then
+        local call = _profile_caller("event:"..event)
         local _, func
         for _, func in ipairs(callbacks) do
-            if func(...) == false then
+            if call(func, ...) == false then
                 return
             end
         end
@@ -40,9 +42,10 @@ end
 function clink._send_event_cancelable_string_inout(event, string)
     local callbacks = clink._event_callbacks[event]
     if callbacks ~= nil then
+        local call = _profile_caller("event:"..event)
         local _, func
         for _, func in ipairs(callbacks) do
-            local s,continue = func(string)
+            local s,continue = call(func, string)
             if s then
                 string = s
             end
@@ -178,7 +181,7 @@ function clink._send_ondisplaymatches_event(matches, popup)
     if callbacks ~= nil then
         local func = callbacks[1]
         if func then
-            return func(matches, popup)
+            return _profile_caller("event:ondisplaymatches")(func, matches, popup)
         end
     end
     return matches
@@ -210,9 +213,10 @@ function clink._send_onfiltermatches_event(matches, completion_type, filename_co
     local ret = nil
     local callbacks = clink._event_callbacks["onfiltermatches"]
     if callbacks ~= nil then
+        local call = _profile_caller("event:onfiltermatches")
         local _, func
         for _, func in ipairs(callbacks) do
-            local m = func(matches, completion_type, filename_completion_desired)
+            local m = call(func, matches, completion_type, filename_completion_desired)
             if m ~= nil then
                 matches = m
                 ret = matches
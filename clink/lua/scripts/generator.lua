@@ -67,8 +67,9 @@ function clink._generate(line_state, match_builder, old_filtering)
     local impl = function ()
         clink.generator_stopped = nil
 
+        local call = _profile_caller("generator")
         for _, generator in ipairs(_generators) do
-            local ret = generator:generate(line_state, match_builder)
+            local ret = call(generator.generate, generator, line_state, match_builder)
             if ret == true then
                 -- Remember the generator function that stopped.
                 clink.generator_stopped = generator.generate
@@ -105,9 +106,10 @@ function clink._get_word_break_info(line_state)
     local impl = function ()
         local truncate = 0
         local keep = 0
+        local call = _profile_caller("generator")
         for _, generator in ipairs(_generators) do
             if generator.getwordbreakinfo then
-                local t, k = generator:getwordbreakinfo(line_state)
+                local t, k = call(generator.getwordbreakinfo, generator, line_state)
                 t = t or 0
                 k = k or 0
                 if (t > truncate) or (t == truncate and k > keep) then
@@ -715,6 +715,29 @@ static int is_transient_prompt_filter(lua_State* state)
     return 1;
 }
 
+//------------------------------------------------------------------------------
+// UNDOCUMENTED; internal use only.
+// Returns a string that changes whenever the file's modified time or size
+// changes, or nil if the file doesn't exist.
+static int get_file_stamp(lua_State* state)
+{
+    const char* path = checkstring(state, 1);
+    if (!path)
+        return 0;
+
+    wstr<280> wpath(path);
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    if (!GetFileAttributesExW(wpath.c_str(), GetFileExInfoStandard, &fad))
+        return 0;
+
+    str<64> stamp;
+    stamp.format("%08x%08x:%08x%08x",
+                 fad.ftLastWriteTime.dwHighDateTime, fad.ftLastWriteTime.dwLowDateTime,
+                 fad.nFileSizeHigh, fad.nFileSizeLow);
+    lua_pushlstring(state, stamp.c_str(), stamp.length());
+    return 1;
+}
+
 //------------------------------------------------------------------------------
 // UNDOCUMENTED; internal use only.
 static int history_suggester(lua_State* state)
@@ -829,6 +852,7 @@ void clink_lua_initialise(lua_state& lua)
         { "istransientpromptfilter", &is_transient_prompt_filter },
         { "get_refilter_redisplay_count", &get_refilter_redisplay_count },
         { "history_suggester",      &history_suggester },
+        { "get_file_stamp",         &get_file_stamp },
     };
 
     lua_State* state = lua.get_state();
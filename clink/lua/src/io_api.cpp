@@ -25,12 +25,28 @@
 struct popenrw_info;
 static popenrw_info* s_head = nullptr;
 static HANDLE s_wake_event = nullptr;
+static SRWLOCK s_wake_lock = SRWLOCK_INIT;
 
 //------------------------------------------------------------------------------
 void set_io_wake_event(HANDLE event)
 {
-    // Borrow a ref from the caller.
+    // Borrow a ref from the caller.  Pending popenyield commands signal the
+    // current wake event when they finish, rather than keeping their own copy,
+    // so commands that outlive an edit session wake the next one instead of
+    // signaling an event that has been replaced.  The lock ensures the caller
+    // can close the old event once this returns.
+    AcquireSRWLockExclusive(&s_wake_lock);
     s_wake_event = event;
+    ReleaseSRWLockExclusive(&s_wake_lock);
+}
+
+//------------------------------------------------------------------------------
+static void signal_io_wake_event()
+{
+    AcquireSRWLockShared(&s_wake_lock);
+    if (s_wake_event)
+        SetEvent(s_wake_event);
+    ReleaseSRWLockShared(&s_wake_lock);
 }
 
 //------------------------------------------------------------------------------
@@ -381,74 +397,145 @@ struct pipe_pair
     FILE* local = nullptr;
 };
 
+//------------------------------------------------------------------------------
+// Creates a pipe whose local read end supports overlapped IO.  Anonymous pipes
+// don't support overlapped IO, so this uses a uniquely named pipe.  The remote
+// write end is inheritable, for use as a child process's stdout.
+static bool create_overlapped_pipe(HANDLE& local_read, HANDLE& remote_write, DWORD buffer_size)
+{
+    static volatile long s_pipe_serial = 0;
+
+    local_read = nullptr;
+    remote_write = nullptr;
+
+    wstr<64> name;
+    name.format(L"\\\\.\\pipe\\clink_popenyield_%X_%X",
+                GetCurrentProcessId(), InterlockedIncrement(&s_pipe_serial));
+
+    HANDLE r = CreateNamedPipeW(name.c_str(),
+                                PIPE_ACCESS_INBOUND|FILE_FLAG_OVERLAPPED|FILE_FLAG_FIRST_PIPE_INSTANCE,
+                                PIPE_TYPE_BYTE|PIPE_READMODE_BYTE|PIPE_WAIT|PIPE_REJECT_REMOTE_CLIENTS,
+                                1, 0, buffer_size, 0, nullptr);
+    if (r == INVALID_HANDLE_VALUE)
+    {
+        os::map_errno();
+        return false;
+    }
+
+    SECURITY_ATTRIBUTES sa = { sizeof(sa) };
+    sa.bInheritHandle = true;
+    HANDLE w = CreateFileW(name.c_str(), GENERIC_WRITE, 0, &sa, OPEN_EXISTING, 0, nullptr);
+    if (w == INVALID_HANDLE_VALUE)
+    {
+        os::map_errno();
+        CloseHandle(r);
+        return false;
+    }
+
+    local_read = r;
+    remote_write = w;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// A small pool of worker threads shared by all io.popenyield commands.  The
+// workers service overlapped reads via an IO completion port, so running a
+// command doesn't need a dedicated thread, and a pending read can be cancelled.
+struct popen_io_pool
+{
+    static bool associate(HANDLE h, ULONG_PTR key)
+    {
+        if (!init())
+            return false;
+        return CreateIoCompletionPort(h, s_port, key, 0) == s_port;
+    }
+
+private:
+    static bool init()
+    {
+        if (s_port)
+            return true;
+
+        HANDLE port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, c_workers);
+        if (!port)
+            return false;
+
+        for (unsigned i = 0; i < c_workers; ++i)
+        {
+            HANDLE h = reinterpret_cast<HANDLE>(_beginthreadex(nullptr, 0, &threadproc, port, 0, nullptr));
+            if (!h)
+            {
+                if (i)
+                    break;
+                CloseHandle(port);
+                return false;
+            }
+            CloseHandle(h);
+        }
+
+        s_port = port;
+        return true;
+    }
+
+    static unsigned __stdcall threadproc(void* arg);
+
+    static const unsigned c_workers = 2;
+    static HANDLE s_port;
+};
+
+HANDLE popen_io_pool::s_port = nullptr;
+
 //------------------------------------------------------------------------------
 struct popen_buffering : public std::enable_shared_from_this<popen_buffering>
 {
-    popen_buffering(FILE* r, HANDLE w)
+    popen_buffering(HANDLE r, HANDLE w)
     : m_read(r)
     , m_write(w)
     {
         assert(r != nullptr);
+        assert(r != INVALID_HANDLE_VALUE);
         assert(w != nullptr);
         assert(w != INVALID_HANDLE_VALUE);
     }
 
     ~popen_buffering()
     {
-        if (m_thread_handle)
-        {
-            cancel();
-            CloseHandle(m_thread_handle);
-        }
+        assert(!m_holder);
         if (m_read)
-            fclose(m_read);
+            CloseHandle(m_read);
         if (m_write)
             CloseHandle(m_write);
         if (m_ready_event)
             CloseHandle(m_ready_event);
-        if (m_wake_event)
-            CloseHandle(m_wake_event);
     }
 
-    bool createthread()
+    bool init()
     {
-        assert(!m_suspended);
-        assert(!m_thread_handle);
-        assert(!m_cancelled);
         assert(!m_ready_event);
-        assert(!m_wake_event);
-        if (s_wake_event)
-        {
-            m_wake_event = dup_handle(GetCurrentProcess(), s_wake_event);
-            if (!m_wake_event)
-                return false;
-        }
         m_ready_event = CreateEvent(nullptr, true, false, nullptr);
         if (!m_ready_event)
             return false;
-        m_thread_handle = reinterpret_cast<HANDLE>(_beginthreadex(nullptr, 0, &threadproc, this, CREATE_SUSPENDED, nullptr));
-        if (!m_thread_handle)
-            return false;
-        m_holder = shared_from_this(); // Now threadproc holds a strong ref.
-        m_suspended = true;
-        return true;
+        return popen_io_pool::associate(m_read, reinterpret_cast<ULONG_PTR>(this));
     }
 
     void go()
     {
-        assert(m_suspended);
-        if (m_thread_handle)
-        {
-            m_suspended = false;
-            ResumeThread(m_thread_handle);
-        }
+        assert(!m_holder);
+        m_holder = shared_from_this(); // Now the pending read holds a strong ref.
+        if (!read())
+            finish();
     }
 
     void cancel()
     {
-        m_cancelled = true;
-        if (m_suspended) // Can only be true when there's no concurrency.
-            ResumeThread(m_thread_handle);
+        // The read handle stays open until the destructor, so it's safe to
+        // cancel even if the read has already completed.  When the pending
+        // read is aborted, the worker disconnects the pipe, and then the child
+        // process gets an error the next time it writes.  The child is not
+        // terminated, since commands such as git may need to clean up lock
+        // files.
+        InterlockedExchange(&m_cancelled, true);
+        CancelIoEx(m_read, nullptr);
     }
 
     bool is_ready()
@@ -463,60 +550,89 @@ struct popen_buffering : public std::enable_shared_from_this<popen_buffering>
         return m_ready_event;
     }
 
-private:
-    static unsigned __stdcall threadproc(void* arg)
+    void on_read_complete(bool ok, DWORD len)
     {
-        popen_buffering* _this = static_cast<popen_buffering*>(arg);
-        HANDLE rh = reinterpret_cast<HANDLE>(_get_osfhandle(fileno(_this->m_read)));
-        HANDLE wh = _this->m_write;
-
-        while (!_this->m_cancelled)
+        if (ok && !m_cancelled)
         {
-            DWORD len;
-TODO("COROUTINES: could use overlapped IO to enable cancelling even a blocking call.");
-            if (!ReadFile(rh, _this->m_buffer, sizeof_array(m_buffer), &len, nullptr))
-                break;
-
-            DWORD written;
-            if (!WriteFile(wh, _this->m_buffer, len, &written, nullptr))
-                break;
-            if (written != len)
-                break;
+            DWORD written = len;
+            if (len && !WriteFile(m_write, m_buffer, len, &written, nullptr))
+                written = 0;
+            if (written == len && read())
+                return;
         }
 
+        finish();
+    }
+
+private:
+    bool read()
+    {
+        if (m_cancelled)
+            return false;
+
+        ZeroMemory(&m_overlapped, sizeof(m_overlapped));
+        if (ReadFile(m_read, m_buffer, sizeof_array(m_buffer), nullptr, &m_overlapped))
+            return true; // The completion is still queued to the port.
+        return GetLastError() == ERROR_IO_PENDING;
+    }
+
+    void finish()
+    {
+        // Let the child process know nobody is listening anymore.
+        if (m_cancelled)
+            DisconnectNamedPipe(m_read);
+
         // Reset file pointer so the read handle can read from the beginning.
-        SetFilePointer(wh, 0, nullptr, FILE_BEGIN);
+        SetFilePointer(m_write, 0, nullptr, FILE_BEGIN);
 
         // Close the write handle since it's finished.
-        CloseHandle(_this->m_write);
-        _this->m_write = nullptr;
+        CloseHandle(m_write);
+        m_write = nullptr;
 
         // Signal completion events.
-        SetEvent(_this->m_ready_event);
-        if (_this->m_wake_event)
-            SetEvent(_this->m_wake_event);
-
-        // Release threadproc's strong ref.
-        _this->m_holder = nullptr;
+        SetEvent(m_ready_event);
+        signal_io_wake_event();
 
-        _endthreadex(0);
-        return 0;
+        // Release the pending read's strong ref.  This may delete this object,
+        // so nothing may touch members afterwards.
+        std::shared_ptr<popen_buffering> holder;
+        holder.swap(m_holder);
     }
 
-    FILE* m_read;
+    HANDLE m_read;
     HANDLE m_write;
-    HANDLE m_thread_handle = 0;
     HANDLE m_ready_event = 0;
-    HANDLE m_wake_event = 0;
-    bool m_suspended = false;
+    OVERLAPPED m_overlapped = {};
 
     volatile long m_cancelled = false;
-    volatile long m_ready = false;
 
     std::shared_ptr<popen_buffering> m_holder;
-    BYTE m_buffer[4096];
+    BYTE m_buffer[64 * 1024];
 };
 
+//------------------------------------------------------------------------------
+unsigned __stdcall popen_io_pool::threadproc(void* arg)
+{
+    HANDLE port = static_cast<HANDLE>(arg);
+    while (true)
+    {
+        DWORD len = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED* overlapped = nullptr;
+        BOOL ok = GetQueuedCompletionStatus(port, &len, &key, &overlapped, INFINITE);
+        if (!overlapped)
+            break;
+
+        // Failure includes ERROR_BROKEN_PIPE when the child process exits, and
+        // ERROR_OPERATION_ABORTED when the read is cancelled.
+        popen_buffering* buffering = reinterpret_cast<popen_buffering*>(key);
+        buffering->on_read_complete(!!ok, len);
+    }
+
+    _endthreadex(0);
+    return 0;
+}
+
 
 
 //------------------------------------------------------------------------------
@@ -530,6 +646,7 @@ struct luaL_YieldGuard
 private:
     static int ready(lua_State* state);
     static int command(lua_State* state);
+    static int cancel(lua_State* state);
     static int __gc(lua_State* state);
     static int __tostring(lua_State* state);
 
@@ -551,6 +668,7 @@ luaL_YieldGuard* luaL_YieldGuard::make_new(lua_State* state)
     {
         {"ready", ready},
         {"command", luaL_YieldGuard::command}, // Ambiguous because of command arg.
+        {"cancel", luaL_YieldGuard::cancel},
         {"__gc", __gc},
         {"__tostring", __tostring},
         {nullptr, nullptr}
@@ -597,6 +715,14 @@ int luaL_YieldGuard::command(lua_State* state)
     return 1;
 }
 
+//------------------------------------------------------------------------------
+int luaL_YieldGuard::cancel(lua_State* state)
+{
+    luaL_YieldGuard* yg = (luaL_YieldGuard*)luaL_checkudata(state, 1, LUA_YIELDGUARD);
+    yg->m_buffering->cancel();
+    return 0;
+}
+
 //------------------------------------------------------------------------------
 int luaL_YieldGuard::__gc(lua_State* state)
 {
@@ -740,7 +866,6 @@ int luaL_YieldGuard::__tostring(lua_State* state)
 
     luaL_Stream* pr = nullptr;
     luaL_YieldGuard* yg = nullptr;
-    pipe_pair pipe_stdout;
 
     pr = (luaL_Stream*)lua_newuserdata(state, sizeof(luaL_Stream));
     luaL_setmetatable(state, LUA_FILEHANDLE);
@@ -752,11 +877,15 @@ int luaL_YieldGuard::__tostring(lua_State* state)
     bool failed = true;
     FILE* temp_read = nullptr;
     HANDLE temp_write = nullptr;
+    HANDLE pipe_read = nullptr;
+    HANDLE pipe_write = nullptr;
     std::shared_ptr<popen_buffering> buffering;
     popenrw_info* info = nullptr;
 
     do
     {
+        // The temp file is short-lived, so it generally stays in the file
+        // system cache rather than being written to disk.
         os::temp_file_mode tfmode = os::temp_file_mode::delete_on_close;
         if (binary)
             tfmode |= os::temp_file_mode::binary;
@@ -769,21 +898,25 @@ int luaL_YieldGuard::__tostring(lua_State* state)
         if (!temp_write)
             break;
 
-        // The pipe and temp_write are both binary to simplify the thread's job.
-        if (!pipe_stdout.init(false/*write*/, true/*binary*/))
+        // The pipe and temp_write are both binary to simplify the worker's job.
+        if (!create_overlapped_pipe(pipe_read, pipe_write, 64 * 1024))
             break;
 
-        buffering = std::make_shared<popen_buffering>(pipe_stdout.local, temp_write);
-        pipe_stdout.transfer_local();
+        buffering = std::make_shared<popen_buffering>(pipe_read, temp_write);
+        pipe_read = nullptr;
         temp_write = nullptr;
-        if (!buffering->createthread())
+        if (!buffering->init())
             break;
 
         info = new popenrw_info;
-        intptr_t process_handle = popenrw_internal(command, NULL, pipe_stdout.remote);
+        intptr_t process_handle = popenrw_internal(command, NULL, pipe_write);
         if (!process_handle)
             break;
 
+        // The child process has its own copy of the write end now.
+        CloseHandle(pipe_write);
+        pipe_write = nullptr;
+
         pr->f = temp_read;
         pr->closef = &pclosefile;
         temp_read = nullptr;
@@ -809,6 +942,10 @@ int luaL_YieldGuard::__tostring(lua_State* state)
             fclose(temp_read);
         if (temp_write)
             CloseHandle(temp_write);
+        if (pipe_read)
+            CloseHandle(pipe_read);
+        if (pipe_write)
+            CloseHandle(pipe_write);
         delete info;
         buffering = nullptr;
 
@@ -6,8 +6,14 @@
 #include "lua_state.h"
 
 #include <core/base.h>
+#include <core/os.h>
 
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
 #include <assert.h>
+#include <math.h>
 
 extern "C" {
 #include <lua.h>
@@ -18,6 +24,252 @@ extern "C" {
 //------------------------------------------------------------------------------
 extern void set_io_wake_event(HANDLE event);
 
+//------------------------------------------------------------------------------
+// Coroutines are scheduled by id in a min-heap keyed by their next run time.
+// Rescheduling or unscheduling an id doesn't search the heap; it bumps the
+// id's serial number, and stale heap items are discarded when they reach the
+// top.  Coroutines that are waiting for a wake event (e.g. inside
+// io.popenyield) aren't in the heap at all, so they don't affect the timeout,
+// but they're remembered as waiting so idle processing knows to check whether
+// their popenyield calls have finished.
+class coroutine_schedule
+{
+public:
+    void            schedule(unsigned int id, double target);
+    void            unschedule(unsigned int id, bool waiting=false);
+    void            clear();
+    bool            peek(double& target);
+    void            pop_due(double now, std::vector<unsigned int>& due);
+    bool            has_waiting() const { return !m_waiting.empty(); }
+
+private:
+    struct item
+    {
+        double          target;
+        unsigned int    id;
+        unsigned int    serial;
+    };
+    struct later
+    {
+        bool operator()(const item& a, const item& b) const
+        {
+            if (a.target != b.target)
+                return a.target > b.target;
+            return a.serial > b.serial;
+        }
+    };
+    bool            is_stale(const item& i) const;
+    void            discard_stale();
+    void            compact();
+    std::vector<item> m_heap;
+    std::map<unsigned int, unsigned int> m_current;
+    std::set<unsigned int> m_waiting;
+    unsigned int    m_serial = 0;
+};
+
+//------------------------------------------------------------------------------
+void coroutine_schedule::schedule(unsigned int id, double target)
+{
+    const unsigned int serial = ++m_serial;
+    m_current[id] = serial;
+    m_waiting.erase(id);
+    m_heap.push_back({ target, id, serial });
+    std::push_heap(m_heap.begin(), m_heap.end(), later());
+    compact();
+}
+
+//------------------------------------------------------------------------------
+void coroutine_schedule::unschedule(unsigned int id, bool waiting)
+{
+    m_current.erase(id);
+    if (waiting)
+        m_waiting.insert(id);
+    else
+        m_waiting.erase(id);
+    discard_stale();
+    compact();
+}
+
+//------------------------------------------------------------------------------
+void coroutine_schedule::clear()
+{
+    m_heap.clear();
+    m_current.clear();
+    m_waiting.clear();
+}
+
+//------------------------------------------------------------------------------
+bool coroutine_schedule::peek(double& target)
+{
+    discard_stale();
+    if (m_heap.empty())
+        return false;
+
+    target = m_heap.front().target;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void coroutine_schedule::pop_due(double now, std::vector<unsigned int>& due)
+{
+    discard_stale();
+    while (!m_heap.empty() && m_heap.front().target <= now)
+    {
+        const unsigned int id = m_heap.front().id;
+        std::pop_heap(m_heap.begin(), m_heap.end(), later());
+        m_heap.pop_back();
+        m_current.erase(id);
+        due.push_back(id);
+        discard_stale();
+    }
+}
+
+//------------------------------------------------------------------------------
+bool coroutine_schedule::is_stale(const item& i) const
+{
+    const auto it = m_current.find(i.id);
+    return it == m_current.end() || it->second != i.serial;
+}
+
+//------------------------------------------------------------------------------
+void coroutine_schedule::discard_stale()
+{
+    while (!m_heap.empty() && is_stale(m_heap.front()))
+    {
+        std::pop_heap(m_heap.begin(), m_heap.end(), later());
+        m_heap.pop_back();
+    }
+}
+
+//------------------------------------------------------------------------------
+void coroutine_schedule::compact()
+{
+    // Coroutines that reschedule often leave stale items buried in the heap;
+    // rebuild it once they outnumber the live items.
+    if (m_heap.size() < 64 || m_heap.size() < m_current.size() * 2)
+        return;
+
+    m_heap.erase(std::remove_if(m_heap.begin(), m_heap.end(), [this](const item& i) {
+        return is_stale(i);
+    }), m_heap.end());
+    std::make_heap(m_heap.begin(), m_heap.end(), later());
+}
+
+
+
+//------------------------------------------------------------------------------
+static const char* const c_schedule_key = "clink_coroutine_schedule";
+
+//------------------------------------------------------------------------------
+static coroutine_schedule* get_schedule(lua_State* state)
+{
+    lua_getfield(state, LUA_REGISTRYINDEX, c_schedule_key);
+    coroutine_schedule* schedule = (coroutine_schedule*)lua_touserdata(state, -1);
+    lua_pop(state, 1);
+    return schedule;
+}
+
+//------------------------------------------------------------------------------
+// UNDOCUMENTED; internal use only.
+static int schedule_coroutine(lua_State* state)
+{
+    coroutine_schedule* schedule = get_schedule(state);
+    if (!schedule)
+        return 0;
+
+    const unsigned int id = unsigned(checkinteger(state, 1));
+    if (lua_isnoneornil(state, 2))
+        schedule->unschedule(id, lua_toboolean(state, 3));
+    else
+        schedule->schedule(id, checknumber(state, 2));
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// UNDOCUMENTED; internal use only.
+static int clear_coroutine_schedule(lua_State* state)
+{
+    if (coroutine_schedule* schedule = get_schedule(state))
+        schedule->clear();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// UNDOCUMENTED; internal use only.
+static int get_due_coroutines(lua_State* state)
+{
+    coroutine_schedule* schedule = get_schedule(state);
+    if (!schedule)
+        return 0;
+
+    std::vector<unsigned int> due;
+    schedule->pop_due(optnumber(state, 1, os::clock()), due);
+
+    lua_createtable(state, int(due.size()), 0);
+    for (size_t i = 0; i < due.size(); ++i)
+    {
+        lua_pushinteger(state, due[i]);
+        lua_rawseti(state, -2, int(i + 1));
+    }
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+// UNDOCUMENTED; internal use only.
+static int next_coroutine_target(lua_State* state)
+{
+    coroutine_schedule* schedule = get_schedule(state);
+    double target;
+    if (!schedule || !schedule->peek(target))
+        return 0;
+
+    lua_pushnumber(state, target);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+void coroutines_lua_initialise(lua_state& lua)
+{
+    struct {
+        const char* name;
+        int         (*method)(lua_State*);
+    } methods[] = {
+        // UNDOCUMENTED; internal use only.
+        { "_schedule_coroutine",        &schedule_coroutine },
+        { "_clear_coroutine_schedule",  &clear_coroutine_schedule },
+        { "_get_due_coroutines",        &get_due_coroutines },
+        { "_next_coroutine_target",     &next_coroutine_target },
+    };
+
+    lua_State* state = lua.get_state();
+
+    void* addr = lua_newuserdata(state, sizeof(coroutine_schedule));
+    new (addr) coroutine_schedule();
+    lua_createtable(state, 0, 1);
+    lua_pushliteral(state, "__gc");
+    lua_pushcfunction(state, [](lua_State* state) -> int {
+        coroutine_schedule* schedule = (coroutine_schedule*)lua_touserdata(state, -1);
+        schedule->~coroutine_schedule();
+        return 0;
+    });
+    lua_rawset(state, -3);
+    lua_setmetatable(state, -2);
+    lua_setfield(state, LUA_REGISTRYINDEX, c_schedule_key);
+
+    lua_getglobal(state, "clink");
+
+    for (const auto& method : methods)
+    {
+        lua_pushstring(state, method.name);
+        lua_pushcfunction(state, method.method);
+        lua_rawset(state, -3);
+    }
+
+    lua_pop(state, 1);
+}
+
+
+
 //------------------------------------------------------------------------------
 lua_input_idle::lua_input_idle(lua_state& state)
 : m_state(state)
@@ -63,28 +315,23 @@ unsigned lua_input_idle::get_timeout()
 {
     m_iterations++;
 
-    lua_State* state = m_state.get_state();
-    save_stack_top ss(state);
-
-    // Call to Lua to check for coroutines.
-    lua_getglobal(state, "clink");
-    lua_pushliteral(state, "_wait_duration");
-    lua_rawget(state, -2);
-
-    if (m_state.pcall(state, 0, 1) != 0)
-    {
-        if (const char* error = lua_tostring(state, -1))
-            m_state.print_error(error);
-
+    // The schedule is native, so computing the timeout doesn't need to call
+    // into Lua unless coroutines are waiting inside io.popenyield.  Those
+    // aren't scheduled; finished popenyield calls are released here on every
+    // wake or timeout, even if nothing signaled the wake event, so that their
+    // coroutines and any coroutines queued behind them get scheduled.
+    coroutine_schedule* schedule = get_schedule(m_state.get_state());
+    if (schedule && schedule->has_waiting())
+        release_yieldguards();
+
+    double target;
+    if (!schedule || !schedule->peek(target))
         return INFINITE;
-    }
 
-    int isnum;
-    double sec = lua_tonumberx(state, -1, &isnum);
-    if (!isnum)
-        return INFINITE;
-
-    return (sec > 0) ? unsigned(sec * 1000) : 0;
+    // Round up so the wait doesn't end slightly before the coroutine is due
+    // and then spin through zero-length waits.
+    const double sec = target - os::clock();
+    return (sec > 0) ? unsigned(ceil(sec * 1000)) : 0;
 }
 
 //------------------------------------------------------------------------------
@@ -127,6 +374,23 @@ bool lua_input_idle::has_coroutines()
     return has;
 }
 
+//------------------------------------------------------------------------------
+void lua_input_idle::release_yieldguards()
+{
+    lua_State* state = m_state.get_state();
+    save_stack_top ss(state);
+
+    lua_getglobal(state, "clink");
+    lua_pushliteral(state, "_release_coroutine_yieldguards");
+    lua_rawget(state, -2);
+
+    if (m_state.pcall(state, 0, 0) != 0)
+    {
+        if (const char* error = lua_tostring(state, -1))
+            m_state.print_error(error);
+    }
+}
+
 //------------------------------------------------------------------------------
 void lua_input_idle::resume_coroutines()
 {
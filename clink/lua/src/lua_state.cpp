@@ -62,6 +62,22 @@ static setting_bool g_lua_breakonerror(
     "Breaks into the Lua debugger on Lua errors, if lua.debug is enabled.",
     false);
 
+static setting_bool g_lua_profile(
+    "lua.profile",
+    "Profiles Lua callbacks",
+    "When enabled, Clink records how many times each match generator, word\n"
+    "classifier, prompt filter, suggester, and event handler is called, how long\n"
+    "it takes, and how much Lua memory it allocates.  The results are listed by\n"
+    "the clink-diagnostics command and are available via clink.getprofile().",
+    false);
+
+static setting_int g_lua_max_concurrent_popen(
+    "lua.max_concurrent_popen",
+    "Max concurrent io.popenyield commands",
+    "The maximum number of io.popenyield() commands that can run at the same\n"
+    "time.  Commands from the same prompt filter always run one at a time.",
+    4);
+
 setting_bool g_lua_strict(
     "lua.strict",
     "Fail on argument errors",
@@ -75,6 +91,7 @@ setting_bool g_lua_strict(
 
 //------------------------------------------------------------------------------
 void clink_lua_initialise(lua_state&);
+void coroutines_lua_initialise(lua_state&);
 void os_lua_initialise(lua_state&);
 void io_lua_initialise(lua_state&);
 void console_lua_initialise(lua_state&);
@@ -221,6 +238,7 @@ void lua_state::initialise()
 
     // Initialize API namespaces.
     clink_lua_initialise(self);
+    coroutines_lua_initialise(self);
     os_lua_initialise(self);
     io_lua_initialise(self);
     console_lua_initialise(self);
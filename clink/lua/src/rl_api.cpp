@@ -13,6 +13,7 @@
 #include <core/str_iter.h>
 #include <terminal/ecma48_iter.h>
 #include "lib/matches.h"
+#include "lib/screen_grab.h"
 #include "match_builder_lua.h"
 #include "prompt.h"
 
@@ -541,6 +542,32 @@ static int get_last_command(lua_State* state)
     return 2;
 }
 
+//------------------------------------------------------------------------------
+// Discards the current matches and returns the matches object for providing an
+// alternative set of matches, or nullptr on failure.
+static matches* begin_set_matches(lua_State* state, bool nosort)
+{
+    matches* matches = get_mutable_matches(nosort);
+    if (!matches)
+        return nullptr;
+
+    {
+        save_stack_top ss(state);
+
+        lua_getglobal(state, "clink");
+        lua_pushliteral(state, "_reset_display_filter");
+        lua_rawget(state, -2);
+        if (lua_state::pcall(state, 0, 0) != 0)
+        {
+            puts(lua_tostring(state, -1));
+            return nullptr;
+        }
+    }
+
+    rl_last_func = nullptr;
+    return matches;
+}
+
 //------------------------------------------------------------------------------
 /// -name:  rl.setmatches
 /// -ver:   1.1.40
@@ -601,29 +628,35 @@ static int set_matches(lua_State* state)
         lua_pop(state, 1);
     }
 
-    matches* matches = get_mutable_matches(nosort);
+    matches* matches = begin_set_matches(state, nosort);
     if (!matches)
         return 0;
 
-    {
-        save_stack_top ss(state);
+    match_builder builder(*matches);
+    match_builder_lua builder_lua(builder);
 
-        lua_getglobal(state, "clink");
-        lua_pushliteral(state, "_reset_display_filter");
-        lua_rawget(state, -2);
-        if (lua_state::pcall(state, 0, 0) != 0)
-        {
-            puts(lua_tostring(state, -1));
-            return 0;
-        }
-    }
+    return builder_lua.add_matches(state);
+}
 
-    rl_last_func = nullptr;
+//------------------------------------------------------------------------------
+// UNDOCUMENTED; internal use only.
+// Sets the matches to the numbers on the visible part of the screen, ordered by
+// distance from the input line.  This scans the same lines as passing the
+// results from console.screengrab("[^%w]*(%w%w[%w]+)", "^%x+$") to
+// rl.setmatches(), but natively instead of line by line in Lua, and duplicate
+// numbers are skipped.
+static int set_number_matches(lua_State* state)
+{
+    matches* matches = begin_set_matches(state, true/*nosort*/);
+    if (!matches)
+        return 0;
 
     match_builder builder(*matches);
-    match_builder_lua builder_lua(builder);
+    console_line_source source(GetStdHandle(STD_OUTPUT_HANDLE));
+    const unsigned int count = screen_grab(source, screen_token_pattern::numbers(), builder);
 
-    return builder_lua.add_matches(state);
+    lua_pushinteger(state, count);
+    return 1;
 }
 
 //------------------------------------------------------------------------------
@@ -907,6 +940,8 @@ void rl_lua_initialise(lua_state& lua)
         { "getpromptinfo",          &get_prompt_info },
         { "insertmode",             &getset_insert_mode },
         { "ismodifiedline",         &is_modified_line },
+        // UNDOCUMENTED; internal use only.
+        { "set_number_matches",     &set_number_matches },
     };
 
     lua_State* state = lua.get_state();
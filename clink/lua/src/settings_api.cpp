@@ -13,6 +13,47 @@
 //------------------------------------------------------------------------------
 extern setting_bool g_lua_strict;
 
+// Address of this is the registry key for the table of cached handles.
+static const char s_handles_key = 0;
+
+
+
+//------------------------------------------------------------------------------
+// Scripts look up the same few settings over and over.  The handles are cached
+// keyed by the name string, which Lua has already interned, so repeat lookups
+// skip hashing and comparing the name.
+static setting* find_setting(lua_State* state, int index)
+{
+    lua_rawgetp(state, LUA_REGISTRYINDEX, &s_handles_key);
+    if (!lua_istable(state, -1))
+    {
+        lua_pop(state, 1);
+        return settings::find(lua_tostring(state, index));
+    }
+
+    lua_pushvalue(state, index);
+    lua_rawget(state, -2);
+    settings::handle h = settings::handle(lua_tointeger(state, -1));
+    lua_pop(state, 1);
+
+    // The handle stops resolving if the setting was removed; look it up again.
+    setting* s = settings::from_handle(h);
+    if (!s)
+    {
+        h = settings::find_handle(lua_tostring(state, index));
+        if (h)
+        {
+            lua_pushvalue(state, index);
+            lua_pushinteger(state, h);
+            lua_rawset(state, -3);
+            s = settings::from_handle(h);
+        }
+    }
+
+    lua_pop(state, 1);
+    return s;
+}
+
 
 
 //------------------------------------------------------------------------------
@@ -33,7 +74,7 @@ static int get(lua_State* state)
     if (!key)
         return 0;
 
-    const setting* setting = settings::find(key);
+    const setting* setting = find_setting(state, 1);
     if (setting == nullptr)
         return 0;
 
@@ -87,7 +128,7 @@ static int set(lua_State* state)
     if (!key)
         return 0;
 
-    setting* setting = settings::find(key);
+    setting* setting = find_setting(state, 1);
     if (setting == nullptr)
         return 0;
 
@@ -366,6 +407,9 @@ void settings_lua_initialise(lua_state& lua)
 
     lua_State* state = lua.get_state();
 
+    lua_newtable(state);
+    lua_rawsetp(state, LUA_REGISTRYINDEX, &s_handles_key);
+
     lua_createtable(state, sizeof_array(methods), 0);
 
     for (const auto& method : methods)
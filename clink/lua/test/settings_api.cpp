@@ -0,0 +1,73 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/base.h>
+#include <core/os.h>
+#include <core/settings.h>
+#include <lua/lua_state.h>
+
+extern "C" {
+#include <lua.h>
+}
+
+extern bool g_show_benchmarks;
+
+//------------------------------------------------------------------------------
+TEST_CASE("Lua settings")
+{
+    lua_state lua;
+    lua_State* state = lua.get_state();
+
+    auto* test = new setting_int("!lua.setting", "", nullptr, 42);
+
+    auto get_int = [&] (const char* script) {
+        REQUIRE(lua.do_string(script));
+        lua_getglobal(state, "x");
+        const int value = lua_isnumber(state, -1) ? int(lua_tointeger(state, -1)) : -1;
+        lua_pop(state, 1);
+        return value;
+    };
+
+    SECTION("Get")
+    {
+        REQUIRE(get_int("x = settings.get('!lua.setting')") == 42);
+        REQUIRE(get_int("x = settings.get('!LUA.Setting')") == 42);
+        REQUIRE(get_int("x = settings.get('!lua.nope')") == -1);
+    }
+
+    SECTION("Removed")
+    {
+        // A cached handle doesn't find a setting that was removed, and finds
+        // the new setting when one is added again by the same name.
+        REQUIRE(get_int("x = settings.get('!lua.setting')") == 42);
+
+        delete test;
+        test = nullptr;
+        REQUIRE(get_int("x = settings.get('!lua.setting')") == -1);
+
+        setting_int again("!lua.setting", "", nullptr, 7);
+        REQUIRE(get_int("x = settings.get('!lua.setting')") == 7);
+    }
+
+    SECTION("Benchmark")
+    {
+        if (g_show_benchmarks)
+        {
+            const char* script = "\
+                local get = settings.get\
+                for i = 1, 1000000 do\
+                    x = get('!lua.setting')\
+                end";
+
+            const double start = os::clock();
+            REQUIRE(get_int(script) == 42);
+            const double elapsed = os::clock() - start;
+
+            printf("\nlua settings.get x1000000:  %.1f msec\n", elapsed * 1000);
+        }
+    }
+
+    delete test;
+}
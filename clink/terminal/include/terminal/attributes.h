@@ -84,6 +84,7 @@ public:
     attribute<bool>             get_bold() const;
     attribute<bool>             get_underline() const;
     attribute<bool>             get_reverse() const;
+    unsigned long long          get_key() const { return m_state; }
 
 private:
     union flags
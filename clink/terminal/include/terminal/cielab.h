@@ -0,0 +1,59 @@
+// Copyright (c) 2020 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+namespace cie
+{
+
+//------------------------------------------------------------------------------
+struct lab
+{
+    lab() = default;
+    lab(COLORREF c) { from_rgb(c); }
+
+    void from_rgb(COLORREF c);
+
+    bool operator==(lab const &lab) { return !memcmp(this, &lab, sizeof(lab)); }
+
+    double l = 0;
+    double a = 0;
+    double b = 0;
+};
+
+//------------------------------------------------------------------------------
+inline double pow2(double x)
+{
+    return x * x;
+}
+
+//------------------------------------------------------------------------------
+float deltaE2(const lab& lab1, const lab& lab2);    // squared
+float deltaE(const lab& lab1, const lab& lab2);     // sqrt()
+float deltaE(COLORREF c1, COLORREF c2);
+
+//------------------------------------------------------------------------------
+// Maps colors to the nearest of the 16 console palette colors.  Colors are
+// stored with 5 bits per channel, so results are cached in a 32x32x32 table
+// and each color is only searched for once per palette.
+class palette_lut
+{
+public:
+    enum { palette_size = 16 };
+
+                    palette_lut() { reset(); }
+    void            reset();
+    bool            has_palette() const { return m_has_palette; }
+    bool            set_palette(const COLORREF (&palette)[palette_size]);
+    int             find_nearest(COLORREF c) const;
+    int             lookup(unsigned char r, unsigned char g, unsigned char b);
+
+private:
+    enum : unsigned char { unknown = 0xff };
+    COLORREF        m_palette[palette_size];
+    lab             m_labs[palette_size];
+    unsigned char   m_table[32 * 32 * 32];
+    bool            m_has_palette;
+};
+
+};
@@ -170,6 +170,7 @@ private:
     bool                next_esc_st(int c);
     bool                next_unknown(int c);
     str_iter            m_iter;
+    const char*         m_end;
     ecma48_code&        m_code;
     ecma48_state&       m_state;
     int                 m_nested_cmd_str;
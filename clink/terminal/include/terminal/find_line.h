@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <memory>
+
 //------------------------------------------------------------------------------
 enum find_line_mode : int
 {
@@ -13,9 +15,44 @@ enum find_line_mode : int
 DEFINE_ENUM_FLAG_OPERATORS(find_line_mode);
 
 //------------------------------------------------------------------------------
+// Supplies screen rows to find_line().  Rows are read in blocks, so searching a
+// large scrollback costs a few reads instead of one per row.
+class find_line_source
+{
+public:
+    virtual         ~find_line_source() = default;
+    virtual int     get_width() const = 0;
+    virtual int     get_height() const = 0;
+
+    // Reads rows [first, first + count) into cells, get_width() cells per row.
+    // The second cell of a wide character has COMMON_LVB_TRAILING_BYTE set.
+    virtual bool    read_rows(int first, int count, CHAR_INFO* cells) = 0;
+};
+
+//------------------------------------------------------------------------------
+// Matches text within one row.  Returns 1 and sets start and length (in
+// wchar_t units) if found, 0 if not found, or -1 on error.
+class find_line_matcher
+{
+public:
+    virtual         ~find_line_matcher() = default;
+    virtual int     match(const wchar_t* text, unsigned int len, int& start, int& length) const = 0;
+};
+
+// Returns a substring or regex matcher for text, depending on mode.  Returns
+// nullptr if text is not a valid regex.
+std::unique_ptr<find_line_matcher> make_find_line_matcher(const char* text, find_line_mode mode);
+
+//------------------------------------------------------------------------------
+int find_line(find_line_source& source,
+              int starting_line, int distance,
+              const find_line_matcher* matcher,
+              const BYTE* attrs=nullptr, int num_attrs=0, BYTE mask=0xff);
+int find_line(find_line_source& source,
+              int starting_line, int distance,
+              const char* text, find_line_mode mode,
+              const BYTE* attrs=nullptr, int num_attrs=0, BYTE mask=0xff);
 int find_line(HANDLE h, const CONSOLE_SCREEN_BUFFER_INFO& csbi,
-              wchar_t* chars_buffer, int chars_capacity,
-              WORD* attrs_buffer, int attrs_capacity,
               int starting_line, int distance,
               const char* text, find_line_mode mode,
               const BYTE* attrs=nullptr, int num_attrs=0, BYTE mask=0xff);
@@ -0,0 +1,40 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <core/str.h>
+
+//------------------------------------------------------------------------------
+class frame_sink
+{
+public:
+    virtual         ~frame_sink() = default;
+    virtual void    emit(const char* data, int length) = 0;
+};
+
+//------------------------------------------------------------------------------
+// Collects the output written during a frame (e.g. one redisplay cycle) and
+// emits it to the sink as one batched write when the outermost frame ends.
+// Outside of a frame, writes go straight to the sink.  Frames can nest.
+class frame_buffer
+{
+public:
+    enum { default_capacity = 4096 };
+
+                    frame_buffer(frame_sink& sink, unsigned int capacity=default_capacity);
+                    ~frame_buffer();
+    void            begin_frame();
+    void            end_frame();
+    void            write(const char* data, int length);
+    void            flush();
+    bool            in_frame() const { return m_depth > 0; }
+    unsigned int    get_emit_count() const { return m_emit_count; }
+
+private:
+    frame_sink&     m_sink;
+    str_moveable    m_pending;
+    unsigned int    m_capacity;
+    unsigned int    m_depth = 0;
+    unsigned int    m_emit_count = 0;
+};
@@ -0,0 +1,90 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "screen_buffer.h"
+
+#include <deque>
+#include <vector>
+
+class str_base;
+enum find_line_mode : int;
+
+//------------------------------------------------------------------------------
+// A screen_buffer that models a grid of cells in memory instead of writing to
+// a console.  It has a cursor, auto-wrap (with the deferred wrap that the "xn"
+// termcap flag describes), scrolling, and an optional scrollback.  Pair it with
+// terminal_create() to interpret ecma48 output, e.g. to test or measure
+// redisplay without a console.
+class headless_screen_buffer
+    : public screen_buffer
+{
+public:
+    struct cell
+    {
+        char32_t    ch;             // 0 for the second cell of a wide char.
+        attributes  attr;
+    };
+
+                    headless_screen_buffer(int columns=80, int rows=25, int scrollback=0);
+    virtual void    open() override {}
+    virtual void    begin() override {}
+    virtual void    end() override {}
+    virtual void    close() override {}
+    virtual void    begin_frame() override {}
+    virtual void    end_frame() override {}
+    virtual void    write(const char* data, int length) override;
+    virtual void    flush() override {}
+    virtual int     get_columns() const override { return m_columns; }
+    virtual int     get_rows() const override { return m_rows; }
+    virtual bool    get_line_text(int line, str_base& out) const override;
+    virtual bool    has_native_vt_processing() const override { return false; }
+    virtual void    clear(clear_type type) override;
+    virtual void    clear_line(clear_type type) override;
+    virtual void    set_horiz_cursor(int column) override;
+    virtual void    set_cursor(int column, int row) override;
+    virtual void    move_cursor(int dx, int dy) override;
+    virtual void    save_cursor() override;
+    virtual void    restore_cursor() override;
+    virtual void    insert_chars(int count) override;
+    virtual void    delete_chars(int count) override;
+    virtual void    set_attributes(const attributes attr) override;
+    virtual bool    get_nearest_color(attributes& attr) const override { return true; }
+    virtual int     is_line_default_color(int line) const override;
+    virtual int     line_has_color(int line, const BYTE* attrs, int num_attrs, BYTE mask=0xff) const override;
+    virtual int     find_line(int starting_line, int distance, const char* text, find_line_mode mode, const BYTE* attrs=nullptr, int num_attrs=0, BYTE mask=0xff) const override;
+
+    int             get_line_count() const { return int(m_lines.size()); }
+    int             get_top() const { return m_top; }
+    int             get_cursor_column() const { return m_x; }
+    int             get_cursor_row() const { return m_y; }
+    const cell*     get_cell(int column, int line) const;
+    unsigned int    get_cells_changed() const { return m_cells_changed; }
+    void            reset_cells_changed() { m_cells_changed = 0; }
+
+private:
+    class line_source;
+    typedef std::vector<cell> line_cells;
+
+    line_cells&     get_line(int row) { return m_lines[m_top + row]; }
+    void            put_char(char32_t c);
+    void            line_feed();
+    void            set_cell(line_cells& line, int column, char32_t ch);
+    void            split_wide(line_cells& line, int begin, int end);
+    void            fill(line_cells& line, int begin, int end);
+    static BYTE     to_console_attr(const attributes attr);
+
+    const int       m_columns;
+    const int       m_rows;
+    const int       m_scrollback;
+    std::deque<line_cells> m_lines;
+    int             m_top = 0;
+    int             m_x = 0;
+    int             m_y = 0;
+    int             m_saved_x = 0;
+    int             m_saved_y = 0;
+    bool            m_pending_wrap = false;
+    attributes      m_attr;
+    unsigned int    m_cells_changed = 0;
+};
@@ -0,0 +1,43 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Finds the key sequence at the beginning of some input, using a trie of known
+// key sequences.  The first byte costs one table lookup, so input that doesn't
+// begin a known sequence is rejected immediately.
+//
+// This is only used to look up key names.  It isn't an input decoder:  the
+// console delivers key events rather than a byte stream, so win_terminal_in
+// builds each key's sequence directly, and ESC is disambiguated there and by
+// Readline's keyseq-timeout.  Resolving binds uses binder's own trie, because
+// of its groups and fallback binds.
+class keyseq_trie
+{
+public:
+    enum { max_seq = 32 };
+
+                    keyseq_trie();
+    void            clear();
+    bool            empty() const { return m_nodes.size() <= 1; }
+    bool            add(const char* seq, int value);
+    bool            remove(const char* seq);
+    int             lookup(const char* seq, int& len) const;
+
+private:
+    struct node
+    {
+        unsigned int    child;      // First child, or 0.
+        unsigned int    sibling;    // Next sibling, or 0.
+        int             value;      // -1 if no sequence ends here.
+        unsigned char   c;
+    };
+
+    unsigned int    find_child(unsigned int parent, unsigned char c) const;
+    unsigned int    add_child(unsigned int parent, unsigned char c);
+    std::vector<node> m_nodes;
+    unsigned int    m_root[256];
+};
@@ -24,6 +24,8 @@ public:
     template <int S> void   print(const char (&data)[S]);
     template <int S> void   print(const char* attr, const char (&data)[S]);
     template <int S> void   print(const attributes attr, const char (&data)[S]);
+    void                    begin_frame();
+    void                    end_frame();
     unsigned int            get_columns() const;
     unsigned int            get_rows() const;
     bool                    get_line_text(int line, str_base& out) const;
@@ -32,6 +34,8 @@ public:
     int                     find_line(int starting_line, int distance, const char* text, find_line_mode mode, const BYTE* attrs=nullptr, int num_attrs=0, BYTE mask=0xff) const;
     attributes              set_attributes(const attributes attr);
     attributes              get_attributes() const;
+    static void             build_sgr(const attributes diff, str_base& out);
+    unsigned int            get_sgr_cache_misses() const { return m_sgr_cache_misses; }
 
 private: /* TODO: unimplemented API */
     typedef unsigned int    cursor_state;
@@ -41,11 +45,27 @@ private: /* TODO: unimplemented API */
     cursor_state            get_cursor() const;
 
 private:
+    // Caches the SGR escape codes for recent attribute transitions, so that
+    // redisplaying colored text doesn't format the same codes over and over.
+    struct sgr_cache_entry
+    {
+        unsigned long long  from;
+        unsigned long long  to;
+        unsigned char       length;
+        bool                valid;
+        char                sgr[32];    // Same size as the str<32> it's built in.
+    };
+    enum { sgr_cache_size = 16 };
+
     void                    flush_attributes();
+    const sgr_cache_entry&  get_sgr(const attributes from, const attributes to);
     terminal_out&           m_terminal;
     attributes              m_set_attr;
     attributes              m_next_attr;
     bool                    m_nodiff;
+    sgr_cache_entry         m_sgr_cache[sgr_cache_size] = {};
+    unsigned int            m_sgr_cache_next = 0;
+    unsigned int            m_sgr_cache_misses = 0;
 };
 
 //------------------------------------------------------------------------------
@@ -40,6 +40,8 @@ public:
     virtual void    begin() = 0;
     virtual void    end() = 0;
     virtual void    close() = 0;
+    virtual void    begin_frame() = 0;
+    virtual void    end_frame() = 0;
     virtual void    write(const char* data, int length) = 0;
     virtual void    flush() = 0;
     virtual int     get_columns() const = 0;
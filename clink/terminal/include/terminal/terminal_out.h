@@ -19,6 +19,8 @@ public:
     virtual void            begin() = 0;
     virtual void            end() = 0;
     virtual void            close() = 0;    // Should be not strictly required.
+    virtual void            begin_frame() = 0;  // Collect output until end_frame(), and write it all at once.
+    virtual void            end_frame() = 0;
     virtual void            write(const char* chars, int length) = 0;
     template <int S> void   write(const char (&chars)[S]);
     virtual bool            get_line_text(int line, str_base& out) const = 0;
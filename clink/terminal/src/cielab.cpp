@@ -117,4 +117,75 @@ float deltaE(COLORREF c1, COLORREF c2)
     return deltaE(lab1, lab2);
 }
 
+
+
+//------------------------------------------------------------------------------
+void palette_lut::reset()
+{
+    memset(m_palette, 0, sizeof(m_palette));
+    memset(m_table, unknown, sizeof(m_table));
+    m_has_palette = false;
+}
+
+//------------------------------------------------------------------------------
+// Returns true if the palette changed, in which case the table is discarded.
+bool palette_lut::set_palette(const COLORREF (&palette)[palette_size])
+{
+    if (m_has_palette && !memcmp(m_palette, palette, sizeof(m_palette)))
+        return false;
+
+    memcpy(m_palette, palette, sizeof(m_palette));
+    for (int i = 0; i < palette_size; ++i)
+        m_labs[i].from_rgb(m_palette[i]);
+    memset(m_table, unknown, sizeof(m_table));
+    m_has_palette = true;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Exhaustive search.  Ties go to the higher palette index.
+int palette_lut::find_nearest(COLORREF c) const
+{
+    if (!m_has_palette)
+        return -1;
+
+    const lab target(c);
+    float best_deltaE = 0;
+    int best_idx = -1;
+
+    for (int i = palette_size; i--;)
+    {
+        const float d = deltaE(target, m_labs[i]);
+        if (best_idx < 0 || best_deltaE > d)
+        {
+            best_deltaE = d;
+            best_idx = i;
+        }
+    }
+
+    return best_idx;
+}
+
+//------------------------------------------------------------------------------
+// Takes 5 bit channels, expanded to 8 bits the same way as
+// attributes::color::as_888().
+int palette_lut::lookup(unsigned char r, unsigned char g, unsigned char b)
+{
+    if (!m_has_palette)
+        return -1;
+
+    r &= 0x1f;
+    g &= 0x1f;
+    b &= 0x1f;
+
+    unsigned char& entry = m_table[(r << 10) | (g << 5) | b];
+    if (entry == unknown)
+    {
+        const COLORREF c = RGB((r << 3) | (r & 7), (g << 3) | (g & 7), (b << 3) | (b & 7));
+        entry = static_cast<unsigned char>(find_nearest(c));
+    }
+
+    return entry;
+}
+
 };
@@ -10,6 +10,11 @@
 
 #include <assert.h>
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#   define ECMA48_USE_SSE2
+#   include <emmintrin.h>
+#endif
+
 //------------------------------------------------------------------------------
 extern "C" unsigned int cell_count(const char* in)
 {
@@ -36,6 +41,78 @@ static bool in_range(int value, int left, int right)
     return (unsigned(right - value) <= unsigned(right - left));
 }
 
+//------------------------------------------------------------------------------
+// Chars chunks are capped so their length fits in ecma48_code::m_length, with
+// headroom for the multibyte codepoint that may straddle the cap.
+static const int c_max_chars_chunk = 0xffff - 8;
+
+//------------------------------------------------------------------------------
+static unsigned int first_set_bit(unsigned long long mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+#   if defined(_M_X64)
+    _BitScanForward64(&index, mask);
+#   else
+    if (!_BitScanForward(&index, (unsigned long)mask))
+    {
+        _BitScanForward(&index, (unsigned long)(mask >> 32));
+        index += 32;
+    }
+#   endif
+    return index;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Returns a pointer to the first byte at or after s that is not printable ASCII
+// (0x20-0x7f), or end if there is none before end.  When end is null the scan
+// stops at the nul terminator, which is itself not printable.  Bytes are read
+// in aligned blocks, which never straddle a page boundary, so reading past the
+// terminator or end within a block is harmless.
+static const char* skip_plain_ascii(const char* s, const char* end)
+{
+#if defined(ECMA48_USE_SSE2)
+    // Signed compare:  0x00-0x1f and 0x80-0xff are all less than 0x20.
+    const __m128i threshold = _mm_set1_epi8(0x20);
+    const char* block = (const char*)(uintptr_t(s) & ~uintptr_t(15));
+    unsigned int mask = _mm_movemask_epi8(_mm_cmplt_epi8(_mm_load_si128((const __m128i*)block), threshold));
+    mask &= ~0u << (s - block);
+    while (!mask)
+    {
+        block += 16;
+        if (end && block >= end)
+            return end;
+        mask = _mm_movemask_epi8(_mm_cmplt_epi8(_mm_load_si128((const __m128i*)block), threshold));
+    }
+
+    const char* p = block + first_set_bit(mask);
+#else
+    // SWAR:  a byte is flagged when its high bit is set, or when subtracting
+    // 0x20 borrows.  A borrow can only flag bytes after an already flagged
+    // byte, so the lowest flagged byte is exact.
+    static const unsigned long long ones = 0x0101010101010101ull;
+    const char* block = (const char*)(uintptr_t(s) & ~uintptr_t(7));
+    unsigned long long word = *(const unsigned long long*)block;
+    unsigned long long mask = (word | (word - ones * 0x20)) & (ones * 0x80);
+    mask &= ~0ull << ((s - block) * 8);
+    while (!mask)
+    {
+        block += 8;
+        if (end && block >= end)
+            return end;
+        word = *(const unsigned long long*)block;
+        mask = (word | (word - ones * 0x20)) & (ones * 0x80);
+    }
+
+    const char* p = block + first_set_bit(mask) / 8;
+#endif
+
+    return (end && p > end) ? end : p;
+}
+
 //------------------------------------------------------------------------------
 static void strip_code_terminator(const char*& ptr, int& len)
 {
@@ -253,6 +330,7 @@ bool ecma48_code::get_c1_str(str_base& out) const
 //------------------------------------------------------------------------------
 ecma48_iter::ecma48_iter(const char* s, ecma48_state& state, int len)
 : m_iter(s, len)
+, m_end((len >= 0) ? s + len : nullptr)
 , m_code(state.code)
 , m_state(state)
 , m_nested_cmd_str(0)
@@ -363,6 +441,26 @@ bool ecma48_iter::next_char(int c)
     }
 
     m_iter.next();
+
+    // Fast path:  skip a run of printable ASCII at once.  Anything else goes
+    // back through the state machine one codepoint at a time, since malformed
+    // UTF8 can decode to a control code.
+    const char* ptr = m_iter.get_pointer();
+    const char* limit = m_code.get_pointer() + c_max_chars_chunk;
+    if (m_end && m_end < limit)
+        limit = m_end;
+    if (ptr < limit)
+    {
+        ptr = skip_plain_ascii(ptr, limit);
+        m_iter.skip_pointer(ptr);
+    }
+
+    if (m_iter.get_pointer() - m_code.get_pointer() >= c_max_chars_chunk)
+    {
+        m_code.m_type = ecma48_code::type_chars;
+        return true;
+    }
+
     return false;
 }
 
@@ -129,6 +129,18 @@ void ecma48_terminal_out::close()
     m_screen.close();
 }
 
+//------------------------------------------------------------------------------
+void ecma48_terminal_out::begin_frame()
+{
+    m_screen.begin_frame();
+}
+
+//------------------------------------------------------------------------------
+void ecma48_terminal_out::end_frame()
+{
+    m_screen.end_frame();
+}
+
 //------------------------------------------------------------------------------
 void ecma48_terminal_out::flush()
 {
@@ -262,6 +274,7 @@ void ecma48_terminal_out::write_icf(const ecma48_code& code)
 {
     if (code.get_code() == ecma48_code::icf_vb)
     {
+        m_screen.flush();
         visible_bell();
     }
 }
@@ -558,6 +571,7 @@ void ecma48_terminal_out::set_private_mode(const ecma48_code::csi_base& csi)
             Ps = 5  -> Reverse Video (DECSCNM).
             Ps = 12 -> Start Blinking Cursor (att610).
             Ps = 25 -> Show Cursor (DECTCEM). */
+    m_screen.flush();
     for (int i = 0; i < csi.param_count; ++i)
     {
         switch (csi.params[i])
@@ -580,6 +594,7 @@ void ecma48_terminal_out::reset_private_mode(const ecma48_code::csi_base& csi)
             Ps = 5  -> Normal Video (DECSCNM).
             Ps = 12 -> Stop Blinking Cursor (att610).
             Ps = 25 -> Hide Cursor (DECTCEM). */
+    m_screen.flush();
     for (int i = 0; i < csi.param_count; ++i)
     {
         switch (csi.params[i])
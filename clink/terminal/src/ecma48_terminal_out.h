@@ -19,6 +19,8 @@ public:
     virtual void        begin() override;
     virtual void        end() override;
     virtual void        close() override;
+    virtual void        begin_frame() override;
+    virtual void        end_frame() override;
     virtual void        write(const char* chars, int length) override;
     virtual void        flush() override;
     virtual int         get_columns() const override;
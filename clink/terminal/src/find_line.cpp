@@ -9,144 +9,321 @@
 #include <core/str.h>
 #include <core/str_transform.h>
 
-#include <assert.h>
-
 #include <regex>
+#include <string>
+#include <vector>
 
 //------------------------------------------------------------------------------
-int find_line(HANDLE h, const CONSOLE_SCREEN_BUFFER_INFO& csbi,
-              wchar_t* chars_buffer, int chars_capacity,
-              WORD* attrs_buffer, int attrs_capacity,
-              int starting_line, int distance,
-              const char* text, find_line_mode mode,
-              const BYTE* attrs, int num_attrs, BYTE mask)
+// ReadConsoleOutputW fails if the buffer exceeds roughly 64KB, so blocks are
+// limited to this many cells.
+static const int c_block_cells = 8192;
+
+// Scripts tend to call console.findline() repeatedly with the same few
+// patterns, so compiled regexes are kept in a small most-recently-used list.
+static const size_t c_regex_cache_size = 8;
+
+
+
+//------------------------------------------------------------------------------
+struct regex_cache_entry
 {
-    assert(!text || chars_capacity >= csbi.dwSize.X);
-    if (!(!text || chars_capacity >= csbi.dwSize.X))
-        return -2;
+    std::wstring                        pattern;
+    bool                                icase;
+    std::shared_ptr<const std::wregex>  regex;
+};
 
-    assert(!attrs || num_attrs <= 0 || attrs_capacity >= csbi.dwSize.X);
-    if (!(!attrs || num_attrs <= 0 || attrs_capacity >= csbi.dwSize.X))
-        return -2;
+//------------------------------------------------------------------------------
+static std::shared_ptr<const std::wregex> get_regex(const wchar_t* pattern, bool icase)
+{
+    static std::vector<regex_cache_entry> s_cache;
 
-    wstr_moveable find;
-    wstr_moveable tmp;
-    std::unique_ptr<std::wregex> regex;
-    if (text && *text)
+    for (auto it = s_cache.begin(); it != s_cache.end(); ++it)
     {
-        find = text;
-
-        if (mode & find_line_mode::use_regex)
+        if (it->icase == icase && it->pattern == pattern)
         {
-            std::regex_constants::syntax_option_type syntax = std::regex_constants::ECMAScript;
-            if (mode & find_line_mode::ignore_case)
-                syntax |= std::regex_constants::icase;
-
-            try
+            if (it != s_cache.begin())
             {
-                regex = std::make_unique<std::wregex>(find.c_str(), syntax);
-            }
-            catch (std::regex_error ex)
-            {
-                return -1;
+                regex_cache_entry entry = std::move(*it);
+                s_cache.erase(it);
+                s_cache.insert(s_cache.begin(), std::move(entry));
             }
+            return s_cache.front().regex;
         }
-        else
+    }
+
+    std::regex_constants::syntax_option_type syntax = std::regex_constants::ECMAScript;
+    if (icase)
+        syntax |= std::regex_constants::icase;
+
+    std::shared_ptr<const std::wregex> regex;
+    try
+    {
+        regex = std::make_shared<const std::wregex>(pattern, syntax);
+    }
+    catch (const std::regex_error&)
+    {
+        return nullptr;
+    }
+
+    if (s_cache.size() >= c_regex_cache_size)
+        s_cache.pop_back();
+    s_cache.insert(s_cache.begin(), { pattern, icase, regex });
+    return regex;
+}
+
+
+
+//------------------------------------------------------------------------------
+class substring_matcher
+    : public find_line_matcher
+{
+public:
+                    substring_matcher(const char* text, bool ignore_case);
+    virtual int     match(const wchar_t* text, unsigned int len, int& start, int& length) const override;
+
+private:
+    wstr_moveable   m_find;
+    const bool      m_ignore_case;
+    mutable wstr_moveable m_tmp;
+};
+
+//------------------------------------------------------------------------------
+substring_matcher::substring_matcher(const char* text, bool ignore_case)
+: m_ignore_case(ignore_case)
+{
+    m_find = text;
+    if (ignore_case)
+    {
+        wstr_moveable tmp;
+        str_transform(m_find.c_str(), m_find.length(), tmp, transform_mode::lower);
+        m_find = std::move(tmp);
+    }
+}
+
+//------------------------------------------------------------------------------
+int substring_matcher::match(const wchar_t* text, unsigned int len, int& start, int& length) const
+{
+    // Presume that str_transform preserves the alignment between text and
+    // attributes.
+    if (m_ignore_case)
+    {
+        str_transform(text, len, m_tmp, transform_mode::lower);
+        text = m_tmp.c_str();
+        len = m_tmp.length();
+    }
+
+    const unsigned int find_len = m_find.length();
+    if (find_len > len)
+        return 0;
+
+    if (!find_len)
+    {
+        start = 0;
+        length = 0;
+        return 1;
+    }
+
+    // Skip to candidates with wmemchr, then compare the rest of the text.
+    const wchar_t* find = m_find.c_str();
+    const wchar_t* last = text + len - find_len;
+    for (const wchar_t* p = text; p <= last; ++p)
+    {
+        p = wmemchr(p, find[0], last - p + 1);
+        if (!p)
+            break;
+
+        if (wmemcmp(p + 1, find + 1, find_len - 1) == 0)
         {
-            find = text;
-            if (mode & find_line_mode::ignore_case)
-            {
-                str_transform(find.c_str(), find.length(), tmp, transform_mode::lower);
-                find = std::move(tmp);
-            }
+            start = int(p - text);
+            length = int(find_len);
+            return 1;
         }
     }
 
-    int start_found = 0;
-    int len_found = csbi.dwSize.X;
+    return 0;
+}
+
+
+
+//------------------------------------------------------------------------------
+class regex_matcher
+    : public find_line_matcher
+{
+public:
+                    regex_matcher(std::shared_ptr<const std::wregex> regex) : m_regex(std::move(regex)) {}
+    virtual int     match(const wchar_t* text, unsigned int len, int& start, int& length) const override;
+
+private:
+    std::shared_ptr<const std::wregex> m_regex;
+};
+
+//------------------------------------------------------------------------------
+int regex_matcher::match(const wchar_t* text, unsigned int len, int& start, int& length) const
+{
+    std::wcmatch matches;
+    try
+    {
+        if (!std::regex_search(text, text + len, matches, *m_regex, std::regex_constants::match_default))
+            return 0;
+    }
+    catch (const std::regex_error&)
+    {
+        return -1;
+    }
+
+    start = static_cast<int>(matches.position(0));
+    length = static_cast<int>(matches.length(0));
+    return 1;
+}
+
+
+
+//------------------------------------------------------------------------------
+class console_find_line_source
+    : public find_line_source
+{
+public:
+                    console_find_line_source(HANDLE h, const CONSOLE_SCREEN_BUFFER_INFO& csbi) : m_handle(h), m_csbi(csbi) {}
+    virtual int     get_width() const override { return m_csbi.dwSize.X; }
+    virtual int     get_height() const override { return m_csbi.dwSize.Y; }
+    virtual bool    read_rows(int first, int count, CHAR_INFO* cells) override;
+
+private:
+    const HANDLE    m_handle;
+    const CONSOLE_SCREEN_BUFFER_INFO& m_csbi;
+};
+
+//------------------------------------------------------------------------------
+bool console_find_line_source::read_rows(int first, int count, CHAR_INFO* cells)
+{
+    const COORD size = { m_csbi.dwSize.X, SHORT(count) };
+    const COORD coord = { 0, 0 };
+    SMALL_RECT rect = { 0, SHORT(first), SHORT(m_csbi.dwSize.X - 1), SHORT(first + count - 1) };
+    if (!ReadConsoleOutputW(m_handle, cells, size, coord, &rect))
+        return false;
+
+    return (rect.Top == first && rect.Bottom == first + count - 1 && rect.Right == m_csbi.dwSize.X - 1);
+}
+
+
+
+//------------------------------------------------------------------------------
+std::unique_ptr<find_line_matcher> make_find_line_matcher(const char* text, find_line_mode mode)
+{
+    const bool ignore_case = !!(mode & find_line_mode::ignore_case);
+
+    if (mode & find_line_mode::use_regex)
+    {
+        wstr_moveable pattern(text);
+        std::shared_ptr<const std::wregex> regex = get_regex(pattern.c_str(), ignore_case);
+        if (!regex)
+            return nullptr;
+        return std::make_unique<regex_matcher>(std::move(regex));
+    }
+
+    return std::make_unique<substring_matcher>(text, ignore_case);
+}
+
+//------------------------------------------------------------------------------
+int find_line(find_line_source& source,
+              int starting_line, int distance,
+              const find_line_matcher* matcher,
+              const BYTE* attrs, int num_attrs, BYTE mask)
+{
+    const int width = source.get_width();
+    const int height = source.get_height();
+    if (width <= 0)
+        return -2;
+
+    const int block_rows = max(1, c_block_cells / width);
+    std::unique_ptr<CHAR_INFO[]> block(new CHAR_INFO[block_rows * width]);
+    int block_first = 0;
+    int block_count = 0;
+
+    // Maps each wchar_t of the row text to the column where it starts, so
+    // matches can be checked against the attributes of the matched cells.
+    std::unique_ptr<wchar_t[]> text(new wchar_t[width + 1]);
+    std::unique_ptr<int[]> columns(new int[width + 1]);
 
     while (distance != 0)
     {
-        if (starting_line < 0 || starting_line >= csbi.dwSize.Y)
+        if (starting_line < 0 || starting_line >= height)
             return 0;
 
-        bool found_text = true;
-        if (text)
+        // Read the next block of rows in the direction of the search.
+        if (starting_line < block_first || starting_line >= block_first + block_count)
         {
-            COORD coord = { 0, SHORT(starting_line) };
-            DWORD len = 0;
-            if (!ReadConsoleOutputCharacterW(h, chars_buffer, csbi.dwSize.X, coord, &len))
-                return -1;
-            if (len != csbi.dwSize.X)
+            const int rows = min(block_rows, distance > 0 ? distance : -distance);
+            if (distance > 0)
+            {
+                block_first = starting_line;
+                block_count = min(rows, height - starting_line);
+            }
+            else
+            {
+                block_first = max(0, starting_line - rows + 1);
+                block_count = starting_line - block_first + 1;
+            }
+
+            if (!source.read_rows(block_first, block_count, block.get()))
                 return -1;
+        }
 
-            while (len > 0 && iswspace(chars_buffer[len - 1]))
-                len--;
-            chars_buffer[len] = '\0';
+        const CHAR_INFO* row = block.get() + (starting_line - block_first) * width;
 
-            const wchar_t* line_text = chars_buffer;
-            if (!regex && (mode & find_line_mode::ignore_case))
-            {
-                str_transform(chars_buffer, len, tmp, transform_mode::lower);
-                line_text = tmp.c_str();
-                len = tmp.length();
-            }
+        int start_col = 0;
+        int end_col = width;
 
-            if (regex)
+        bool found_text = true;
+        if (matcher)
+        {
+            unsigned int len = 0;
+            for (int i = 0; i < width; ++i)
             {
-                std::wcmatch matches;
-                try
-                {
-                    std::regex_search(line_text, line_text + len, matches, *regex, std::regex_constants::match_default);
-                }
-                catch (std::regex_error ex)
-                {
-                    return -2;
-                }
-
-                found_text = matches.size() > 0;
-                if (found_text)
-                {
-                    start_found = static_cast<int>(matches.position(0));
-                    len_found = static_cast<int>(matches.length(0));
-                }
+                if (row[i].Attributes & COMMON_LVB_TRAILING_BYTE)
+                    continue;
+                columns[len] = i;
+                text[len++] = row[i].Char.UnicodeChar;
             }
-            else
+            const unsigned int full_len = len;
+            columns[full_len] = width;
+
+            while (len > 0 && iswspace(text[len - 1]))
+                len--;
+            text[len] = '\0';
+
+            int start_found;
+            int len_found;
+            const int result = matcher->match(text.get(), len, start_found, len_found);
+            if (result < 0)
+                return -2;
+
+            found_text = (result > 0);
+            if (found_text)
             {
-                // Presume that str_transform preserved the alignment between
-                // text and attributes.
-                const wchar_t* found = wcsstr(chars_buffer, find.c_str());
-                found_text = !!found;
-                start_found = static_cast<int>(found - chars_buffer);
-                len_found = find.length();
+                const unsigned int begin = min<unsigned int>(start_found, full_len);
+                const unsigned int end = min<unsigned int>(start_found + len_found, full_len);
+                start_col = columns[begin];
+                end_col = columns[end];
             }
         }
 
         bool found_attr = true;
-        if (attrs && num_attrs)
+        if (found_text && attrs && num_attrs)
         {
             found_attr = false;
 
-            COORD coord = { SHORT(start_found), SHORT(starting_line) };
-            DWORD len = 0;
-            if (!ReadConsoleOutputAttribute(h, attrs_buffer, len_found, coord, &len))
-                return -2;
-            if (len != len_found)
-                return -2;
-
             const BYTE* end_attrs = attrs + num_attrs;
-            for (const WORD* attr = attrs_buffer; len--; attr++)
+            for (int i = start_col; !found_attr && i < end_col; ++i)
             {
+                const BYTE attr = BYTE(row[i].Attributes);
                 for (const BYTE* find_attr = attrs; find_attr < end_attrs; find_attr++)
-                    if ((BYTE(*attr) & mask) == (*find_attr & mask))
+                    if ((attr & mask) == (*find_attr & mask))
                     {
                         found_attr = true;
-                        goto break_break;
+                        break;
                     }
             }
-
-break_break:
-            ;
         }
 
         if (found_text && found_attr)
@@ -166,3 +343,30 @@ break_break:
 
     return -1;
 }
+
+//------------------------------------------------------------------------------
+int find_line(find_line_source& source,
+              int starting_line, int distance,
+              const char* text, find_line_mode mode,
+              const BYTE* attrs, int num_attrs, BYTE mask)
+{
+    std::unique_ptr<find_line_matcher> matcher;
+    if (text && *text)
+    {
+        matcher = make_find_line_matcher(text, mode);
+        if (!matcher)
+            return -1;
+    }
+
+    return find_line(source, starting_line, distance, matcher.get(), attrs, num_attrs, mask);
+}
+
+//------------------------------------------------------------------------------
+int find_line(HANDLE h, const CONSOLE_SCREEN_BUFFER_INFO& csbi,
+              int starting_line, int distance,
+              const char* text, find_line_mode mode,
+              const BYTE* attrs, int num_attrs, BYTE mask)
+{
+    console_find_line_source source(h, csbi);
+    return find_line(source, starting_line, distance, text, mode, attrs, num_attrs, mask);
+}
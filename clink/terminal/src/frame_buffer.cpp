@@ -0,0 +1,82 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "frame_buffer.h"
+
+#include <assert.h>
+
+//------------------------------------------------------------------------------
+frame_buffer::frame_buffer(frame_sink& sink, unsigned int capacity)
+: m_sink(sink)
+, m_capacity(capacity)
+{
+}
+
+//------------------------------------------------------------------------------
+frame_buffer::~frame_buffer()
+{
+    assert(m_pending.empty());
+}
+
+//------------------------------------------------------------------------------
+void frame_buffer::begin_frame()
+{
+    m_depth++;
+}
+
+//------------------------------------------------------------------------------
+void frame_buffer::end_frame()
+{
+    assert(m_depth > 0);
+    if (m_depth > 0)
+        m_depth--;
+    if (!m_depth)
+        flush();
+}
+
+//------------------------------------------------------------------------------
+void frame_buffer::write(const char* data, int length)
+{
+    if (length < 0)
+        length = int(strlen(data));
+    if (length <= 0)
+        return;
+
+    if (!m_depth)
+    {
+        flush();
+        m_emit_count++;
+        m_sink.emit(data, length);
+        return;
+    }
+
+    // Don't let a large frame grow without bound; emit what's pending and
+    // keep collecting.  Output that's larger than the capacity by itself
+    // gains nothing from being copied, so it's emitted directly.
+    if (m_pending.length() + unsigned(length) > m_capacity)
+    {
+        flush();
+        if (unsigned(length) > m_capacity)
+        {
+            m_emit_count++;
+            m_sink.emit(data, length);
+            return;
+        }
+    }
+
+    if (m_pending.empty())
+        m_pending.reserve(m_capacity);
+    m_pending.concat_no_truncate(data, length);
+}
+
+//------------------------------------------------------------------------------
+void frame_buffer::flush()
+{
+    if (m_pending.empty())
+        return;
+
+    m_emit_count++;
+    m_sink.emit(m_pending.c_str(), m_pending.length());
+    m_pending.clear();
+}
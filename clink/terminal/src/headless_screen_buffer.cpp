@@ -0,0 +1,490 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "headless_screen_buffer.h"
+#include "ecma48_iter.h"
+#include "find_line.h"
+
+#include <core/base.h>
+#include <core/str.h>
+#include <core/str_iter.h>
+
+#include <assert.h>
+
+
+//------------------------------------------------------------------------------
+static void append_utf8(str_base& out, char32_t c)
+{
+    char buffer[5];
+    int n = 0;
+    if (c < 0x80)
+    {
+        buffer[n++] = char(c);
+    }
+    else if (c < 0x800)
+    {
+        buffer[n++] = char(0xc0 | (c >> 6));
+        buffer[n++] = char(0x80 | (c & 0x3f));
+    }
+    else if (c < 0x10000)
+    {
+        buffer[n++] = char(0xe0 | (c >> 12));
+        buffer[n++] = char(0x80 | ((c >> 6) & 0x3f));
+        buffer[n++] = char(0x80 | (c & 0x3f));
+    }
+    else
+    {
+        buffer[n++] = char(0xf0 | ((c >> 18) & 0x07));
+        buffer[n++] = char(0x80 | ((c >> 12) & 0x3f));
+        buffer[n++] = char(0x80 | ((c >> 6) & 0x3f));
+        buffer[n++] = char(0x80 | (c & 0x3f));
+    }
+    out.concat(buffer, n);
+}
+
+
+
+//------------------------------------------------------------------------------
+headless_screen_buffer::headless_screen_buffer(int columns, int rows, int scrollback)
+: m_columns(max(columns, 1))
+, m_rows(max(rows, 1))
+, m_scrollback(max(scrollback, 0))
+, m_attr(attributes::defaults)
+{
+    const cell blank = { ' ', attributes::defaults };
+    m_lines.resize(m_rows, line_cells(m_columns, blank));
+}
+
+//------------------------------------------------------------------------------
+void headless_screen_buffer::write(const char* data, int length)
+{
+    str_iter iter(data, length);
+    while (iter.more())
+    {
+        const int c = iter.next();
+        switch (c)
+        {
+        case '\n':
+            // Like the console, a line feed also returns the carriage.
+            line_feed();
+            m_x = 0;
+            m_pending_wrap = false;
+            break;
+
+        case '\r':
+            m_x = 0;
+            m_pending_wrap = false;
+            break;
+
+        case '\t':
+            m_x = min((m_x + 8) & ~7, m_columns - 1);
+            m_pending_wrap = false;
+            break;
+
+        default:
+            if (c >= ' ')
+                put_char(c);
+            break;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+bool headless_screen_buffer::get_line_text(int line, str_base& out) const
+{
+    if (line < 0 || line >= get_line_count())
+        return false;
+
+    const line_cells& cells = m_lines[line];
+
+    int len = m_columns;
+    while (len > 0 && (cells[len - 1].ch == ' ' || !cells[len - 1].ch))
+        len--;
+
+    out.clear();
+    for (int i = 0; i < len; ++i)
+        if (cells[i].ch)
+            append_utf8(out, cells[i].ch);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void headless_screen_buffer::clear(clear_type type)
+{
+    int first_row;
+    int last_row;
+
+    switch (type)
+    {
+    case clear_type_all:
+        first_row = 0;
+        last_row = m_rows;
+        break;
+
+    case clear_type_before:
+        first_row = 0;
+        last_row = m_y;
+        fill(get_line(m_y), 0, m_x + 1);
+        break;
+
+    case clear_type_after:
+        first_row = m_y + 1;
+        last_row = m_rows;
+        fill(get_line(m_y), m_x, m_columns);
+        break;
+
+    default:
+        return;
+    }
+
+    for (int row = first_row; row < last_row; ++row)
+        fill(get_line(row), 0, m_columns);
+}
+
+//------------------------------------------------------------------------------
+void headless_screen_buffer::clear_line(clear_type type)
+{
+    switch (type)
+    {
+    case clear_type_all:    fill(get_line(m_y), 0, m_columns); break;
+    case clear_type_before: fill(get_line(m_y), 0, m_x + 1); break;
+    case clear_type_after:  fill(get_line(m_y), m_x, m_columns); break;
+    }
+}
+
+//------------------------------------------------------------------------------
+void headless_screen_buffer::set_horiz_cursor(int column)
+{
+    m_x = clamp(column, 0, m_columns - 1);
+    m_pending_wrap = false;
+}
+
+//------------------------------------------------------------------------------
+void headless_screen_buffer::set_cursor(int column, int row)
+{
+    m_x = clamp(column, 0, m_columns - 1);
+    m_y = clamp(row, 0, m_rows - 1);
+    m_pending_wrap = false;
+}
+
+//------------------------------------------------------------------------------
+void headless_screen_buffer::move_cursor(int dx, int dy)
+{
+    // Clamp the deltas first; carriage return moves by INT_MIN.
+    dx = clamp(dx, -m_columns, m_columns);
+    dy = clamp(dy, -m_rows, m_rows);
+    set_cursor(m_x + dx, m_y + dy);
+}
+
+//------------------------------------------------------------------------------
+void headless_screen_buffer::save_cursor()
+{
+    m_saved_x = m_x;
+    m_saved_y = m_y;
+}
+
+//------------------------------------------------------------------------------
+void headless_screen_buffer::restore_cursor()
+{
+    set_cursor(m_saved_x, m_saved_y);
+}
+
+//------------------------------------------------------------------------------
+void headless_screen_buffer::insert_chars(int count)
+{
+    if (count <= 0)
+        return;
+
+    count = min(count, m_columns - m_x);
+
+    line_cells& line = get_line(m_y);
+
+    // A wide character split by the insertion point, or by the right edge
+    // where cells fall off, loses both halves.
+    if (m_x > 0 && !line[m_x].ch)
+    {
+        set_cell(line, m_x - 1, ' ');
+        set_cell(line, m_x, ' ');
+    }
+    if (m_columns - count > 0 && !line[m_columns - count].ch)
+        set_cell(line, m_columns - count - 1, ' ');
+
+    for (int i = m_columns - 1; i >= m_x + count; --i)
+    {
+        const cell& from = line[i - count];
+        cell& to = line[i];
+        if (to.ch != from.ch || to.attr.get_key() != from.attr.get_key())
+        {
+            to = from;
+            m_cells_changed++;
+        }
+    }
+
+    for (int i = m_x; i < m_x + count; ++i)
+        set_cell(line, i, ' ');
+}
+
+//------------------------------------------------------------------------------
+void headless_screen_buffer::delete_chars(int count)
+{
+    if (count <= 0)
+        return;
+
+    count = min(count, m_columns - m_x);
+
+    line_cells& line = get_line(m_y);
+
+    // A wide character split by either end of the deleted cells loses both
+    // halves.
+    split_wide(line, m_x, m_x + count);
+
+    for (int i = m_x; i < m_columns - count; ++i)
+    {
+        const cell& from = line[i + count];
+        cell& to = line[i];
+        if (to.ch != from.ch || to.attr.get_key() != from.attr.get_key())
+        {
+            to = from;
+            m_cells_changed++;
+        }
+    }
+
+    for (int i = m_columns - count; i < m_columns; ++i)
+        set_cell(line, i, ' ');
+}
+
+//------------------------------------------------------------------------------
+void headless_screen_buffer::set_attributes(const attributes attr)
+{
+    m_attr = attributes::merge(m_attr, attr);
+}
+
+//------------------------------------------------------------------------------
+int headless_screen_buffer::is_line_default_color(int line) const
+{
+    if (line < 0 || line >= get_line_count())
+        return -1;
+
+    const unsigned long long key = attributes(attributes::defaults).get_key();
+    for (const cell& c : m_lines[line])
+        if (c.attr.get_key() != key)
+            return false;
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+int headless_screen_buffer::line_has_color(int line, const BYTE* attrs, int num_attrs, BYTE mask) const
+{
+    if (line < 0 || line >= get_line_count())
+        return -1;
+
+    const BYTE* end_attrs = attrs + num_attrs;
+    for (const cell& c : m_lines[line])
+    {
+        const BYTE attr = to_console_attr(c.attr);
+        for (const BYTE* find_attr = attrs; find_attr < end_attrs; find_attr++)
+            if ((attr & mask) == (*find_attr & mask))
+                return true;
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// Supplies the cells to find_line() the way ReadConsoleOutputW would.
+class headless_screen_buffer::line_source
+    : public find_line_source
+{
+public:
+                    line_source(const headless_screen_buffer& screen) : m_screen(screen) {}
+    virtual int     get_width() const override { return m_screen.m_columns; }
+    virtual int     get_height() const override { return m_screen.get_line_count(); }
+    virtual bool    read_rows(int first, int count, CHAR_INFO* cells) override;
+
+private:
+    const headless_screen_buffer& m_screen;
+};
+
+//------------------------------------------------------------------------------
+int headless_screen_buffer::find_line(int starting_line, int distance, const char* text, find_line_mode mode, const BYTE* attrs, int num_attrs, BYTE mask) const
+{
+    line_source source(*this);
+    return ::find_line(source, starting_line, distance, text, mode, attrs, num_attrs, mask);
+}
+
+//------------------------------------------------------------------------------
+bool headless_screen_buffer::line_source::read_rows(int first, int count, CHAR_INFO* cells)
+{
+    if (first < 0 || count < 0 || first + count > get_height())
+        return false;
+
+    for (int row = first; row < first + count; ++row)
+    {
+        const line_cells& line = m_screen.m_lines[row];
+        for (int i = 0; i < m_screen.m_columns; ++i, ++cells)
+        {
+            // A wide character's second cell is flagged, as the console does.
+            // Characters outside the BMP are split into surrogates across the
+            // two cells of a wide character.
+            char32_t c = line[i].ch;
+            WORD flags = 0;
+            if (!c)
+            {
+                const char32_t lead = (i > 0) ? line[i - 1].ch : 0;
+                if (lead > 0xffff)
+                    c = 0xdc00 + ((lead - 0x10000) & 0x3ff);
+                else
+                    flags = COMMON_LVB_TRAILING_BYTE;
+            }
+            else if (c > 0xffff)
+            {
+                c = 0xd800 + ((c - 0x10000) >> 10);
+            }
+
+            cells->Char.UnicodeChar = wchar_t(c);
+            cells->Attributes = WORD(to_console_attr(line[i].attr) | flags);
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+const headless_screen_buffer::cell* headless_screen_buffer::get_cell(int column, int line) const
+{
+    if (line < 0 || line >= get_line_count() || column < 0 || column >= m_columns)
+        return nullptr;
+
+    return &m_lines[line][column];
+}
+
+//------------------------------------------------------------------------------
+void headless_screen_buffer::put_char(char32_t c)
+{
+    const int width = clink_wcwidth(c);
+    if (width <= 0)
+        return;
+
+    // Deferred wrap:  writing in the last column leaves the cursor there, and
+    // the next printable character wraps to the next line.
+    if (m_pending_wrap)
+    {
+        line_feed();
+        m_x = 0;
+        m_pending_wrap = false;
+    }
+
+    // A wide character that doesn't fit wraps as a whole.
+    if (m_x + width > m_columns && m_x > 0)
+    {
+        fill(get_line(m_y), m_x, m_columns);
+        line_feed();
+        m_x = 0;
+    }
+
+    const int end = min(m_x + width, m_columns);
+
+    line_cells& line = get_line(m_y);
+    split_wide(line, m_x, end);
+    set_cell(line, m_x, c);
+    for (int i = m_x + 1; i < end; ++i)
+        set_cell(line, i, 0);
+
+    m_x = end;
+    if (m_x >= m_columns)
+    {
+        m_x = m_columns - 1;
+        m_pending_wrap = true;
+    }
+}
+
+//------------------------------------------------------------------------------
+void headless_screen_buffer::line_feed()
+{
+    if (m_y < m_rows - 1)
+    {
+        m_y++;
+        return;
+    }
+
+    const cell blank = { ' ', attributes::defaults };
+    m_lines.emplace_back(m_columns, blank);
+    if (get_line_count() > m_rows + m_scrollback)
+        m_lines.pop_front();
+    else
+        m_top++;
+}
+
+//------------------------------------------------------------------------------
+void headless_screen_buffer::set_cell(line_cells& line, int column, char32_t ch)
+{
+    cell& c = line[column];
+    if (c.ch != ch || c.attr.get_key() != m_attr.get_key())
+    {
+        c.ch = ch;
+        c.attr = m_attr;
+        m_cells_changed++;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Blanks the other half of any wide character that overwriting the cells from
+// begin to end would split.
+void headless_screen_buffer::split_wide(line_cells& line, int begin, int end)
+{
+    if (begin > 0 && begin < m_columns && !line[begin].ch)
+        set_cell(line, begin - 1, ' ');
+    if (end < m_columns && !line[end].ch)
+        set_cell(line, end, ' ');
+}
+
+//------------------------------------------------------------------------------
+void headless_screen_buffer::fill(line_cells& line, int begin, int end)
+{
+    begin = max(begin, 0);
+    end = min(end, m_columns);
+    if (begin >= end)
+        return;
+
+    split_wide(line, begin, end);
+    for (int i = begin; i < end; ++i)
+        set_cell(line, i, ' ');
+}
+
+//------------------------------------------------------------------------------
+// Maps attributes to a console attribute byte, the way win_screen_buffer does,
+// for the line_has_color() and find_line() queries.
+BYTE headless_screen_buffer::to_console_attr(const attributes attr)
+{
+    auto swizzle = [] (int rgbi) {
+        int b_r_ = ((rgbi & 0x01) << 2) | !!(rgbi & 0x04);
+        return (rgbi & 0x0a) | b_r_;
+    };
+
+    int fg = 0x07;
+    int bg = 0x00;
+
+    const auto attr_fg = attr.get_fg();
+    if (attr_fg && !attr_fg.is_default && !attr_fg->is_rgb)
+        fg = swizzle(attr_fg->value & 0x0f);
+
+    const auto attr_bg = attr.get_bg();
+    if (attr_bg && !attr_bg.is_default && !attr_bg->is_rgb)
+        bg = swizzle(attr_bg->value & 0x0f);
+
+    const auto bold = attr.get_bold();
+    if (bold && bold.value)
+        fg |= 0x08;
+
+    const auto reverse = attr.get_reverse();
+    if (reverse && reverse.value)
+    {
+        int t = fg;
+        fg = bg;
+        bg = t;
+    }
+
+    return BYTE(fg | (bg << 4));
+}
@@ -0,0 +1,108 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "keyseq_trie.h"
+
+#include <core/base.h>
+
+//------------------------------------------------------------------------------
+keyseq_trie::keyseq_trie()
+{
+    clear();
+}
+
+//------------------------------------------------------------------------------
+void keyseq_trie::clear()
+{
+    m_nodes.clear();
+    m_nodes.push_back({ 0, 0, -1, 0 });
+    memset(m_root, 0, sizeof(m_root));
+}
+
+//------------------------------------------------------------------------------
+// Adds a key sequence.  The first value added for a sequence wins.
+bool keyseq_trie::add(const char* seq, int value)
+{
+    if (!seq || !*seq || value < 0 || strlen(seq) >= max_seq)
+        return false;
+
+    unsigned int index = 0;
+    for (; *seq; ++seq)
+    {
+        unsigned int child = find_child(index, *seq);
+        if (!child)
+            child = add_child(index, *seq);
+        index = child;
+    }
+
+    if (m_nodes[index].value >= 0)
+        return false;
+
+    m_nodes[index].value = value;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool keyseq_trie::remove(const char* seq)
+{
+    if (!seq || !*seq)
+        return false;
+
+    unsigned int index = 0;
+    for (; *seq; ++seq)
+        if (!(index = find_child(index, *seq)))
+            return false;
+
+    if (m_nodes[index].value < 0)
+        return false;
+
+    m_nodes[index].value = -1;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Finds the longest key sequence that is a prefix of seq.  Returns its value
+// and sets len, or returns -1 if there is none.
+int keyseq_trie::lookup(const char* seq, int& len) const
+{
+    int value = -1;
+    unsigned int index = 0;
+    for (int i = 0; seq[i]; ++i)
+    {
+        if (!(index = find_child(index, seq[i])))
+            break;
+
+        if (m_nodes[index].value >= 0)
+        {
+            value = m_nodes[index].value;
+            len = i + 1;
+        }
+    }
+
+    return value;
+}
+
+//------------------------------------------------------------------------------
+unsigned int keyseq_trie::find_child(unsigned int parent, unsigned char c) const
+{
+    if (!parent)
+        return m_root[c];
+
+    for (unsigned int index = m_nodes[parent].child; index; index = m_nodes[index].sibling)
+        if (m_nodes[index].c == c)
+            return index;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+unsigned int keyseq_trie::add_child(unsigned int parent, unsigned char c)
+{
+    const unsigned int index = static_cast<unsigned int>(m_nodes.size());
+    m_nodes.push_back({ 0, m_nodes[parent].child, -1, c });
+    m_nodes[parent].child = index;
+    if (!parent)
+        m_root[c] = index;
+    return index;
+}
@@ -78,6 +78,18 @@ void printer::print(const char* attr, const char* data, int bytes)
     m_nodiff = true;
 }
 
+//------------------------------------------------------------------------------
+void printer::begin_frame()
+{
+    m_terminal.begin_frame();
+}
+
+//------------------------------------------------------------------------------
+void printer::end_frame()
+{
+    m_terminal.end_frame();
+}
+
 //------------------------------------------------------------------------------
 unsigned int printer::get_columns() const
 {
@@ -123,10 +135,8 @@ attributes printer::set_attributes(const attributes attr)
 }
 
 //------------------------------------------------------------------------------
-void printer::flush_attributes()
+void printer::build_sgr(const attributes diff, str_base& out)
 {
-    attributes diff = m_nodiff ? m_next_attr : attributes::diff(m_set_attr, m_next_attr);
-
     str<64, false> params;
     auto add_param = [&] (const char* x) {
         if (!params.empty())
@@ -175,13 +185,50 @@ void printer::flush_attributes()
     if (auto underline = diff.get_underline())
         add_param(underline.value ? "4" : "24");
 
+    out.clear();
     if (!params.empty())
+        out << "\x1b[" << params << "m";
+}
+
+//------------------------------------------------------------------------------
+const printer::sgr_cache_entry& printer::get_sgr(const attributes from, const attributes to)
+{
+    // Valid attributes never have all bits set, so that can stand for "no
+    // diff" without colliding with a real transition.
+    const unsigned long long from_key = m_nodiff ? ~0ull : from.get_key();
+    const unsigned long long to_key = to.get_key();
+
+    // Syntax coloring uses only a handful of distinct transitions, so a small
+    // table with round robin replacement is enough, and comparing keys is much
+    // cheaper than formatting.
+    for (const auto& entry : m_sgr_cache)
     {
-        m_terminal.write("\x1b[");
-        m_terminal.write(params.c_str(), params.length());
-        m_terminal.write("m");
+        if (entry.valid && entry.from == from_key && entry.to == to_key)
+            return entry;
     }
 
+    m_sgr_cache_misses++;
+    sgr_cache_entry& entry = m_sgr_cache[m_sgr_cache_next];
+    m_sgr_cache_next = (m_sgr_cache_next + 1) % sgr_cache_size;
+
+    str<32, false> sgr;
+    build_sgr(m_nodiff ? to : attributes::diff(from, to), sgr);
+
+    entry.from = from_key;
+    entry.to = to_key;
+    entry.length = static_cast<unsigned char>(sgr.length());
+    entry.valid = true;
+    memcpy(entry.sgr, sgr.c_str(), sgr.length() + 1);
+    return entry;
+}
+
+//------------------------------------------------------------------------------
+void printer::flush_attributes()
+{
+    const sgr_cache_entry& entry = get_sgr(m_set_attr, m_next_attr);
+    if (entry.length)
+        m_terminal.write(entry.sgr, entry.length);
+
     m_set_attr = m_next_attr;
 }
 
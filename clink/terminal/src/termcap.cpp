@@ -141,6 +141,7 @@ char* tgetstr(const char* name, char** out)
     case 'le': str = "\x08"; break;
     case 'nd': str = CSI(C); break;
     case 'up': str = CSI(A); break;
+    case 'UP': str = CSI(%dA); break;
 
     // Cursor style
     case 've': str = CSI(?12l) CSI(?25h); break;
@@ -62,11 +62,16 @@
 #include <pch.h>
 #include <wchar.h>
 
+#include <memory>
+#include <vector>
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
 
 static int resolve_ambiguous_wcwidth(char32_t ucs);
+int mk_wcwidth(char32_t ucs);
+int mk_wcwidth_cjk(char32_t ucs);
 
 struct interval {
   char32_t first;
@@ -175,9 +180,30 @@ static const struct interval combining[] = {
  *
  * This implementation assumes that wchar_t characters are encoded
  * in ISO 10646.
+ *
+ * mk_wcwidth_reference() is the original binary search implementation.  It
+ * is the source from which the width page table is generated (see
+ * mk_wcwidth() below), and is kept for verifying the table.
  */
 
-int mk_wcwidth(char32_t ucs)
+static int is_wide(char32_t ucs)
+{
+  return (ucs >= 0x1100 &&
+     (ucs <= 0x115f ||                    /* Hangul Jamo init. consonants */
+      ucs == 0x2329 || ucs == 0x232a ||
+      (ucs >= 0x2e80 && ucs <= 0xa4cf &&
+       ucs != 0x303f) ||                  /* CJK ... Yi */
+      (ucs >= 0xac00 && ucs <= 0xd7a3) || /* Hangul Syllables */
+      (ucs >= 0xf900 && ucs <= 0xfaff) || /* CJK Compatibility Ideographs */
+      (ucs >= 0xfe10 && ucs <= 0xfe19) || /* Vertical forms */
+      (ucs >= 0xfe30 && ucs <= 0xfe6f) || /* CJK Compatibility Forms */
+      (ucs >= 0xff00 && ucs <= 0xff60) || /* Fullwidth Forms */
+      (ucs >= 0xffe0 && ucs <= 0xffe6) ||
+      (ucs >= 0x20000 && ucs <= 0x2fffd) ||
+      (ucs >= 0x30000 && ucs <= 0x3fffd)));
+}
+
+int mk_wcwidth_reference(char32_t ucs)
 {
   /* sorted list of non-overlapping intervals of non-spacing characters */
   /* generated by "uniset +cat=Me +cat=Mn +cat=Cf -00AD +1160-11FF +200B c" */
@@ -194,20 +220,7 @@ int mk_wcwidth(char32_t ucs)
 
   /* if we arrive here, ucs is not a combining or C0/C1 control character */
 
-  return 1 + 
-    (ucs >= 0x1100 &&
-     (ucs <= 0x115f ||                    /* Hangul Jamo init. consonants */
-      ucs == 0x2329 || ucs == 0x232a ||
-      (ucs >= 0x2e80 && ucs <= 0xa4cf &&
-       ucs != 0x303f) ||                  /* CJK ... Yi */
-      (ucs >= 0xac00 && ucs <= 0xd7a3) || /* Hangul Syllables */
-      (ucs >= 0xf900 && ucs <= 0xfaff) || /* CJK Compatibility Ideographs */
-      (ucs >= 0xfe10 && ucs <= 0xfe19) || /* Vertical forms */
-      (ucs >= 0xfe30 && ucs <= 0xfe6f) || /* CJK Compatibility Forms */
-      (ucs >= 0xff00 && ucs <= 0xff60) || /* Fullwidth Forms */
-      (ucs >= 0xffe0 && ucs <= 0xffe6) ||
-      (ucs >= 0x20000 && ucs <= 0x2fffd) ||
-      (ucs >= 0x30000 && ucs <= 0x3fffd)));
+  return 1 + is_wide(ucs);
 }
 
 
@@ -291,14 +304,155 @@ static const struct interval ambiguous[] = {
  * the traditional terminal character-width behaviour. It is not
  * otherwise recommended for general use.
  */
-int mk_wcwidth_cjk(char32_t ucs)
+int mk_wcwidth_cjk_reference(char32_t ucs)
 {
   /* binary search in table of non-spacing characters */
   if (bisearch(ucs, ambiguous,
 	       sizeof(ambiguous) / sizeof(struct interval) - 1))
     return resolve_ambiguous_wcwidth(ucs);
 
-  return mk_wcwidth(ucs);
+  return mk_wcwidth_reference(ucs);
+}
+
+
+
+//------------------------------------------------------------------------------
+// Two-level width table, generated from the interval tables above the first
+// time a width is requested.  The high bits of a codepoint select a page, and
+// each page packs a 2-bit width class per codepoint.  Pages whose codepoints
+// all share one class point at a shared uniform page, so only pages that
+// actually mix widths take up space.
+enum
+{
+  wc_zero,          // Width 0 (combining, etc).
+  wc_one,           // Width 1.
+  wc_two,           // Width 2.
+  wc_ambiguous,     // East Asian Ambiguous; width 1 unless resolved otherwise.
+};
+
+enum
+{
+  wc_page_bits      = 8,
+  wc_page_size      = 1 << wc_page_bits,
+  wc_page_mask      = wc_page_size - 1,
+  wc_max_ucs        = 0x10ffff,
+  wc_num_pages      = (wc_max_ucs + 1) >> wc_page_bits,
+};
+
+struct width_page
+{
+  unsigned char bits[wc_page_size / 4];
+};
+
+struct width_table
+{
+  unsigned short index[wc_num_pages];
+  std::vector<width_page> pages;
+};
+
+static void build_width_table(width_table& table)
+{
+  static const size_t num_combining = sizeof(combining) / sizeof(struct interval);
+  static const size_t num_ambiguous = sizeof(ambiguous) / sizeof(struct interval);
+
+  // The first four pages are uniform pages, one per width class.
+  table.pages.resize(4);
+  for (int i = 0; i < 4; ++i)
+    memset(table.pages[i].bits, i * 0x55, sizeof(table.pages[i].bits));
+
+  // Walk the sorted interval tables in step with the codepoints, which avoids
+  // a binary search per codepoint.
+  size_t ic = 0;
+  size_t ia = 0;
+  char32_t ucs = 0;
+  for (unsigned int p = 0; p < wc_num_pages; ++p)
+  {
+    width_page page;
+    unsigned char first = 0;
+    bool uniform = true;
+
+    for (unsigned int i = 0; i < wc_page_size; ++i, ++ucs)
+    {
+      while (ic < num_combining && combining[ic].last < ucs)
+        ++ic;
+      while (ia < num_ambiguous && ambiguous[ia].last < ucs)
+        ++ia;
+
+      unsigned char c;
+      if (ia < num_ambiguous && ambiguous[ia].first <= ucs)
+        c = wc_ambiguous;
+      else if (ic < num_combining && combining[ic].first <= ucs)
+        c = wc_zero;
+      else if (is_wide(ucs))
+        c = wc_two;
+      else
+        c = wc_one;
+
+      // C0/C1 controls and NUL are handled before the table is consulted.
+
+      if (!i)
+        first = c;
+      else if (c != first)
+        uniform = false;
+
+      if (!(i & 3))
+        page.bits[i >> 2] = 0;
+      page.bits[i >> 2] |= c << ((i & 3) * 2);
+    }
+
+    if (uniform)
+    {
+      table.index[p] = first;
+      continue;
+    }
+
+    table.index[p] = (unsigned short)table.pages.size();
+    table.pages.push_back(page);
+  }
+
+  table.pages.shrink_to_fit();
+}
+
+static const width_table& get_width_table()
+{
+  static std::unique_ptr<width_table> s_table = []() {
+    std::unique_ptr<width_table> table = std::unique_ptr<width_table>(new width_table);
+    build_width_table(*table);
+    return table;
+  }();
+  return *s_table;
+}
+
+static int lookup_width_class(char32_t ucs)
+{
+  const width_table& table = get_width_table();
+  const width_page& page = table.pages[table.index[ucs >> wc_page_bits]];
+  const unsigned int i = ucs & wc_page_mask;
+  return (page.bits[i >> 2] >> ((i & 3) * 2)) & 3;
+}
+
+int mk_wcwidth(char32_t ucs)
+{
+  if (ucs < 0xa0)
+  {
+    if (ucs >= 0x20 && ucs < 0x7f)
+      return 1;
+    return ucs ? -1 : 0;
+  }
+  if (ucs > wc_max_ucs)
+    return 1;
+
+  int c = lookup_width_class(ucs);
+  return (c == wc_ambiguous) ? 1 : c;
+}
+
+int mk_wcwidth_cjk(char32_t ucs)
+{
+  if (ucs < 0xa0 || ucs > wc_max_ucs)
+    return mk_wcwidth(ucs);
+
+  int c = lookup_width_class(ucs);
+  return (c == wc_ambiguous) ? resolve_ambiguous_wcwidth(ucs) : c;
 }
 
 
@@ -329,7 +483,6 @@ wcswidth_t *wcswidth = mk_wcswidth;
 #endif
 
 #include <core/settings.h>
-#include <map>
 
 enum { EAA_font, EAA_one, EAA_two, EAA_auto };
 
@@ -352,7 +505,10 @@ static setting_enum g_terminal_east_asian_ambiguous(
 
 static HDC s_hdc = NULL;
 static HFONT s_hfont = NULL;
-static std::map<char32_t, int> s_map_ambiguous;
+// Flat cache of resolved ambiguous widths, allocated a page at a time so that
+// only pages containing ambiguous codepoints that were actually measured take
+// up space.  A zero entry means unresolved, otherwise the entry is width + 1.
+static std::unique_ptr<unsigned char[]> s_ambiguous_cache[wc_num_pages];
 static int s_cell = 0;
 static int s_resolve = EAA_auto;
 
@@ -384,14 +540,18 @@ static int resolve_ambiguous_wcwidth(char32_t ucs)
   case EAA_auto:
   case EAA_font:
     {
-      auto i = s_map_ambiguous.find(ucs);
-      if (i != s_map_ambiguous.end())
-        return i->second;
+      std::unique_ptr<unsigned char[]>& page = s_ambiguous_cache[ucs >> wc_page_bits];
+      if (!page)
+        page = std::unique_ptr<unsigned char[]>(new unsigned char[wc_page_size]());
+
+      unsigned char& entry = page[ucs & wc_page_mask];
+      if (entry)
+        return entry - 1;
 
       int width = get_wcwidth_from_font(ucs);
       if (width < 0)
         width = 2;
-      s_map_ambiguous[ucs] = width;
+      entry = (unsigned char)(width + 1);
       return width;
     }
     break;
@@ -438,7 +598,8 @@ static void init_cached_font()
 
 void reset_wcwidths()
 {
-  s_map_ambiguous.clear();
+  for (auto& page : s_ambiguous_cache)
+    page.reset();
   reset_cached_font();
 
   bool use_cjk = true;
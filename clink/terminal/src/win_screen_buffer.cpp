@@ -39,6 +39,12 @@ ansi_handler get_current_ansi_handler()
     return s_current_ansi_handler;
 }
 
+//------------------------------------------------------------------------------
+// The palette is read again the first time a color is mapped after begin(), so
+// the console isn't queried for every color.
+static cie::palette_lut s_palette_lut;
+static bool s_palette_stale = true;
+
 //------------------------------------------------------------------------------
 static const char* s_conemu_dll = nullptr;
 bool is_conemu()
@@ -95,6 +101,12 @@ static setting_enum g_terminal_emulation(
     "native,emulate,auto",
     2);
 
+//------------------------------------------------------------------------------
+win_screen_buffer::win_screen_buffer()
+: m_frame(*this)
+{
+}
+
 //------------------------------------------------------------------------------
 win_screen_buffer::~win_screen_buffer()
 {
@@ -116,6 +128,8 @@ void win_screen_buffer::begin()
     if (!m_handle)
         open();
 
+    s_palette_stale = true;
+
     m_ready++;
     if (m_ready > 1)
         return;
@@ -242,6 +256,7 @@ void win_screen_buffer::end()
         m_ready--;
         if (!m_ready)
         {
+            m_frame.flush();
             SetConsoleTextAttribute(m_handle, m_default_attr);
             SetConsoleMode(m_handle, m_prev_mode);
         }
@@ -251,18 +266,37 @@ void win_screen_buffer::end()
 //------------------------------------------------------------------------------
 void win_screen_buffer::close()
 {
+    m_frame.flush();
     m_handle = nullptr;
 }
 
+//------------------------------------------------------------------------------
+void win_screen_buffer::begin_frame()
+{
+    m_frame.begin_frame();
+}
+
+//------------------------------------------------------------------------------
+void win_screen_buffer::end_frame()
+{
+    m_frame.end_frame();
+}
+
 //------------------------------------------------------------------------------
 void win_screen_buffer::write(const char* data, int length)
 {
     assert(m_ready);
 
+    m_frame.write(data, length);
+}
+
+//------------------------------------------------------------------------------
+void win_screen_buffer::emit(const char* data, int length)
+{
     str_iter iter(data, length);
     while (length > 0)
     {
-        wchar_t wbuf[384];
+        wchar_t wbuf[frame_buffer::default_capacity + 1];
         int n = min<int>(sizeof_array(wbuf), length + 1);
         n = to_utf16(wbuf, n, iter);
         if (!n && !*iter.get_pointer())
@@ -291,6 +325,8 @@ void win_screen_buffer::write(const char* data, int length)
 //------------------------------------------------------------------------------
 void win_screen_buffer::flush()
 {
+    m_frame.flush();
+
     // When writing to the console conhost.exe will restart the cursor blink
     // timer and hide it which can be disorientating, especially when moving
     // around a line. The below will make sure it stays visible.
@@ -318,6 +354,7 @@ int win_screen_buffer::get_rows() const
 //------------------------------------------------------------------------------
 bool win_screen_buffer::get_line_text(int line, str_base& out) const
 {
+    m_frame.flush();
     CONSOLE_SCREEN_BUFFER_INFO csbi;
     if (!GetConsoleScreenBufferInfo(m_handle, &csbi))
         return false;
@@ -350,6 +387,7 @@ bool win_screen_buffer::has_native_vt_processing() const
 //------------------------------------------------------------------------------
 void win_screen_buffer::clear(clear_type type)
 {
+    m_frame.flush();
     CONSOLE_SCREEN_BUFFER_INFO csbi;
     GetConsoleScreenBufferInfo(m_handle, &csbi);
 
@@ -389,6 +427,7 @@ void win_screen_buffer::clear(clear_type type)
 //------------------------------------------------------------------------------
 void win_screen_buffer::clear_line(clear_type type)
 {
+    m_frame.flush();
     CONSOLE_SCREEN_BUFFER_INFO csbi;
     GetConsoleScreenBufferInfo(m_handle, &csbi);
 
@@ -420,6 +459,7 @@ void win_screen_buffer::clear_line(clear_type type)
 //------------------------------------------------------------------------------
 void win_screen_buffer::set_horiz_cursor(int column)
 {
+    m_frame.flush();
     CONSOLE_SCREEN_BUFFER_INFO csbi;
     GetConsoleScreenBufferInfo(m_handle, &csbi);
 
@@ -436,6 +476,7 @@ void win_screen_buffer::set_horiz_cursor(int column)
 //------------------------------------------------------------------------------
 void win_screen_buffer::set_cursor(int column, int row)
 {
+    m_frame.flush();
     CONSOLE_SCREEN_BUFFER_INFO csbi;
     GetConsoleScreenBufferInfo(m_handle, &csbi);
 
@@ -453,6 +494,7 @@ void win_screen_buffer::set_cursor(int column, int row)
 //------------------------------------------------------------------------------
 void win_screen_buffer::move_cursor(int dx, int dy)
 {
+    m_frame.flush();
     CONSOLE_SCREEN_BUFFER_INFO csbi;
     GetConsoleScreenBufferInfo(m_handle, &csbi);
 
@@ -466,6 +508,7 @@ void win_screen_buffer::move_cursor(int dx, int dy)
 //------------------------------------------------------------------------------
 void win_screen_buffer::save_cursor()
 {
+    m_frame.flush();
     CONSOLE_SCREEN_BUFFER_INFO csbi;
     GetConsoleScreenBufferInfo(m_handle, &csbi);
 
@@ -488,6 +531,7 @@ void win_screen_buffer::restore_cursor()
 //------------------------------------------------------------------------------
 void win_screen_buffer::insert_chars(int count)
 {
+    m_frame.flush();
     if (count <= 0)
         return;
 
@@ -511,6 +555,7 @@ void win_screen_buffer::insert_chars(int count)
 //------------------------------------------------------------------------------
 void win_screen_buffer::delete_chars(int count)
 {
+    m_frame.flush();
     if (count <= 0)
         return;
 
@@ -545,6 +590,7 @@ void win_screen_buffer::delete_chars(int count)
 //------------------------------------------------------------------------------
 void win_screen_buffer::set_attributes(attributes attr)
 {
+    m_frame.flush();
     CONSOLE_SCREEN_BUFFER_INFO csbi;
     GetConsoleScreenBufferInfo(m_handle, &csbi);
 
@@ -635,34 +681,26 @@ void win_screen_buffer::set_attributes(attributes attr)
 }
 
 //------------------------------------------------------------------------------
-static bool get_nearest_color(void* handle, const unsigned char (&rgb)[3], unsigned char& attr)
+static bool get_nearest_color(void* handle, const attributes::color& color, unsigned char& attr)
 {
-    static HMODULE hmod = GetModuleHandle("kernel32.dll");
-    static FARPROC proc = GetProcAddress(hmod, "GetConsoleScreenBufferInfoEx");
-    typedef BOOL (WINAPI* GCSBIEx)(HANDLE, PCONSOLE_SCREEN_BUFFER_INFOEX);
-
-    if (!proc)
-        return false;
+    if (s_palette_stale || !s_palette_lut.has_palette())
+    {
+        static HMODULE hmod = GetModuleHandle("kernel32.dll");
+        static FARPROC proc = GetProcAddress(hmod, "GetConsoleScreenBufferInfoEx");
+        typedef BOOL (WINAPI* GCSBIEx)(HANDLE, PCONSOLE_SCREEN_BUFFER_INFOEX);
 
-    CONSOLE_SCREEN_BUFFER_INFOEX infoex = { sizeof(infoex) };
-    if (!GCSBIEx(proc)(handle, &infoex))
-        return false;
+        if (!proc)
+            return false;
 
-    cie::lab target(RGB(rgb[0], rgb[1], rgb[2]));
-    float best_deltaE = 0;
-    int best_idx = -1;
+        CONSOLE_SCREEN_BUFFER_INFOEX infoex = { sizeof(infoex) };
+        if (!GCSBIEx(proc)(handle, &infoex))
+            return false;
 
-    for (int i = sizeof_array(infoex.ColorTable); i--;)
-    {
-        cie::lab candidate(infoex.ColorTable[i]);
-        float deltaE = cie::deltaE(target, candidate);
-        if (best_idx < 0 || best_deltaE > deltaE)
-        {
-            best_deltaE = deltaE;
-            best_idx = i;
-        }
+        s_palette_lut.set_palette(infoex.ColorTable);
+        s_palette_stale = false;
     }
 
+    const int best_idx = s_palette_lut.lookup(color.r, color.g, color.b);
     if (best_idx < 0)
         return false;
 
@@ -679,18 +717,14 @@ bool win_screen_buffer::get_nearest_color(attributes& attr) const
     if (fg.is_rgb)
     {
         unsigned char val;
-        unsigned char rgb[3];
-        fg.as_888(rgb);
-        if (!::get_nearest_color(m_handle, rgb, val))
+        if (!::get_nearest_color(m_handle, fg, val))
             return false;
         attr.set_fg(val);
     }
     if (bg.is_rgb)
     {
         unsigned char val;
-        unsigned char rgb[3];
-        bg.as_888(rgb);
-        if (!::get_nearest_color(m_handle, rgb, val))
+        if (!::get_nearest_color(m_handle, bg, val))
             return false;
         attr.set_bg(val);
     }
@@ -700,6 +734,7 @@ bool win_screen_buffer::get_nearest_color(attributes& attr) const
 //------------------------------------------------------------------------------
 int win_screen_buffer::is_line_default_color(int line) const
 {
+    m_frame.flush();
     CONSOLE_SCREEN_BUFFER_INFO csbi;
     if (!GetConsoleScreenBufferInfo(m_handle, &csbi))
         return -1;
@@ -725,6 +760,7 @@ int win_screen_buffer::is_line_default_color(int line) const
 //------------------------------------------------------------------------------
 int win_screen_buffer::line_has_color(int line, const BYTE* attrs, int num_attrs, BYTE mask) const
 {
+    m_frame.flush();
     CONSOLE_SCREEN_BUFFER_INFO csbi;
     if (!GetConsoleScreenBufferInfo(m_handle, &csbi))
         return -1;
@@ -754,18 +790,12 @@ int win_screen_buffer::line_has_color(int line, const BYTE* attrs, int num_attrs
 //------------------------------------------------------------------------------
 int win_screen_buffer::find_line(int starting_line, int distance, const char* text, find_line_mode mode, const BYTE* attrs, int num_attrs, BYTE mask) const
 {
+    m_frame.flush();
     CONSOLE_SCREEN_BUFFER_INFO csbi;
     if (!GetConsoleScreenBufferInfo(m_handle, &csbi))
         return -2;
 
-    if (text && !ensure_chars_buffer(csbi.dwSize.X))
-        return -2;
-    if (attrs && num_attrs > 0 && !ensure_attrs_buffer(csbi.dwSize.X))
-        return -2;
-
     return ::find_line(m_handle, csbi,
-                       m_chars, m_chars_capacity,
-                       m_attrs, m_attrs_capacity,
                        starting_line, distance,
                        text, mode,
                        attrs, num_attrs, mask);
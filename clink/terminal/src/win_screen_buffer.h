@@ -4,6 +4,7 @@
 #pragma once
 
 #include "screen_buffer.h"
+#include "frame_buffer.h"
 
 class str_base;
 enum find_line_mode : int;
@@ -11,13 +12,17 @@ enum find_line_mode : int;
 //------------------------------------------------------------------------------
 class win_screen_buffer
     : public screen_buffer
+    , public frame_sink
 {
 public:
+                    win_screen_buffer();
     virtual         ~win_screen_buffer() override;
     virtual void    open() override;
     virtual void    begin() override;
     virtual void    end() override;
     virtual void    close() override;
+    virtual void    begin_frame() override;
+    virtual void    end_frame() override;
     virtual void    write(const char* data, int length) override;
     virtual void    flush() override;
     virtual int     get_columns() const override;
@@ -40,6 +45,7 @@ public:
     virtual int     find_line(int starting_line, int distance, const char* text, find_line_mode mode, const BYTE* attrs=nullptr, int num_attrs=0, BYTE mask=0xff) const override;
 
 private:
+    virtual void    emit(const char* data, int length) override;
     bool            ensure_chars_buffer(int width) const;
     bool            ensure_attrs_buffer(int width) const;
 
@@ -66,4 +72,8 @@ private:
     mutable SHORT   m_chars_capacity = 0;
 
     COORD           m_saved_cursor = {};
+
+    // Console API calls other than writing text must flush the frame first,
+    // so the text reaches the console in order with them.
+    mutable frame_buffer m_frame;
 };
@@ -6,6 +6,7 @@
 #include "scroll.h"
 #include "input_idle.h"
 #include "key_tester.h"
+#include "keyseq_trie.h"
 
 #include <core/base.h>
 #include <core/str.h>
@@ -13,7 +14,7 @@
 #include <core/settings.h>
 
 #include <assert.h>
-#include <map>
+#include <vector>
 
 //------------------------------------------------------------------------------
 setting_bool g_terminal_raw_esc(
@@ -218,61 +219,8 @@ struct keyseq_name : public no_copy
     short int o;
 };
 
-//------------------------------------------------------------------------------
-struct keyseq_key : public no_copy
-{
-    keyseq_key(const char* p, bool find = false) { this->s = p; this->find = find; }
-    keyseq_key(keyseq_key&& a) { s = a.s; find = a.find; a.s = nullptr; }
-    keyseq_key& operator=(keyseq_key&& a) { s = a.s; find = a.find; a.s = nullptr; return *this; }
-
-    const char* s;
-    bool find;
-};
-
-//------------------------------------------------------------------------------
-struct map_cmp_str
-{
-    bool operator()(keyseq_key const& a, keyseq_key const& b) const
-    {
-        if (a.find)
-        {
-            assert(!b.find);
-            const char* bs = b.s;
-            for (const char* as = a.s; *as; as++, bs++)
-            {
-                int cmp = int((unsigned char)*as) - int((unsigned char)*bs);
-                if (cmp)
-                    return cmp < 0;
-            }
-        }
-        else if (b.find)
-        {
-            assert(!a.find);
-            const char* as = a.s;
-            for (const char* bs = b.s; *bs; as++, bs++)
-            {
-                int cmp = int((unsigned char)*as) - int((unsigned char)*bs);
-                if (cmp)
-                    return cmp < 0;
-            }
-        }
-        else
-        {
-            const char* as = a.s;
-            const char* bs = b.s;
-            while (true)
-            {
-                int cmp = int((unsigned char)*as) - int((unsigned char)*bs);
-                if (cmp || !*as)
-                    return cmp < 0;
-                as++;
-                bs++;
-            }
-        }
-        return false;
-    }
-};
-static std::map<keyseq_key, keyseq_name, map_cmp_str> map_keyseq_to_name;
+static std::vector<keyseq_name> s_keyseq_names;
+static keyseq_trie s_keyseq_trie;
 static char map_keyseq_differentiate = -1;
 static int map_default_bindings = -1;
 
@@ -286,12 +234,12 @@ static void add_keyseq_to_name(const char* keyseq, const char* name, str<32>& bu
     builder.concat(name);
 
     int alloc = builder.length() + 1;
-    keyseq_name second((char*)malloc(alloc), modifier, (short int)map_keyseq_to_name.size());
-    if (second.s)
+    keyseq_name entry((char*)malloc(alloc), modifier, (short int)s_keyseq_names.size());
+    if (entry.s)
     {
-        memcpy(second.s, builder.c_str(), alloc);
-        keyseq_key first(keyseq);
-        map_keyseq_to_name.emplace(std::move(first), std::move(second));
+        memcpy(entry.s, builder.c_str(), alloc);
+        if (s_keyseq_trie.add(keyseq, int(s_keyseq_names.size())))
+            s_keyseq_names.emplace_back(std::move(entry));
     }
 
     builder.truncate(old_len);
@@ -303,14 +251,13 @@ static void remove_keyseq_from_name(const char* keyseq)
     if (!keyseq || !*keyseq)
         return;
 
-    keyseq_key first(keyseq);
-    map_keyseq_to_name.erase(first);
+    s_keyseq_trie.remove(keyseq);
 }
 
 //------------------------------------------------------------------------------
 static void ensure_keyseqs_to_names()
 {
-    if (!map_keyseq_to_name.empty() &&
+    if (!s_keyseq_trie.empty() &&
         map_keyseq_differentiate == !!g_differentiate_keys.get() &&
         map_default_bindings == g_default_bindings.get())
         return;
@@ -320,6 +267,9 @@ static void ensure_keyseqs_to_names()
 
     str<32> builder;
 
+    s_keyseq_trie.clear();
+    s_keyseq_names.clear();
+
     map_keyseq_differentiate = !!g_differentiate_keys.get();
     map_default_bindings = g_default_bindings.get();
 
@@ -378,7 +328,8 @@ void reset_keyseq_to_name_map()
 {
     // Settings can affect key sequence processing, so being able to reset the
     // map enables show_rl_help to show accurate key names.
-    map_keyseq_to_name.clear();
+    s_keyseq_trie.clear();
+    s_keyseq_names.clear();
 }
 
 //------------------------------------------------------------------------------
@@ -409,14 +360,15 @@ const char* find_key_name(const char* keyseq, int& len, int& eqclass, int& order
 
     // Look up the sequence in the special key names map.
     ensure_keyseqs_to_names();
-    keyseq_key lookup(keyseq, true/*find*/);
-    auto const& iter = map_keyseq_to_name.find(lookup);
-    if (iter != map_keyseq_to_name.end())
+    int found_len = 0;
+    const int index = s_keyseq_trie.lookup(keyseq, found_len);
+    if (index >= 0)
     {
-        len = (int)strlen(iter->first.s);
-        eqclass = iter->second.eq;
-        order = iter->second.o - (int)map_keyseq_to_name.size();
-        return iter->second.s;
+        const keyseq_name& name = s_keyseq_names[index];
+        len = found_len;
+        eqclass = name.eq;
+        order = name.o - (int)s_keyseq_names.size();
+        return name.s;
     }
 
     // Try to deduce the name if it's an extended XTerm key sequence.
@@ -167,14 +167,7 @@ int win_terminal_out::find_line(int starting_line, int distance, const char* tex
     if (!GetConsoleScreenBufferInfo(m_stdout, &csbi))
         return -2;
 
-    if (text && !ensure_chars_buffer(csbi.dwSize.X))
-        return -2;
-    if (attrs && num_attrs > 0 && !ensure_attrs_buffer(csbi.dwSize.X))
-        return -2;
-
     return ::find_line(m_stdout, csbi,
-                       m_chars, m_chars_capacity,
-                       m_attrs, m_attrs_capacity,
                        starting_line, distance,
                        text, mode,
                        attrs, num_attrs, mask);
@@ -0,0 +1,85 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <terminal/cielab.h>
+
+//------------------------------------------------------------------------------
+// The default Windows 10 console palette, in console order.
+static const COLORREF c_campbell[cie::palette_lut::palette_size] =
+{
+    RGB( 12,  12,  12), RGB(  0,  55, 218), RGB( 19, 161,  14), RGB( 58, 150, 221),
+    RGB(197,  15,  31), RGB(136,  23, 152), RGB(193, 156,   0), RGB(204, 204, 204),
+    RGB(118, 118, 118), RGB( 59, 120, 255), RGB( 22, 198,  12), RGB( 97, 214, 214),
+    RGB(231,  72,  86), RGB(180,   0, 158), RGB(249, 241, 165), RGB(242, 242, 242),
+};
+
+//------------------------------------------------------------------------------
+static int search(const cie::lab (&labs)[cie::palette_lut::palette_size], COLORREF c)
+{
+    const cie::lab target(c);
+    float best_deltaE = 0;
+    int best_idx = -1;
+    for (int i = cie::palette_lut::palette_size; i--;)
+    {
+        const float deltaE = cie::deltaE(target, labs[i]);
+        if (best_idx < 0 || best_deltaE > deltaE)
+        {
+            best_deltaE = deltaE;
+            best_idx = i;
+        }
+    }
+    return best_idx;
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Palette lookup")
+{
+    cie::palette_lut lut;
+    REQUIRE(!lut.has_palette());
+    REQUIRE(lut.lookup(0, 0, 0) < 0);
+
+    REQUIRE(lut.set_palette(c_campbell));
+    REQUIRE(!lut.set_palette(c_campbell));
+    REQUIRE(lut.has_palette());
+
+    cie::lab labs[cie::palette_lut::palette_size];
+    for (int i = 0; i < cie::palette_lut::palette_size; ++i)
+        labs[i].from_rgb(c_campbell[i]);
+
+    SECTION("Palette colors")
+    {
+        REQUIRE(lut.find_nearest(c_campbell[4]) == 4);
+        REQUIRE(lut.find_nearest(c_campbell[11]) == 11);
+        REQUIRE(lut.lookup(0x1f, 0x1f, 0x1f) == 15);
+        REQUIRE(lut.lookup(0, 0, 0) == 0);
+    }
+
+    SECTION("Matches exact search")
+    {
+        // Every 5 bit per channel color; twice, so the second pass reads the
+        // cached entries.
+        for (int pass = 0; pass < 2; ++pass)
+            for (int r = 0; r < 32; ++r)
+                for (int g = 0; g < 32; ++g)
+                    for (int b = 0; b < 32; ++b)
+                    {
+                        const COLORREF c = RGB((r << 3) | (r & 7), (g << 3) | (g & 7), (b << 3) | (b & 7));
+                        REQUIRE(lut.lookup(r, g, b) == search(labs, c));
+                    }
+    }
+
+    SECTION("Palette change")
+    {
+        REQUIRE(lut.lookup(0x18, 0x03, 0x03) == 4);
+
+        COLORREF palette[cie::palette_lut::palette_size];
+        memcpy(palette, c_campbell, sizeof(palette));
+        palette[4] = RGB(0, 0, 0);
+        palette[12] = RGB(0, 0, 0);
+        REQUIRE(lut.set_palette(palette));
+        REQUIRE(lut.lookup(0x18, 0x03, 0x03) != 4);
+        REQUIRE(lut.lookup(0x18, 0x03, 0x03) == lut.find_nearest(RGB(0xc3, 0x1b, 0x1b)));
+    }
+}
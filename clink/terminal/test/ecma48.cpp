@@ -4,12 +4,33 @@
 #include "pch.h"
 
 #include <core/base.h>
+#include <core/os.h>
 #include <terminal/ecma48_iter.h>
 
 #include <new>
+#include <string>
+
+extern bool g_show_benchmarks;
 
 static ecma48_state g_state;
 
+//------------------------------------------------------------------------------
+// Builds long lines of text with an occasional escape code, and returns the
+// number of lines.
+static unsigned int make_mostly_plain(std::string& input, size_t size)
+{
+    unsigned int lines = 0;
+    while (input.size() < size)
+    {
+        if ((lines++ % 8) == 0)
+            input.append("\x1b[1m");
+        for (int i = 0; i < 16; ++i)
+            input.append("The quick brown fox jumps over the lazy dog \xe2\x94\x80 ");
+        input.append("\x1b[m\n");
+    }
+    return lines;
+}
+
 //------------------------------------------------------------------------------
 TEST_CASE("ecma48 chars")
 {
@@ -446,3 +467,128 @@ TEST_CASE("ecma48 osc envvar")
         REQUIRE(code->get_length() == 2);
     }
 }
+
+//------------------------------------------------------------------------------
+TEST_CASE("ecma48 plain text")
+{
+    const ecma48_code* code;
+
+    SECTION("Runs")
+    {
+        // Vary the run length so the stop byte lands at every offset within
+        // the blocks the iterator scans.
+        static const char* const c_stops[] = { "\n", "\x1b[m", "\xc0\x8a" };
+        for (const char* stop : c_stops)
+        {
+            for (int n = 0; n < 40; ++n)
+            {
+                str<> s;
+                for (int i = 0; i < n; ++i)
+                    s.concat(i == 7 ? "\xe2\x94\x80" : "x");
+                const unsigned int run = s.length();
+                s.concat(stop);
+                s.concat("abc");
+
+                ecma48_iter iter(s.c_str(), g_state);
+
+                if (run)
+                {
+                    code = &iter.next();
+                    REQUIRE(code->get_type() == ecma48_code::type_chars);
+                    REQUIRE(code->get_pointer() == s.c_str());
+                    REQUIRE(code->get_length() == run);
+                }
+
+                code = &iter.next();
+                REQUIRE(code->get_type() != ecma48_code::type_chars);
+                REQUIRE(code->get_length() == strlen(stop));
+
+                code = &iter.next();
+                REQUIRE(code->get_type() == ecma48_code::type_chars);
+                REQUIRE(code->get_length() == 3);
+
+                REQUIRE(!iter.next());
+            }
+        }
+    }
+
+    SECTION("Length")
+    {
+        const char* input = "abcdefghijklmnopqrstuvwxyz0123456789";
+        for (int len = 1; len < 36; ++len)
+        {
+            ecma48_iter iter(input + 1, g_state, len);
+
+            code = &iter.next();
+            REQUIRE(code->get_type() == ecma48_code::type_chars);
+            REQUIRE(code->get_length() == len);
+
+            REQUIRE(!iter.next());
+        }
+    }
+
+    SECTION("Mostly plain")
+    {
+        // Large mostly plain input, such as popenyield output or a long match
+        // list:  long lines of text, with an occasional escape code.
+        std::string input;
+        unsigned int lines = make_mostly_plain(input, 64 * 1024);
+
+        unsigned int total = 0;
+        unsigned int chunks = 0;
+        ecma48_iter iter(input.c_str(), g_state);
+        while (const ecma48_code& code = iter.next())
+        {
+            total += code.get_length();
+            if (code.get_type() == ecma48_code::type_chars)
+                ++chunks;
+        }
+
+        REQUIRE(total == input.size());
+        REQUIRE(chunks == lines);
+    }
+
+    SECTION("Benchmark")
+    {
+        if (g_show_benchmarks)
+        {
+            std::string input;
+            make_mostly_plain(input, 1024 * 1024);
+
+            const int passes = 20;
+            unsigned int total = 0;
+            const double start = os::clock();
+            for (int pass = 0; pass < passes; ++pass)
+            {
+                ecma48_iter iter(input.c_str(), g_state);
+                while (const ecma48_code& code = iter.next())
+                    total += code.get_length();
+            }
+            const double elapsed = os::clock() - start;
+
+            REQUIRE(total == input.size() * passes);
+            printf("\necma48 iter, %u bytes:  %.3f msec per pass\n",
+                   unsigned(input.size()), elapsed * 1000 / passes);
+        }
+    }
+
+    SECTION("Long")
+    {
+        // Runs longer than an ecma48_code can describe are split into more
+        // than one chunk.
+        std::string input;
+        while (input.size() < 200000)
+            input.append("0123456789abcdef");
+
+        unsigned int total = 0;
+        ecma48_iter iter(input.c_str(), g_state);
+        while (const ecma48_code& code = iter.next())
+        {
+            REQUIRE(code.get_type() == ecma48_code::type_chars);
+            REQUIRE(code.get_length() < 0x10000);
+            total += code.get_length();
+        }
+
+        REQUIRE(total == input.size());
+    }
+}
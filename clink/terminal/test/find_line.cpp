@@ -0,0 +1,161 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/base.h>
+#include <terminal/find_line.h>
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+// An in-memory screen.  Characters from U+1100 up occupy two cells.
+class test_find_line_source
+    : public find_line_source
+{
+public:
+                    test_find_line_source(int width) : m_width(width) {}
+    void            add_line(const wchar_t* text, WORD attr=0x07, int attr_begin=0, int attr_end=0, WORD highlight=0x07);
+    virtual int     get_width() const override { return m_width; }
+    virtual int     get_height() const override { return int(m_cells.size()) / m_width; }
+    virtual bool    read_rows(int first, int count, CHAR_INFO* cells) override;
+    unsigned int    m_reads = 0;
+
+private:
+    const int       m_width;
+    std::vector<CHAR_INFO> m_cells;
+};
+
+//------------------------------------------------------------------------------
+void test_find_line_source::add_line(const wchar_t* text, WORD attr, int attr_begin, int attr_end, WORD highlight)
+{
+    const size_t first = m_cells.size();
+    m_cells.resize(first + m_width);
+    for (int i = 0; i < m_width; ++i)
+    {
+        m_cells[first + i].Char.UnicodeChar = ' ';
+        m_cells[first + i].Attributes = (i >= attr_begin && i < attr_end) ? highlight : attr;
+    }
+
+    for (int i = 0; *text && i < m_width; ++text, ++i)
+    {
+        m_cells[first + i].Char.UnicodeChar = *text;
+        if (*text >= 0x1100 && i + 1 < m_width)
+        {
+            ++i;
+            m_cells[first + i].Char.UnicodeChar = *text;
+            m_cells[first + i].Attributes |= COMMON_LVB_TRAILING_BYTE;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+bool test_find_line_source::read_rows(int first, int count, CHAR_INFO* cells)
+{
+    m_reads++;
+    if (first < 0 || first + count > get_height())
+        return false;
+
+    memcpy(cells, &m_cells[first * m_width], count * m_width * sizeof(*cells));
+    return true;
+}
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("Find line")
+{
+    test_find_line_source source(20);
+    source.add_line(L"alpha");
+    source.add_line(L"beta gamma");
+    source.add_line(L"delta", 0x07, 0, 3, 0x0c);
+    source.add_line(L"ab\x4e2d\x6587" L"cd", 0x07, 6, 8, 0x0c);
+
+    const BYTE red = 0x0c;
+
+    SECTION("Substring")
+    {
+        REQUIRE(find_line(source, 0, 4, "gamma", find_line_mode::none) == 1);
+        REQUIRE(find_line(source, 3, -4, "gamma", find_line_mode::none) == 1);
+        REQUIRE(find_line(source, 2, 2, "gamma", find_line_mode::none) == -1);
+        REQUIRE(find_line(source, 0, 2, "delta", find_line_mode::none) == -1);
+        REQUIRE(find_line(source, 0, 4, "ta", find_line_mode::none) == 1);
+
+        // Searching past the edge of the screen.
+        REQUIRE(find_line(source, 0, 10, "epsilon", find_line_mode::none) == 0);
+    }
+
+    SECTION("Ignore case")
+    {
+        REQUIRE(find_line(source, 0, 4, "GAMMA", find_line_mode::none) == -1);
+        REQUIRE(find_line(source, 0, 4, "GAMMA", find_line_mode::ignore_case) == 1);
+    }
+
+    SECTION("Regex")
+    {
+        REQUIRE(find_line(source, 0, 4, "^d.*a$", find_line_mode::use_regex) == 2);
+        REQUIRE(find_line(source, 0, 4, "^D", find_line_mode::use_regex) == -1);
+        REQUIRE(find_line(source, 0, 4, "^D", find_line_mode::use_regex|find_line_mode::ignore_case) == 2);
+        REQUIRE(find_line(source, 0, 4, "(", find_line_mode::use_regex) == -1);
+    }
+
+    SECTION("Attributes")
+    {
+        REQUIRE(find_line(source, 0, 4, nullptr, find_line_mode::none, &red, 1) == 2);
+        REQUIRE(find_line(source, 0, 4, "del", find_line_mode::none, &red, 1) == 2);
+        REQUIRE(find_line(source, 0, 3, "ta", find_line_mode::none, &red, 1) == -1);
+        REQUIRE(find_line(source, 0, 3, "ta", find_line_mode::none, &red, 1, 0x04) == 1);
+    }
+
+    SECTION("Wide")
+    {
+        // Matches are mapped back to columns, so "cd" finds the attributes in
+        // columns 6 and 7 even though it's at offset 4 in the text.
+        REQUIRE(find_line(source, 0, 4, "\xe4\xb8\xad\xe6\x96\x87" "c", find_line_mode::none) == 3);
+        REQUIRE(find_line(source, 3, 1, "cd", find_line_mode::none, &red, 1) == 3);
+        REQUIRE(find_line(source, 3, 1, "ab", find_line_mode::none, &red, 1) == -1);
+    }
+
+    SECTION("Matcher")
+    {
+        class length_matcher : public find_line_matcher
+        {
+        public:
+            virtual int match(const wchar_t* text, unsigned int len, int& start, int& length) const override
+            {
+                start = 0;
+                length = len;
+                return len == 10;
+            }
+        };
+
+        length_matcher matcher;
+        REQUIRE(find_line(source, 0, 4, &matcher) == 1);
+    }
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Find line blocks")
+{
+    test_find_line_source source(80);
+    for (int i = 0; i < 1000; ++i)
+        source.add_line((i == 100 || i == 900) ? L"needle" : L"hay");
+
+    // Rows are read in blocks, not one at a time.
+    REQUIRE(find_line(source, 0, 1000, "needle", find_line_mode::none) == 100);
+    REQUIRE(source.m_reads == 1);
+
+    source.m_reads = 0;
+    REQUIRE(find_line(source, 101, 899, "needle", find_line_mode::none) == 900);
+    REQUIRE(source.m_reads > 1);
+    REQUIRE(source.m_reads < 10);
+
+    source.m_reads = 0;
+    REQUIRE(find_line(source, 899, -899, "needle", find_line_mode::none) == 100);
+    REQUIRE(source.m_reads > 1);
+    REQUIRE(source.m_reads < 10);
+
+    source.m_reads = 0;
+    REQUIRE(find_line(source, 999, -1000, "NEEDLE", find_line_mode::use_regex|find_line_mode::ignore_case) == 900);
+    REQUIRE(find_line(source, 0, 1000, "^n.*e$", find_line_mode::use_regex) == 100);
+}
@@ -0,0 +1,106 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/str.h>
+#include <terminal/frame_buffer.h>
+
+//------------------------------------------------------------------------------
+class test_frame_sink
+    : public frame_sink
+{
+public:
+    virtual void    emit(const char* data, int length) override { m_emitted++; m_output.concat_no_truncate(data, length); }
+    unsigned int    m_emitted = 0;
+    str<>           m_output;
+};
+
+//------------------------------------------------------------------------------
+TEST_CASE("Frame buffer.")
+{
+    test_frame_sink sink;
+    frame_buffer frame(sink, 64);
+
+    SECTION("Pass through")
+    {
+        frame.write("abc", 3);
+        frame.write("def", 3);
+        REQUIRE(sink.m_emitted == 2);
+        REQUIRE(sink.m_output.equals("abcdef"));
+    }
+
+    SECTION("One flush per frame")
+    {
+        frame.begin_frame();
+        frame.write("a", 1);
+        frame.write("\x1b[1m", 4);
+        frame.write("b", 1);
+        frame.write("\x1b[m", 3);
+        frame.write("\x1b[3D", 4);
+        REQUIRE(sink.m_emitted == 0);
+        frame.end_frame();
+        REQUIRE(sink.m_emitted == 1);
+        REQUIRE(sink.m_output.equals("a\x1b[1mb\x1b[m\x1b[3D"));
+        REQUIRE(frame.get_emit_count() == 1);
+    }
+
+    SECTION("Nested")
+    {
+        frame.begin_frame();
+        frame.write("ab", 2);
+        frame.begin_frame();
+        frame.write("cd", 2);
+        frame.end_frame();
+        REQUIRE(sink.m_emitted == 0);
+        frame.write("ef", 2);
+        frame.end_frame();
+        REQUIRE(sink.m_emitted == 1);
+        REQUIRE(sink.m_output.equals("abcdef"));
+    }
+
+    SECTION("Explicit flush")
+    {
+        frame.begin_frame();
+        frame.write("ab", 2);
+        frame.flush();
+        REQUIRE(sink.m_emitted == 1);
+        frame.write("cd", 2);
+        frame.end_frame();
+        REQUIRE(sink.m_emitted == 2);
+        REQUIRE(sink.m_output.equals("abcd"));
+
+        frame.flush();
+        REQUIRE(sink.m_emitted == 2);
+    }
+
+    SECTION("Capacity")
+    {
+        str<> big;
+        for (int i = 0; i < 10; ++i)
+            big.concat("0123456789");
+
+        frame.begin_frame();
+        for (int i = 0; i < 10; ++i)
+            frame.write("0123456789", 10);
+        REQUIRE(sink.m_emitted == 1);
+        frame.write(big.c_str(), big.length());
+        REQUIRE(sink.m_emitted == 3);
+        frame.write("x", 1);
+        frame.end_frame();
+        REQUIRE(sink.m_emitted == 4);
+
+        str<> expected;
+        expected << big.c_str() << big.c_str() << "x";
+        REQUIRE(sink.m_output.equals(expected.c_str()));
+    }
+
+    SECTION("Embedded nul")
+    {
+        frame.begin_frame();
+        frame.write("a\0b", 3);
+        frame.end_frame();
+        REQUIRE(sink.m_emitted == 1);
+        REQUIRE(sink.m_output.length() == 3);
+    }
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <terminal/keyseq_trie.h>
+
+//------------------------------------------------------------------------------
+TEST_CASE("Key sequence trie")
+{
+    keyseq_trie trie;
+    REQUIRE(trie.empty());
+
+    REQUIRE(trie.add("\x1b", 0));            // ESC
+    REQUIRE(trie.add("\x1b[A", 1));          // Up
+    REQUIRE(trie.add("\x1b[1;5A", 2));       // Ctrl-Up
+    REQUIRE(trie.add("\x1b[3~", 3));         // Del
+    REQUIRE(trie.add("\x1bO", 4));
+    REQUIRE(trie.add("\x1bOP", 5));          // F1
+    REQUIRE(!trie.add("\x1b[A", 6));
+    REQUIRE(!trie.add("", 7));
+    REQUIRE(!trie.empty());
+
+    int len = 0;
+
+    SECTION("Sequences")
+    {
+        REQUIRE(trie.lookup("\x1b[A", len) == 1);
+        REQUIRE(len == 3);
+        REQUIRE(trie.lookup("\x1b[3~", len) == 3);
+        REQUIRE(len == 4);
+        REQUIRE(trie.lookup("\x1bOP", len) == 5);
+        REQUIRE(len == 3);
+    }
+
+    SECTION("Lookup")
+    {
+        // The longest complete sequence at the start of the input wins.
+        REQUIRE(trie.lookup("\x1b[1;5Axyz", len) == 2);
+        REQUIRE(len == 6);
+        REQUIRE(trie.lookup("\x1b[1;5", len) == 0);
+        REQUIRE(len == 1);
+        REQUIRE(trie.lookup("\x1bOx", len) == 4);
+        REQUIRE(len == 2);
+        REQUIRE(trie.lookup("abc", len) == -1);
+    }
+
+    SECTION("Remove")
+    {
+        REQUIRE(trie.remove("\x1bO"));
+        REQUIRE(!trie.remove("\x1bO"));
+        REQUIRE(trie.lookup("\x1bOx", len) == 0);
+        REQUIRE(len == 1);
+        REQUIRE(trie.lookup("\x1bOP", len) == 5);
+        REQUIRE(len == 3);
+    }
+
+    SECTION("Clear")
+    {
+        trie.clear();
+        REQUIRE(trie.empty());
+        REQUIRE(trie.lookup("\x1b[A", len) == -1);
+    }
+}
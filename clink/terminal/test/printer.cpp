@@ -0,0 +1,173 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/base.h>
+#include <core/os.h>
+#include <core/str.h>
+#include <terminal/printer.h>
+#include <terminal/terminal_out.h>
+
+extern bool g_show_benchmarks;
+
+//------------------------------------------------------------------------------
+class capture_terminal_out
+    : public terminal_out
+{
+public:
+    virtual void    open() override {}
+    virtual void    begin() override {}
+    virtual void    end() override {}
+    virtual void    close() override {}
+    virtual void    begin_frame() override {}
+    virtual void    end_frame() override {}
+    virtual void    write(const char* chars, int length) override { m_output.concat(chars, length); }
+    virtual void    flush() override {}
+    virtual int     get_columns() const override { return 80; }
+    virtual int     get_rows() const override { return 25; }
+    virtual bool    get_line_text(int line, str_base& out) const override { return false; }
+    virtual int     is_line_default_color(int line) const override { return true; }
+    virtual int     line_has_color(int line, const BYTE* attrs, int num_attrs, BYTE mask=0xff) const override { return false; }
+    virtual int     find_line(int starting_line, int distance, const char* text, find_line_mode mode, const BYTE* attrs=nullptr, int num_attrs=0, BYTE mask=0xff) const override { return 0; }
+    str_moveable    m_output;
+};
+
+//------------------------------------------------------------------------------
+static void make_attributes(attributes (&attrs)[8])
+{
+    attrs[0] = attributes::defaults;
+    attrs[1].set_fg(color_red);
+    attrs[2].set_fg(color_light_cyan);
+    attrs[3].set_bg(color_blue);
+    attrs[4].set_bg(color_white);
+    attrs[5].set_bold();
+    attrs[6].set_underline();
+    attrs[7].reset_fg();
+    attrs[7].set_bold(false);
+    attrs[7].set_underline(false);
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Printer SGR cache.")
+{
+    attributes attrs[8];
+    make_attributes(attrs);
+
+    capture_terminal_out terminal;
+    printer printer(terminal);
+
+    SECTION("Equivalence")
+    {
+        // The cached escape codes match formatting each transition directly.
+        str_moveable expected;
+        attributes set_attr = attributes::defaults;
+        attributes next_attr = attributes::defaults;
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (const auto& from : attrs)
+            {
+                for (const auto& to : attrs)
+                {
+                    const attributes pair[] = { from, to };
+                    for (const auto& attr : pair)
+                    {
+                        printer.set_attributes(attr);
+                        printer.print("x", 1);
+
+                        next_attr = attributes::merge(next_attr, attr);
+                        if (next_attr != set_attr)
+                        {
+                            str<32, false> sgr;
+                            printer::build_sgr(attributes::diff(set_attr, next_attr), sgr);
+                            expected << sgr;
+                            set_attr = next_attr;
+                        }
+                        expected << "x";
+                    }
+                }
+            }
+        }
+
+        REQUIRE(terminal.m_output.equals(expected.c_str()));
+    }
+
+    SECTION("Redisplay")
+    {
+        // Redisplaying syntax colored text repeats the same few transitions,
+        // so after the first redisplay no escape codes are formatted at all.
+        const attributes line[] = { attrs[1], attrs[0], attrs[2], attrs[0], attrs[5], attrs[3], attrs[0] };
+
+        unsigned int first_misses = 0;
+        for (int redisplay = 0; redisplay < 10; ++redisplay)
+        {
+            for (int word = 0; word < 20; ++word)
+            {
+                for (const auto& attr : line)
+                {
+                    printer.set_attributes(attr);
+                    printer.print("word ", 5);
+                }
+            }
+            if (!redisplay)
+                first_misses = printer.get_sgr_cache_misses();
+        }
+
+        REQUIRE(first_misses > 0);
+        REQUIRE(first_misses <= sizeof_array(line));
+        REQUIRE(printer.get_sgr_cache_misses() == first_misses);
+    }
+
+    SECTION("Benchmark")
+    {
+        if (g_show_benchmarks)
+        {
+            const attributes line[] = { attrs[1], attrs[0], attrs[2], attrs[0], attrs[5], attrs[3], attrs[0] };
+            const int redisplays = 10000;
+
+            // Cached:  the printer reuses the escape codes for transitions it
+            // has already formatted.
+            double start = os::clock();
+            for (int redisplay = 0; redisplay < redisplays; ++redisplay)
+            {
+                terminal.m_output.clear();
+                for (int word = 0; word < 20; ++word)
+                {
+                    for (const auto& attr : line)
+                    {
+                        printer.set_attributes(attr);
+                        printer.print("word ", 5);
+                    }
+                }
+            }
+            const double cached = os::clock() - start;
+
+            // Uncached:  format the escape codes for every transition.
+            attributes set_attr = attributes::defaults;
+            start = os::clock();
+            for (int redisplay = 0; redisplay < redisplays; ++redisplay)
+            {
+                terminal.m_output.clear();
+                for (int word = 0; word < 20; ++word)
+                {
+                    for (const auto& attr : line)
+                    {
+                        const attributes next_attr = attributes::merge(set_attr, attr);
+                        if (next_attr != set_attr)
+                        {
+                            str<32, false> sgr;
+                            printer::build_sgr(attributes::diff(set_attr, next_attr), sgr);
+                            terminal.write(sgr.c_str(), sgr.length());
+                            set_attr = next_attr;
+                        }
+                        terminal.write("word ", 5);
+                    }
+                }
+            }
+            const double uncached = os::clock() - start;
+
+            printf("\nprinter SGR, %d redisplays:  %.3f msec cached, %.3f msec uncached\n",
+                   redisplays, cached * 1000, uncached * 1000);
+        }
+    }
+}
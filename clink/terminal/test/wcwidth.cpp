@@ -0,0 +1,37 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+extern "C" int mk_wcwidth(char32_t);
+extern "C" int mk_wcwidth_cjk(char32_t);
+extern "C" int mk_wcwidth_reference(char32_t);
+extern "C" int mk_wcwidth_cjk_reference(char32_t);
+
+//------------------------------------------------------------------------------
+TEST_CASE("wcwidth : table matches bisearch")
+{
+    SECTION("Default")
+    {
+        for (char32_t ucs = 0; ucs <= 0x110010; ++ucs)
+        {
+            const int table = mk_wcwidth(ucs);
+            const int reference = mk_wcwidth_reference(ucs);
+            REQUIRE(table == reference, [&] () {
+                printf("ucs %X:  table %d, reference %d", ucs, table, reference);
+            });
+        }
+    }
+
+    SECTION("CJK")
+    {
+        for (char32_t ucs = 0; ucs <= 0x110010; ++ucs)
+        {
+            const int table = mk_wcwidth_cjk(ucs);
+            const int reference = mk_wcwidth_cjk_reference(ucs);
+            REQUIRE(table == reference, [&] () {
+                printf("ucs %X:  table %d, reference %d", ucs, table, reference);
+            });
+        }
+    }
+}
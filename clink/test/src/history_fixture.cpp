@@ -0,0 +1,55 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "history_fixture.h"
+
+#include <core/str.h>
+
+extern "C" {
+#include <readline/history.h>
+};
+
+extern bool g_show_benchmarks;
+
+//------------------------------------------------------------------------------
+void format_history_line(unsigned int i, str_base& out)
+{
+    out.format("cmd%u --flag arg%u", i, i % 100);
+}
+
+//------------------------------------------------------------------------------
+void add_history_lines(unsigned int count)
+{
+    str<> line;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        format_history_line(i, line);
+        add_history(line.c_str());
+    }
+}
+
+//------------------------------------------------------------------------------
+void write_history_lines(FILE* file, unsigned int count)
+{
+    str<> line;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        format_history_line(i, line);
+        fprintf(file, "%s\n", line.c_str());
+    }
+}
+
+//------------------------------------------------------------------------------
+bool use_history_size(unsigned int count, unsigned int smallest)
+{
+    return count <= smallest || g_show_benchmarks;
+}
+
+//------------------------------------------------------------------------------
+void print_history_benchmark(const char* name, unsigned int lines, double first, double again,
+                             const char* first_label, const char* again_label)
+{
+    printf("\n%s %u lines:  %.3f msec %s, %.3f msec %s\n",
+           name, lines, first * 1000, first_label, again * 1000, again_label);
+}
@@ -0,0 +1,24 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdio.h>
+
+class str_base;
+
+//------------------------------------------------------------------------------
+// Synthetic history shared by the history tests and benchmarks.  Line 'i' is
+// "cmd<i> --flag arg<i % 100>".
+void    format_history_line(unsigned int i, str_base& out);
+void    add_history_lines(unsigned int count);
+void    write_history_lines(FILE* file, unsigned int count);
+
+// Large histories are only used when showing benchmarks; run the tests with
+// -b to see the results.  Returns whether a history of 'count' lines should be
+// used, given the smallest size a test always uses.
+bool    use_history_size(unsigned int count, unsigned int smallest);
+
+// Prints two timings for a benchmark over a history of 'lines' lines.
+void    print_history_benchmark(const char* name, unsigned int lines, double first, double again,
+                                const char* first_label="first", const char* again_label="again");
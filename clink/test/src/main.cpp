@@ -12,6 +12,7 @@
 
 //------------------------------------------------------------------------------
 extern bool g_force_load_debugger;
+bool g_show_benchmarks = false;
 
 //------------------------------------------------------------------------------
 void host_cmd_enqueue_lines(std::list<str_moveable>& lines)
@@ -50,10 +51,15 @@ int main(int argc, char** argv)
         {
             puts("Options:\n"
                  "  -?        Show this help.\n"
+                 "  -b        Show benchmark results.\n"
                  "  -d        Load Lua debugger.\n"
                  "  -t        Show execution time.");
             return 1;
         }
+        else if (!strcmp(argv[0], "-b"))
+        {
+            g_show_benchmarks = true;
+        }
         else if (!strcmp(argv[0], "-d"))
         {
             g_force_load_debugger = true;
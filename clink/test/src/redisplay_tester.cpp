@@ -0,0 +1,126 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "redisplay_tester.h"
+
+#include <core/base.h>
+#include <core/os.h>
+#include <core/str_iter.h>
+#include <terminal/printer.h>
+#include <readline/readline.h>
+
+#include <stdio.h>
+
+//------------------------------------------------------------------------------
+extern bool g_show_benchmarks;
+
+//------------------------------------------------------------------------------
+redisplay_tester::redisplay_tester(int columns, int rows, const char* prompt)
+: m_screen(columns, rows)
+, m_terminal(terminal_create(&m_screen))
+{
+    m_printer = new printer(*this);
+    m_printer_context = new printer_context(this, m_printer);
+
+    line_editor::desc desc(&m_terminal_in, this, m_printer, nullptr);
+    desc.prompt = prompt;
+    m_editor = line_editor_create(desc);
+    REQUIRE(m_editor != nullptr);
+
+    // The first update begins the line.  Then make Readline's idea of the
+    // screen size match the headless screen, and redraw the prompt with it.
+    rl_get_screen_size(&m_saved_rows, &m_saved_columns);
+    REQUIRE(m_editor->update());
+    rl_set_screen_size(rows, columns);
+    rl_forced_update_display();
+
+    reset_stats();
+}
+
+//------------------------------------------------------------------------------
+redisplay_tester::~redisplay_tester()
+{
+    // Accept the line so the editor ends it cleanly.
+    press_key("\r");
+    str<> line;
+    m_editor->get_line(line);
+
+    line_editor_destroy(m_editor);
+    delete m_printer_context;
+    delete m_printer;
+    terminal_destroy(m_terminal);
+
+    rl_set_screen_size(m_saved_rows, m_saved_columns);
+}
+
+//------------------------------------------------------------------------------
+void redisplay_tester::press_key(const char* keys)
+{
+    const unsigned int cells_changed = m_screen.get_cells_changed();
+    const double start = os::clock();
+
+    m_terminal_in.set_input(keys);
+    do
+    {
+        if (!m_editor->update())
+            break;
+    }
+    while (m_terminal_in.has_input());
+
+    m_stats.elapsed += os::clock() - start;
+    m_stats.cells_changed += m_screen.get_cells_changed() - cells_changed;
+    m_stats.keystrokes++;
+}
+
+//------------------------------------------------------------------------------
+void redisplay_tester::type(const char* text)
+{
+    // One keystroke per character.
+    str_iter iter(text);
+    while (iter.more())
+    {
+        const char* ptr = iter.get_pointer();
+        iter.next();
+
+        str<16> key;
+        key.concat(ptr, int(iter.get_pointer() - ptr));
+        press_key(key.c_str());
+    }
+}
+
+//------------------------------------------------------------------------------
+void redisplay_tester::reset_stats()
+{
+    m_stats = redisplay_stats();
+}
+
+//------------------------------------------------------------------------------
+void redisplay_tester::report(const char* name) const
+{
+    if (!g_show_benchmarks || !m_stats.keystrokes)
+        return;
+
+    const unsigned int n = m_stats.keystrokes;
+    printf("\n%s:  %u keystrokes, %u bytes (%.1f/key), %u cells changed (%.1f/key), %.1f usec/key\n",
+           name, n,
+           m_stats.bytes, double(m_stats.bytes) / n,
+           m_stats.cells_changed, double(m_stats.cells_changed) / n,
+           m_stats.elapsed * 1000000 / n);
+}
+
+//------------------------------------------------------------------------------
+bool redisplay_tester::get_screen_line(int row, str_base& out) const
+{
+    return m_screen.get_line_text(m_screen.get_top() + row, out);
+}
+
+//------------------------------------------------------------------------------
+void redisplay_tester::write(const char* chars, int length)
+{
+    if (length < 0)
+        length = int(strlen(chars));
+
+    m_stats.bytes += length;
+    m_terminal.out->write(chars, length);
+}
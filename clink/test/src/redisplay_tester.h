@@ -0,0 +1,66 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "line_editor_tester.h"
+
+#include <core/str.h>
+#include <terminal/headless_screen_buffer.h>
+#include <terminal/terminal.h>
+
+//------------------------------------------------------------------------------
+struct redisplay_stats
+{
+    unsigned int            keystrokes = 0;
+    unsigned int            bytes = 0;          // Bytes written to the terminal.
+    unsigned int            cells_changed = 0;  // Screen cells whose content or attributes changed.
+    double                  elapsed = 0;        // Seconds spent handling keystrokes.
+};
+
+//------------------------------------------------------------------------------
+// Drives a line editor through scripted keystrokes, with its output going to a
+// headless_screen_buffer, so tests can check the resulting screen and measure
+// how much each redisplay writes.
+class redisplay_tester
+    : public terminal_out
+{
+public:
+                            redisplay_tester(int columns=80, int rows=25, const char* prompt="clink $ ");
+                            ~redisplay_tester();
+    void                    press_key(const char* keys);
+    void                    type(const char* text);
+    void                    reset_stats();
+    const redisplay_stats&  get_stats() const { return m_stats; }
+    void                    report(const char* name) const;
+    line_editor*            get_editor() const { return m_editor; }
+    const headless_screen_buffer& get_screen() const { return m_screen; }
+    bool                    get_screen_line(int row, str_base& out) const;
+
+private:
+    // terminal_out; counts bytes and forwards to the ecma48 terminal.
+    virtual void            open() override {}
+    virtual void            begin() override { m_terminal.out->begin(); }
+    virtual void            end() override { m_terminal.out->end(); }
+    virtual void            close() override {}
+    virtual void            begin_frame() override { m_terminal.out->begin_frame(); }
+    virtual void            end_frame() override { m_terminal.out->end_frame(); }
+    virtual void            write(const char* chars, int length) override;
+    virtual void            flush() override { m_terminal.out->flush(); }
+    virtual int             get_columns() const override { return m_screen.get_columns(); }
+    virtual int             get_rows() const override { return m_screen.get_rows(); }
+    virtual bool            get_line_text(int line, str_base& out) const override { return m_screen.get_line_text(line, out); }
+    virtual int             is_line_default_color(int line) const override { return m_screen.is_line_default_color(line); }
+    virtual int             line_has_color(int line, const BYTE* attrs, int num_attrs, BYTE mask=0xff) const override { return m_screen.line_has_color(line, attrs, num_attrs, mask); }
+    virtual int             find_line(int starting_line, int distance, const char* text, find_line_mode mode, const BYTE* attrs=nullptr, int num_attrs=0, BYTE mask=0xff) const override { return m_screen.find_line(starting_line, distance, text, mode, attrs, num_attrs, mask); }
+
+    headless_screen_buffer  m_screen;
+    terminal                m_terminal;
+    test_terminal_in        m_terminal_in;
+    printer*                m_printer = nullptr;
+    printer_context*        m_printer_context = nullptr;
+    line_editor*            m_editor = nullptr;
+    redisplay_stats         m_stats;
+    int                     m_saved_rows = 0;
+    int                     m_saved_columns = 0;
+};
@@ -0,0 +1,487 @@
+/*
+
+    Index of the history lines, to speed up searching the history.  Each line
+    is indexed by the trigrams of its case folded text, and by its first one,
+    two, and three case folded bytes.  A search only compares against lines
+    that contain the least common trigram of the search string (or that start
+    with its prefix), instead of against every line in the history.
+
+    The index only narrows down the candidates; the callers still compare each
+    candidate line the same way as before, so it can safely include lines that
+    don't match.  It is built the first time it's needed and then kept up to
+    date as lines are added and removed.
+
+*/
+
+#define READLINE_LIBRARY
+
+#if defined (HAVE_CONFIG_H)
+#  include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined (HAVE_STDLIB_H)
+#  include <stdlib.h>
+#else
+#  include "readline/ansi_stdlib.h"
+#endif /* HAVE_STDLIB_H */
+
+#include "readline/history.h"
+#include "readline/histlib.h"
+#include "readline/xmalloc.h"
+
+/* Folded bytes have 129 possible values (0x00-0x80). */
+#define GRAM_BASE		130
+#define PREFIX_GRAM		0x80000000
+#define PREFIX_LEN_SHIFT	22
+
+/* A mark is recorded after every MARK_EVERY postings, so that finding a
+   posting decodes at most MARK_EVERY deltas. */
+#define MARK_EVERY		32
+
+/* Below this many live lines, searching every line is fast enough. */
+#define MIN_INDEXED_LINES	256
+
+typedef struct _hist_gram
+{
+  unsigned int key;		/* gram + 1; 0 means an empty slot */
+  unsigned int count;		/* number of postings */
+  unsigned int last;		/* sequence number of the last posting */
+  unsigned int len;		/* bytes used in data */
+  unsigned int size;		/* bytes allocated for data */
+  unsigned char *data;		/* deltas between sequence numbers (LEB128) */
+  unsigned int *marks;		/* (seq, offset) after every MARK_EVERY postings */
+} HIST_GRAM;
+
+static HIST_GRAM *grams;	/* open addressed hash table */
+static unsigned int grams_size;	/* power of 2 */
+static unsigned int grams_used;
+
+static unsigned int *live;	/* sequence number of each history entry */
+static unsigned int live_len;
+static unsigned int live_size;
+static unsigned int next_seq;
+static unsigned int dead;	/* entries removed since the index was built */
+
+static unsigned int *dirty;	/* entries whose lines were replaced */
+static unsigned int dirty_len;
+static unsigned int dirty_size;
+
+static int built;
+
+/* Changes whenever the history list changes. */
+static unsigned int generation;
+
+static unsigned char *folded;
+static unsigned int folded_size;
+
+/* Case folds the first LEN bytes of S into the folded buffer, and returns the
+   folded length.  Each multibyte character folds to a single 0x80, since
+   characters can compare equal when ignoring case even if their bytes (or
+   their lengths) differ.  So do 'i' and 'k', since U+0130 and U+212A lower
+   case to them. */
+static unsigned int
+fold (const char *s, int len)
+{
+  unsigned int n;
+  unsigned char c;
+  int i;
+
+  if ((unsigned int)len >= folded_size)
+    {
+      folded_size = len + 1 + (len + 1) / 2;
+      folded = (unsigned char *)xrealloc (folded, folded_size);
+    }
+
+  for (n = 0, i = 0; i < len; i++)
+    {
+      c = (unsigned char)s[i];
+      if (c >= 0x80 && c < 0xc0)
+	continue;		/* UTF8 continuation byte */
+      if (c >= 'A' && c <= 'Z')
+	c += 'a' - 'A';
+      if (c >= 0x80 || c == 'i' || c == 'k')
+	c = 0x80;
+      folded[n++] = c;
+    }
+
+  return n;
+}
+
+static unsigned int
+trigram (const unsigned char *s)
+{
+  return ((s[0] * GRAM_BASE) + s[1]) * GRAM_BASE + s[2];
+}
+
+static unsigned int
+prefix_gram (const unsigned char *s, unsigned int len)
+{
+  unsigned int gram, i;
+
+  for (gram = 0, i = 0; i < len; i++)
+    gram = gram * GRAM_BASE + s[i];
+  return PREFIX_GRAM | (len << PREFIX_LEN_SHIFT) | gram;
+}
+
+static unsigned int
+hash_slot (unsigned int key)
+{
+  return (key * 2654435761u) & (grams_size - 1);
+}
+
+static HIST_GRAM *
+find_gram (unsigned int gram)
+{
+  unsigned int slot;
+
+  if (grams_size == 0)
+    return (HIST_GRAM *)NULL;
+
+  for (slot = hash_slot (gram + 1); grams[slot].key; slot = (slot + 1) & (grams_size - 1))
+    if (grams[slot].key == gram + 1)
+      return &grams[slot];
+
+  return (HIST_GRAM *)NULL;
+}
+
+static HIST_GRAM *
+add_gram (unsigned int gram)
+{
+  HIST_GRAM *old;
+  unsigned int old_size, slot, i;
+
+  if ((grams_used + 1) * 2 > grams_size)
+    {
+      old = grams;
+      old_size = grams_size;
+      grams_size = old_size ? old_size * 2 : 4096;
+      grams = (HIST_GRAM *)xmalloc (grams_size * sizeof (HIST_GRAM));
+      memset (grams, 0, grams_size * sizeof (HIST_GRAM));
+      for (i = 0; i < old_size; i++)
+	if (old[i].key)
+	  {
+	    for (slot = hash_slot (old[i].key); grams[slot].key; slot = (slot + 1) & (grams_size - 1))
+	      ;
+	    grams[slot] = old[i];
+	  }
+      FREE (old);
+    }
+
+  for (slot = hash_slot (gram + 1); grams[slot].key; slot = (slot + 1) & (grams_size - 1))
+    if (grams[slot].key == gram + 1)
+      return &grams[slot];
+
+  grams[slot].key = gram + 1;
+  grams_used++;
+  return &grams[slot];
+}
+
+static void
+add_posting (unsigned int gram, unsigned int seq)
+{
+  HIST_GRAM *g;
+  unsigned int delta, n;
+
+  g = add_gram (gram);
+
+  /* A line adds each gram once. */
+  if (g->count && g->last == seq)
+    return;
+
+  if (g->len + 5 > g->size)
+    {
+      g->size = g->size ? g->size * 2 : 16;
+      g->data = (unsigned char *)xrealloc (g->data, g->size);
+    }
+
+  for (delta = seq - g->last; delta >= 0x80; delta >>= 7)
+    g->data[g->len++] = (unsigned char)(delta | 0x80);
+  g->data[g->len++] = (unsigned char)delta;
+
+  g->last = seq;
+  g->count++;
+
+  if (g->count % MARK_EVERY == 0)
+    {
+      n = g->count / MARK_EVERY;
+      if ((n & (n - 1)) == 0)
+	g->marks = (unsigned int *)xrealloc (g->marks, n * 2 * 2 * sizeof (unsigned int));
+      g->marks[(n - 1) * 2] = seq;
+      g->marks[(n - 1) * 2 + 1] = g->len;
+    }
+}
+
+/* Returns the last posting <= SEQ when DIR < 0, or the first posting >= SEQ
+   when DIR > 0.  Returns 0 if there is none. */
+static unsigned int
+find_posting (const HIST_GRAM *g, unsigned int seq, int dir)
+{
+  unsigned int lo, hi, mid, cur, prev, off, delta, shift;
+
+  if (g->count == 0)
+    return 0;
+  if (dir < 0 && seq >= g->last)
+    return g->last;
+  if (dir > 0 && seq > g->last)
+    return 0;
+
+  /* Start decoding from the last mark before SEQ. */
+  lo = 0;
+  hi = g->count / MARK_EVERY;
+  while (lo < hi)
+    {
+      mid = (lo + hi) / 2;
+      if (g->marks[mid * 2] < seq)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+
+  cur = lo ? g->marks[(lo - 1) * 2] : 0;
+  off = lo ? g->marks[(lo - 1) * 2 + 1] : 0;
+
+  for (prev = cur; off < g->len; prev = cur)
+    {
+      for (delta = 0, shift = 0; g->data[off] & 0x80; shift += 7)
+	delta |= (g->data[off++] & 0x7f) << shift;
+      delta |= g->data[off++] << shift;
+
+      cur += delta;
+      if (cur >= seq)
+	{
+	  if (dir > 0 || cur == seq)
+	    return cur;
+	  return prev;
+	}
+    }
+
+  return (dir < 0) ? prev : 0;
+}
+
+/* Returns the history index of SEQ, or -1 if it has been removed. */
+static int
+seq_to_index (unsigned int seq)
+{
+  unsigned int lo, hi, mid;
+
+  lo = 0;
+  hi = live_len;
+  while (lo < hi)
+    {
+      mid = (lo + hi) / 2;
+      if (live[mid] < seq)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+
+  return (lo < live_len && live[lo] == seq) ? (int)lo : -1;
+}
+
+static void
+index_line (const char *line, unsigned int seq)
+{
+  unsigned int len, i;
+
+  len = fold (line, strlen (line));
+
+  for (i = 1; i <= 3 && i <= len; i++)
+    add_posting (prefix_gram (folded, i), seq);
+
+  for (i = 0; i + 3 <= len; i++)
+    add_posting (trigram (folded + i), seq);
+}
+
+static void
+free_index (void)
+{
+  unsigned int i;
+
+  for (i = 0; i < grams_size; i++)
+    {
+      FREE (grams[i].data);
+      FREE (grams[i].marks);
+    }
+  FREE (grams);
+  FREE (live);
+  FREE (dirty);
+  FREE (folded);
+
+  grams = (HIST_GRAM *)NULL;
+  grams_size = grams_used = 0;
+  live = dirty = (unsigned int *)NULL;
+  folded = (unsigned char *)NULL;
+  live_len = live_size = dirty_len = dirty_size = folded_size = 0;
+  next_seq = 0;
+  dead = 0;
+  built = 0;
+}
+
+static void
+build_index (void)
+{
+  HIST_ENTRY **list;
+  unsigned int keep_generation;
+  int i;
+
+  free_index ();
+  built = 1;
+
+  /* Rebuilding the index doesn't change the history list. */
+  keep_generation = generation;
+  list = history_list ();
+  for (i = 0; i < history_length; i++)
+    _hs_history_index_add (list[i]->line);
+  generation = keep_generation;
+}
+
+/* Called after LINE was added at the end of the history list. */
+void
+_hs_history_index_add (const char *line)
+{
+  generation++;
+  if (!built)
+    return;
+
+  if (live_len == live_size)
+    {
+      live_size = live_size ? live_size + live_size / 2 : 1024;
+      live = (unsigned int *)xrealloc (live, live_size * sizeof (unsigned int));
+    }
+
+  live[live_len++] = ++next_seq;
+  if (line)
+    index_line (line, next_seq);
+}
+
+/* Called after COUNT entries starting at FIRST were removed from the history
+   list.  Their postings are skipped until the index is rebuilt. */
+void
+_hs_history_index_remove (int first, int count)
+{
+  generation++;
+  if (!built)
+    return;
+
+  if (first < 0 || count <= 0 || (unsigned int)(first + count) > live_len)
+    {
+      _hs_history_index_invalidate ();
+      return;
+    }
+
+  memmove (live + first, live + first + count, (live_len - first - count) * sizeof (unsigned int));
+  live_len -= count;
+  dead += count;
+}
+
+/* Called after the line of the entry at WHICH was replaced.  Its postings are
+   for the old line, so it's always a candidate until the index is rebuilt. */
+void
+_hs_history_index_replace (int which)
+{
+  generation++;
+  if (!built)
+    return;
+
+  if (which < 0 || (unsigned int)which >= live_len)
+    {
+      _hs_history_index_invalidate ();
+      return;
+    }
+
+  if (dirty_len == dirty_size)
+    {
+      dirty_size = dirty_size ? dirty_size * 2 : 16;
+      dirty = (unsigned int *)xrealloc (dirty, dirty_size * sizeof (unsigned int));
+    }
+  dirty[dirty_len++] = live[which];
+}
+
+/* Called when the history list changed in some other way. */
+void
+_hs_history_index_invalidate (void)
+{
+  generation++;
+  if (built)
+    free_index ();
+}
+
+/* Returns a number that changes whenever the history list changes, so that
+   results derived from the history list can tell when they're stale. */
+unsigned int
+_hs_history_index_generation (void)
+{
+  return generation;
+}
+
+/* Returns the index of the first history entry at or past FROM in direction
+   DIR whose line may contain STRING (or start with it, if ANCHORED).  Returns
+   -1 if no entry can match, or FROM if the index can't narrow it down. */
+int
+_hs_history_index_next (const char *string, int len, int anchored, int from, int dir)
+{
+  HIST_GRAM *best, *g;
+  unsigned int seq, found, d, flen, i;
+  int index;
+
+  if (from < 0 || from >= history_length || len <= 0)
+    return from;
+  if ((!anchored && len < 3) || history_length < MIN_INDEXED_LINES)
+    return from;
+
+  /* Rebuild the index if it isn't built or is out of sync with the history
+     list, or if most of its postings are for removed lines. */
+  if (!built || live_len != (unsigned int)history_length || dead > live_len || dirty_len > 64)
+    build_index ();
+
+  flen = fold (string, len);
+  if (flen == 0 || (!anchored && flen < 3))
+    return from;
+
+  /* Use the least common gram in STRING.  A line that starts with STRING
+     also contains all of its trigrams. */
+  best = anchored ? find_gram (prefix_gram (folded, flen < 3 ? flen : 3)) : 0;
+  for (i = 0; (best || !anchored) && i + 3 <= flen; i++)
+    {
+      g = find_gram (trigram (folded + i));
+      if (g == 0)
+	{
+	  best = (HIST_GRAM *)NULL;
+	  break;
+	}
+      if (best == 0 || g->count < best->count)
+	best = g;
+    }
+
+  seq = live[from];
+  while (1)
+    {
+      found = best ? find_posting (best, seq, dir) : 0;
+
+      /* Entries whose lines were replaced are always candidates. */
+      for (d = 0; d < dirty_len; d++)
+	if ((dir < 0) ? (dirty[d] <= seq && dirty[d] > found)
+		      : (dirty[d] >= seq && (found == 0 || dirty[d] < found)))
+	  found = dirty[d];
+
+      if (found == 0)
+	return -1;
+
+      index = seq_to_index (found);
+      if (index >= 0)
+	return index;
+
+      /* The entry was removed; keep looking. */
+      if (dir < 0)
+	{
+	  if (found == 1)
+	    return -1;
+	  seq = found - 1;
+	}
+      else
+	seq = found + 1;
+    }
+}
@@ -86,6 +86,9 @@ static void open_some_spaces PARAMS((int));
 static void cr PARAMS((void));
 static void redraw_prompt PARAMS((char *));
 static void _rl_move_cursor_relative PARAMS((int, const char *, const char *));
+/* begin_clink_change */
+static int update_line_shifted PARAMS((char *, char *, char *, char *, char *, char *, char *, char *, int, int));
+/* end_clink_change */
 
 /* Values for FLAGS */
 #define PMT_MULTILINE	0x01
@@ -1859,6 +1862,159 @@ norm_face (char *face, int n)
 
 #define ADJUST_CPOS(x) do { _rl_last_c_pos -= (x) ; cpos_adjusted = 1; } while (0)
 
+/* begin_clink_change */
+/* How many characters update_line_shifted looks ahead for the end of an
+   inserted or deleted run. */
+#define SHIFT_SEARCH_LIMIT	16
+
+static int
+shift_col_width (const char *str, int start, int end)
+{
+  if (MB_CUR_MAX == 1 || rl_byte_oriented)
+    return (end - start);
+  return _rl_col_width (str, start, end, 0);
+}
+
+static int
+shift_next_char (const char *str, int ind)
+{
+  if (MB_CUR_MAX == 1 || rl_byte_oriented)
+    return (ind + 1);
+  return _rl_find_next_mbchar ((char *)str, ind, 1, MB_FIND_ANY);
+}
+
+/* Update a screen line whose text after the first difference is the old
+   text shifted right or left, as happens on every row after an insertion
+   or deletion earlier in a wrapped line.  The search compares characters
+   and faces, so a change of color is a difference like any other.  When
+   the old text (from OFD) matches the new text (from NFD) after skipping a
+   short run in each, open or close the gap with the terminal's insert or
+   delete capability and write only the new run, rather than rewriting the
+   rest of the line.  Text shifted past the right edge of the screen falls
+   off; a deletion pulls in blanks, after which the new tail of the line is
+   written.  SUFFIX is the number of bytes the caller found to match at the
+   end of both lines, which is what it would skip writing otherwise.  The
+   cursor must already be at OFD.  Returns 1 if the line was updated, or 0
+   to let the caller update it.
+
+   This is not a general cell-level diff of the frame; it only handles one
+   inserted or deleted run per line.  Several separate changes in one line,
+   lines with wide-char padding at the end, horizontal scroll mode, and the
+   rows of a multi-line prompt all still go through the rest of
+   update_line(). */
+static int
+update_line_shifted (char *old, char *old_face, char *ofd, char *oe,
+		     char *new, char *new_face, char *nfd, char *ne,
+		     int suffix, int current_line)
+{
+  int od, nd, olen, nlen;
+  int omid, nmid, oi, ni, match, tail, shift, cost;
+  int best_omid, best_nmid, best_shift, best_cost;
+  int row_cols;
+
+  od = ofd - old;
+  nd = nfd - new;
+  olen = oe - ofd;
+  nlen = ne - nfd;
+  if (olen <= 0 || nlen <= 0)
+    return 0;
+
+  row_cols = _rl_last_c_pos + shift_col_width (new, nd, ne - new);
+
+  best_cost = nlen - suffix;
+  best_shift = 0;
+  best_omid = best_nmid = 0;
+  for (nmid = 0, ni = 0; ni <= SHIFT_SEARCH_LIMIT && nmid < nlen; nmid = shift_next_char (new, nd + nmid) - nd, ni++)
+    {
+      /* Every candidate writes at least the new run. */
+      if (nmid >= best_cost)
+	break;
+
+      for (omid = 0, oi = 0; oi <= SHIFT_SEARCH_LIMIT && omid < olen; omid = shift_next_char (old, od + omid) - od, oi++)
+	{
+	  if (omid == nmid)
+	    continue;
+
+	  shift = shift_col_width (new, nd, nd + nmid) - shift_col_width (old, od, od + omid);
+	  if (shift > 0)
+	    {
+	      /* Inserting: the rest of the new line must match the old line,
+		 and whatever is left of the old line must fall off the edge. */
+	      match = nlen - nmid;
+	      if (omid + match > olen ||
+		  (omid + match < olen && row_cols != _rl_screenwidth))
+		continue;
+	      if (!_rl_term_IC && !_rl_term_ic && !_rl_term_im)
+		continue;
+	      tail = 0;
+	    }
+	  else if (shift < 0)
+	    {
+	      /* Deleting: the rest of the old line must match the new line,
+		 followed by a tail of new text written at the end. */
+	      match = olen - omid;
+	      if (nmid + match > nlen)
+		continue;
+	      if (!_rl_term_DC && !_rl_term_dc)
+		continue;
+	      tail = nlen - nmid - match;
+	    }
+	  else
+	    continue;
+
+	  /* Rough cost in bytes:  the terminal sequence, the new run, and for
+	     a deletion a cursor move plus the tail. */
+	  cost = 4 + nmid + (tail ? 4 + tail : 0);
+	  if (cost >= best_cost)
+	    continue;
+
+	  if (memcmp (ofd + omid, nfd + nmid, match) != 0 ||
+	      memcmp (old_face + od + omid, new_face + nd + nmid, match) != 0)
+	    continue;
+
+	  best_cost = cost;
+	  best_shift = shift;
+	  best_omid = omid;
+	  best_nmid = nmid;
+	}
+    }
+
+  if (best_shift == 0)
+    return 0;
+
+  if (best_shift > 0)
+    {
+      open_some_spaces (best_shift);
+      if (best_nmid > 0)
+	{
+	  puts_face (nfd, new_face + nd, best_nmid);
+	  _rl_last_c_pos += shift_col_width (new, nd, nd + best_nmid);
+	}
+    }
+  else
+    {
+      delete_chars (-best_shift);
+      if (best_nmid > 0)
+	{
+	  puts_face (nfd, new_face + nd, best_nmid);
+	  _rl_last_c_pos += shift_col_width (new, nd, nd + best_nmid);
+	}
+
+      /* Write the new tail after the text that moved left. */
+      match = olen - best_omid;
+      tail = nlen - best_nmid - match;
+      if (tail > 0)
+	{
+	  _rl_move_cursor_relative (nd + best_nmid + match, new, new_face);
+	  puts_face (ne - tail, new_face + (ne - new) - tail, tail);
+	  _rl_last_c_pos += shift_col_width (new, (ne - new) - tail, ne - new);
+	}
+    }
+
+  return 1;
+}
+/* end_clink_change */
+
 /* PWP: update_line() is based on finding the middle difference of each
    line on the screen; vis:
 
@@ -2474,6 +2630,28 @@ dumb_update:
     cpos_adjusted = 1;
 #endif
 
+/* begin_clink_change */
+  /* If the rest of the line only shifted, e.g. after typing or deleting
+     earlier in a wrapped line, insert or delete the difference instead of
+     rewriting it.  Avoid lines whose cursor positions involve the invisible
+     characters in the prompt or the padding for a wide character that
+     didn't fit at the end of the line. */
+  if (_rl_horizontal_scroll_mode == 0 &&
+      (current_line == 0
+	? (prompt_last_screen_line == 0 &&
+	   (mb_cur_max > 1 && rl_byte_oriented == 0) &&
+	   current_invis_chars == visible_wrap_offset &&
+	   od > prompt_last_invisible && nd > prompt_last_invisible)
+	: current_line > prompt_last_screen_line) &&
+      (mb_cur_max == 1 || rl_byte_oriented ||
+       current_line + 1 >= line_state_invisible->wbsize ||
+       current_line + 1 >= line_state_visible->wbsize ||
+       (line_state_invisible->wrapped_line[current_line + 1] == 0 &&
+	line_state_visible->wrapped_line[current_line + 1] == 0)) &&
+      update_line_shifted (old, old_face, ofd, oe, new, new_face, nfd, ne, ne - nls, current_line))
+    return;
+/* end_clink_change */
+
   /* if (len (new) > len (old))
      lendiff == difference in buffer (bytes)
      col_lendiff == difference on screen (columns)
@@ -3063,6 +3241,15 @@ _rl_move_cursor_relative (int new, const char *data, const char *dataf)
 	 if it's available. */
       if (mb_cur_max > 1 && rl_byte_oriented == 0)
 	{
+/* begin_clink_change */
+	  /* Jump straight to the column when that's shorter than repeating
+	     the forward motion. */
+	  if (_rl_term_ch &&
+	      (!_rl_term_forward_char ||
+	       (dpos - cpos) * (int)strlen (_rl_term_forward_char) > (int)strlen (tgoto (_rl_term_ch, 0, dpos + 1))))
+	    tputs (tgoto (_rl_term_ch, 0, dpos + 1), 1, _rl_output_character_function);
+	  else
+/* end_clink_change */
 	  if (_rl_term_forward_char)
 	    {
 	      for (i = cpos; i < dpos; i++)
@@ -3084,6 +3271,11 @@ _rl_move_cursor_relative (int new, const char *data, const char *dataf)
      of the string, which means that if NEW == _rl_last_c_pos, then NEW's
      display point is less than _rl_last_c_pos. */
 #endif
+/* begin_clink_change */
+  else if (cpos > dpos && _rl_term_ch && mb_cur_max > 1 && rl_byte_oriented == 0 &&
+	   cpos - dpos > (int)strlen (tgoto (_rl_term_ch, 0, dpos + 1)))
+    tputs (tgoto (_rl_term_ch, 0, dpos + 1), 1, _rl_output_character_function);
+/* end_clink_change */
   else if (cpos > dpos)
     _rl_backspace (cpos - dpos);
 
@@ -3116,6 +3308,11 @@ _rl_move_vert (int to)
       ScreenSetCursor (row + delta, col);
       i = -delta;
 #else
+/* begin_clink_change */
+      if (-delta > 1 && _rl_term_UP && *_rl_term_UP)
+	tputs (tgoto (_rl_term_UP, 0, -delta), 1, _rl_output_character_function);
+      else
+/* end_clink_change */
       if (_rl_term_up && *_rl_term_up)
 	for (i = 0; i < -delta; i++)
 	  tputs (_rl_term_up, 1, _rl_output_character_function);
@@ -75,7 +75,12 @@ static char *get_history_word_specifier PARAMS((char *, char *, int *));
 static int history_tokenize_word PARAMS((const char *, int));
 static char **history_tokenize_internal PARAMS((const char *, int, int *));
 static char *history_substring PARAMS((const char *, int, int));
+/* begin_clink_change */
+#if 0
 static void freewords PARAMS((char **, int));
+#endif
+static int *history_tokenize_bounds PARAMS((const char *, int *));
+/* end_clink_change */
 static char *history_find_word PARAMS((char *, int));
 
 static char *quote_breaks PARAMS((char *));
@@ -126,6 +131,83 @@ static char *search_string;
 /* The last string matched by a !?string? search. */
 static char *search_match;
 
+/* begin_clink_change */
+extern int _rl_search_case_fold;
+
+/* Events found by searching the history are remembered until the history
+   list changes, so that several references to the same event (for example
+   `!cmd:1 !cmd:$') only search the history once. */
+#define EVENT_CACHE_SIZE	4
+
+typedef struct _hist_event
+{
+  char *string;			/* search string; NULL means an empty slot */
+  int substring;		/* nonzero for a !?string? search */
+  int fold;			/* _rl_search_case_fold for the search */
+  int start;			/* history entry where the search started */
+  unsigned int generation;	/* history generation for the search */
+  int which;			/* matching history entry, or -1 for none */
+  char *line;			/* line of the matching history entry */
+  int offset;			/* offset of the match in the line */
+} HIST_EVENT;
+
+static HIST_EVENT event_cache[EVENT_CACHE_SIZE];
+static int event_cache_next;
+
+/* Returns the history entry where a backward search starts. */
+static int
+event_search_start (void)
+{
+  return ((history_offset >= history_length) ? history_length - 1 : history_offset);
+}
+
+static HIST_EVENT *
+find_event (const char *string, int substring)
+{
+  register int i;
+  HIST_EVENT *e;
+  int start;
+  unsigned int generation;
+
+  start = event_search_start ();
+  generation = _hs_history_index_generation ();
+  for (i = 0; i < EVENT_CACHE_SIZE; i++)
+    {
+      e = &event_cache[i];
+      if (e->string == 0 || e->generation != generation || e->start != start ||
+	  e->substring != substring || e->fold != _rl_search_case_fold ||
+	  strcmp (e->string, string) != 0)
+	continue;
+
+      /* Make sure the entry still has the line that was matched. */
+      if (e->which < 0 ||
+	  (e->which < history_length && history_list ()[e->which]->line == e->line))
+	return e;
+    }
+
+  return ((HIST_EVENT *)NULL);
+}
+
+static void
+remember_event (const char *string, int substring, int start, int which, int offset)
+{
+  HIST_EVENT *e;
+
+  e = &event_cache[event_cache_next];
+  event_cache_next = (event_cache_next + 1) % EVENT_CACHE_SIZE;
+
+  FREE (e->string);
+  e->string = savestring (string);
+  e->substring = substring;
+  e->fold = _rl_search_case_fold;
+  e->start = start;
+  e->generation = _hs_history_index_generation ();
+  e->which = which;
+  e->line = (which >= 0) ? history_list ()[which]->line : (char *)NULL;
+  e->offset = offset;
+}
+/* end_clink_change */
+
 /* Return the event specified at TEXT + OFFSET modifying OFFSET to
    point to after the event specifier.  Just a pointer to the history
    line is returned; NULL is returned in the event of a bad specifier.
@@ -145,6 +227,10 @@ get_history_event (const char *string, int *caller_index, int delimiting_quote)
   int which, sign, local_index, substring_okay;
   _hist_search_func_t *search_func;
   char *temp;
+/* begin_clink_change */
+  HIST_EVENT *event;
+  int start;
+/* end_clink_change */
 
   /* The event can be specified in a number of ways.
 
@@ -274,10 +360,33 @@ get_history_event (const char *string, int *caller_index, int delimiting_quote)
         FAIL_SEARCH ();
     }
 
+/* begin_clink_change */
+  event = find_event (temp, substring_okay);
+  if (event && event->which < 0)
+    FAIL_SEARCH ();
+/* end_clink_change */
+
   search_func = substring_okay ? history_search : history_search_prefix;
   while (1)
     {
+/* begin_clink_change */
+#if 0
       local_index = (*search_func) (temp, -1);
+#else
+      if (event)
+	{
+	  history_offset = event->which;
+	  local_index = event->offset;
+	  event = (HIST_EVENT *)NULL;
+	}
+      else
+	{
+	  start = event_search_start ();
+	  local_index = (*search_func) (temp, -1);
+	  remember_event (temp, substring_okay, start, (local_index < 0) ? -1 : history_offset, local_index);
+	}
+#endif
+/* end_clink_change */
 
       if (local_index < 0)
 	FAIL_SEARCH ();
@@ -1403,6 +1512,8 @@ history_arg_extract (int first, int last, const char *string)
   register int i, len;
   char *result;
   int size, offset;
+/* begin_clink_change */
+#if 0
   char **list;
 
   /* XXX - think about making history_tokenize return a struct array,
@@ -1413,6 +1524,15 @@ history_arg_extract (int first, int last, const char *string)
 
   for (len = 0; list[len]; len++)
     ;
+#else
+  int *bounds, count;
+
+  /* Use the word boundaries instead of copying each word into a list. */
+  if ((bounds = history_tokenize_bounds (string, &count)) == NULL)
+    return ((char *)NULL);
+  len = count;
+#endif
+/* end_clink_change */
 
   if (last < 0)
     last = len + last - 1;
@@ -1432,6 +1552,8 @@ history_arg_extract (int first, int last, const char *string)
     result = ((char *)NULL);
   else
     {
+/* begin_clink_change */
+#if 0
       for (size = 0, i = first; i < last; i++)
 	size += strlen (list[i]) + 1;
       result = (char *)xmalloc (size + 1);
@@ -1447,11 +1569,31 @@ history_arg_extract (int first, int last, const char *string)
 	      result[offset] = 0;
 	    }
 	}
+#else
+      for (size = 0, i = first; i < last; i++)
+	size += bounds[2 * i + 1] - bounds[2 * i] + 1;
+      result = (char *)xmalloc (size + 1);
+
+      for (i = first, offset = 0; i < last; i++)
+	{
+	  size = bounds[2 * i + 1] - bounds[2 * i];
+	  memcpy (result + offset, string + bounds[2 * i], size);
+	  offset += size;
+	  if (i + 1 < last)
+	    result[offset++] = ' ';
+	}
+      result[offset] = '\0';
+#endif
+/* end_clink_change */
     }
 
+/* begin_clink_change */
+#if 0
   for (i = 0; i < len; i++)
     xfree (list[i]);
   xfree (list);
+#endif
+/* end_clink_change */
 
   return (result);
 }
@@ -1666,6 +1808,8 @@ history_tokenize (const char *string)
   return (history_tokenize_internal (string, -1, (int *)NULL));
 }
 
+/* begin_clink_change */
+#if 0
 /* Free members of WORDS from START to an empty string */
 static void
 freewords (char **words, int start)
@@ -1675,6 +1819,117 @@ freewords (char **words, int start)
   for (i = start; words[i]; i++)
     xfree (words[i]);
 }
+#endif
+
+/* The word boundaries of recently tokenized lines are remembered, so that
+   extracting several words from the same line (for example `!!:1 !!:$') only
+   tokenizes it once. */
+#define TOKEN_CACHE_SIZE	8
+
+typedef struct _hist_tokens
+{
+  char *line;			/* tokenized line; NULL means an empty slot */
+  int *bounds;			/* start and end offset of each word */
+  int count;			/* number of words */
+  unsigned int used;		/* when it was last used */
+} HIST_TOKENS;
+
+static HIST_TOKENS token_cache[TOKEN_CACHE_SIZE];
+static unsigned int token_cache_clock;
+static char *token_cache_delimiters;
+static int token_cache_comment_char;
+
+static void
+flush_token_cache (void)
+{
+  register int i;
+
+  for (i = 0; i < TOKEN_CACHE_SIZE; i++)
+    {
+      FREE (token_cache[i].line);
+      FREE (token_cache[i].bounds);
+      token_cache[i].line = (char *)NULL;
+      token_cache[i].bounds = (int *)NULL;
+      token_cache[i].count = 0;
+    }
+}
+
+/* Returns the start and end offsets of the words in STRING, which are split
+   the same as by history_tokenize(), and sets *COUNTP to the number of words.
+   Returns NULL if there are no words.  The offsets belong to the cache, and
+   are only valid until the next call. */
+static int *
+history_tokenize_bounds (const char *string, int *countp)
+{
+  register int i;
+  HIST_TOKENS *t, *oldest;
+  int start, count, size;
+  int *bounds;
+
+  /* The words depend on the delimiters and the comment character. */
+  if (token_cache_comment_char != history_comment_char ||
+      (token_cache_delimiters == 0) != (history_word_delimiters == 0) ||
+      (history_word_delimiters && strcmp (token_cache_delimiters, history_word_delimiters) != 0))
+    {
+      flush_token_cache ();
+      FREE (token_cache_delimiters);
+      token_cache_delimiters = history_word_delimiters ? savestring (history_word_delimiters) : (char *)NULL;
+      token_cache_comment_char = history_comment_char;
+    }
+
+  oldest = &token_cache[0];
+  for (i = 0; i < TOKEN_CACHE_SIZE; i++)
+    {
+      t = &token_cache[i];
+      if (t->line && strcmp (t->line, string) == 0)
+	{
+	  t->used = ++token_cache_clock;
+	  *countp = t->count;
+	  return (t->bounds);
+	}
+      if (oldest->line && (t->line == 0 || t->used < oldest->used))
+	oldest = t;
+    }
+
+  /* This is the same as history_tokenize_internal(). */
+  bounds = (int *)NULL;
+  for (i = count = size = 0; string[i]; )
+    {
+      for (; string[i] && fielddelim (string[i]); i++)
+	;
+      if (string[i] == 0 || string[i] == history_comment_char)
+	break;
+
+      start = i;
+
+      i = history_tokenize_word (string, start);
+
+      if (i == start && history_word_delimiters)
+	{
+	  i++;
+	  while (string[i] && member (string[i], history_word_delimiters))
+	    i++;
+	}
+
+      if (2 * count + 2 > size)
+	bounds = (int *)xrealloc (bounds, (size += 20) * sizeof (int));
+
+      bounds[2 * count] = start;
+      bounds[2 * count + 1] = i;
+      count++;
+    }
+
+  FREE (oldest->line);
+  FREE (oldest->bounds);
+  oldest->line = savestring (string);
+  oldest->bounds = bounds;
+  oldest->count = count;
+  oldest->used = ++token_cache_clock;
+
+  *countp = count;
+  return (bounds);
+}
+/* end_clink_change */
 
 /* Find and return the word which contains the character at index IND
    in the history line LINE.  Used to save the word matched by the
@@ -1682,6 +1937,8 @@ freewords (char **words, int start)
 static char *
 history_find_word (char *line, int ind)
 {
+/* begin_clink_change */
+#if 0
   char **words, *s;
   int i, wind;
 
@@ -1699,4 +1956,15 @@ history_find_word (char *line, int ind)
   freewords (words, wind + 1);
   xfree (words);
   return s;
+#else
+  int *bounds;
+  int i, count;
+
+  bounds = history_tokenize_bounds (line, &count);
+  for (i = 0; i < count; i++)
+    if (ind >= bounds[2 * i] && ind < bounds[2 * i + 1])
+      return (history_substring (line, bounds[2 * i], bounds[2 * i + 1]));
+  return ((char *)NULL);
+#endif
+/* end_clink_change */
 }
@@ -82,4 +82,17 @@ extern char *strchr ();
 /* histsearch.c */
 extern int _hs_history_patsearch PARAMS((const char *, int, int));
 
+/* begin_clink_change */
+/* history.c */
+extern void _hs_replace_history_line PARAMS((HIST_ENTRY *, char *));
+
+/* history_index.c */
+extern void _hs_history_index_add PARAMS((const char *));
+extern void _hs_history_index_remove PARAMS((int, int));
+extern void _hs_history_index_replace PARAMS((int));
+extern void _hs_history_index_invalidate PARAMS((void));
+extern int _hs_history_index_next PARAMS((const char *, int, int, int, int));
+extern unsigned int _hs_history_index_generation PARAMS((void));
+/* end_clink_change */
+
 #endif /* !_HISTLIB_H_ */
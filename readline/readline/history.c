@@ -62,6 +62,32 @@ extern int errno;
 /* The number of slots to increase the_history by. */
 #define DEFAULT_HISTORY_GROW_SIZE 50
 
+/* begin_clink_change */
+/* Entries added by add_history_batch() are carved out of large blocks rather
+   than allocated one at a time.  A block is freed when its last entry is. */
+typedef struct _hist_block {
+  struct _hist_block *next;
+  char *end;			/* end of the block */
+  char *avail;			/* next unused byte */
+  char *timestamp;		/* shared by the block's entries */
+  int live;			/* number of entries not yet freed */
+} HIST_BLOCK;
+
+#define HIST_ALIGN(n)		(((n) + sizeof (void *) - 1) & ~(sizeof (void *) - 1))
+#define HIST_BLOCK_MIN_SIZE	(64 * 1024)
+#define HIST_BLOCK_MAX_SIZE	(4 * 1024 * 1024)
+
+static HIST_BLOCK *hist_blocks;
+static HIST_BLOCK *hist_batch_block;
+static char *hist_batch_timestamp;
+static size_t hist_block_size = HIST_BLOCK_MIN_SIZE;
+
+static int hist_append_slot PARAMS((void));
+static void hist_reserve PARAMS((int));
+static HIST_BLOCK *hist_find_block PARAMS((const void *));
+static void hist_release_block PARAMS((HIST_BLOCK *));
+/* end_clink_change */
+
 static char *hist_inittime PARAMS((void));
 
 /* **************************************************************** */
@@ -131,6 +157,7 @@ history_set_history_state (HISTORY_STATE *state)
     history_stifled = 1;
 /* begin_clink_change */
   history_prev_use_curr = 0;
+  _hs_history_index_invalidate ();
 /* end_clink_change */
 }
 
@@ -281,12 +308,34 @@ hist_inittime (void)
   return ret;
 }
 
-/* Place STRING at the end of the history list.  The data field
-   is  set to NULL. */
-void
-add_history (const char *string)
+/* begin_clink_change */
+/* Make sure the_history has room for COUNT entries plus the trailing NULL. */
+static void
+hist_reserve (int count)
+{
+  if (count < history_size)
+    return;
+
+  if (history_size == 0)
+    {
+      history_size = count + 1;
+      the_history = (HIST_ENTRY **)xmalloc (history_size * sizeof (HIST_ENTRY *));
+      the_history[0] = (HIST_ENTRY *)NULL;
+    }
+  else
+    {
+      history_size = count + 1;
+      the_history = (HIST_ENTRY **)
+	xrealloc (the_history, history_size * sizeof (HIST_ENTRY *));
+    }
+}
+
+/* Make room for one more entry at the end of the history list, dropping the
+   oldest entry if the history is stifled.  Returns the new length, or -1 if
+   nothing can be saved. */
+static int
+hist_append_slot (void)
 {
-  HIST_ENTRY *temp;
   int new_length;
 
   if (history_stifled && (history_length == history_max_entries))
@@ -296,7 +345,7 @@ add_history (const char *string)
       /* If the history is stifled, and history_length is zero,
 	 and it equals history_max_entries, we don't save items. */
       if (history_length == 0)
-	return;
+	return -1;
 
       /* If there is something in the slot, then remove it. */
       if (the_history[0])
@@ -305,6 +354,7 @@ add_history (const char *string)
       /* Copy the rest of the entries, moving down one slot.  Copy includes
 	 trailing NULL.  */
       memmove (the_history, the_history + 1, history_length * sizeof (HIST_ENTRY *));
+      _hs_history_index_remove (0, 1);
 
       new_length = history_length;
       history_base++;
@@ -324,23 +374,179 @@ add_history (const char *string)
 	}
       else
 	{
+	  /* Grow geometrically, so that adding N entries costs O(N) copying
+	     instead of O(N^2). */
 	  if (history_length == (history_size - 1))
-	    {
-	      history_size += DEFAULT_HISTORY_GROW_SIZE;
-	      the_history = (HIST_ENTRY **)
-		xrealloc (the_history, history_size * sizeof (HIST_ENTRY *));
-	    }
+	    hist_reserve (history_length + ((history_size > DEFAULT_HISTORY_GROW_SIZE * 2)
+					    ? history_size / 2
+					    : DEFAULT_HISTORY_GROW_SIZE));
 	  new_length = history_length + 1;
 	}
     }
 
+  return new_length;
+}
+
+/* Place STRING at the end of the history list.  The data field
+   is  set to NULL. */
+void
+add_history (const char *string)
+{
+  HIST_ENTRY *temp;
+  int new_length;
+
+  new_length = hist_append_slot ();
+  if (new_length < 0)
+    return;
+
   temp = alloc_history_entry ((char *)string, hist_inittime ());
 
   the_history[new_length] = (HIST_ENTRY *)NULL;
   the_history[new_length - 1] = temp;
   history_length = new_length;
+  _hs_history_index_add (temp->line);
 }
 
+/* Prepare to add about COUNT entries totalling about BYTES bytes of text with
+   add_history_batch().  The history list is sized for them up front, and the
+   entries are carved out of one block when the hints are accurate.  Either
+   hint may be 0 if it is unknown. */
+void
+begin_history_batch (int count, size_t bytes)
+{
+  size_t need;
+
+  end_history_batch ();
+
+  if (count > 0 && !history_stifled)
+    hist_reserve (history_length + count);
+
+  need = bytes + (size_t)count * (HIST_ALIGN (sizeof (HIST_ENTRY)) + sizeof (void *));
+  hist_block_size = (need > HIST_BLOCK_MIN_SIZE) ? need : HIST_BLOCK_MIN_SIZE;
+
+  hist_batch_timestamp = hist_inittime ();
+}
+
+/* Place the first LEN bytes of STRING at the end of the history list. */
+void
+add_history_batch (const char *string, int len)
+{
+  HIST_BLOCK *block;
+  HIST_ENTRY *temp;
+  size_t need, size, ts_len;
+  int new_length;
+
+  new_length = hist_append_slot ();
+  if (new_length < 0)
+    return;
+
+  if (hist_batch_timestamp == 0)
+    hist_batch_timestamp = hist_inittime ();
+
+  need = HIST_ALIGN (sizeof (HIST_ENTRY)) + HIST_ALIGN (len + 1);
+  block = hist_batch_block;
+  if (block == 0 || (size_t)(block->end - block->avail) < need)
+    {
+      /* Start a new block; each one is twice the size of the previous one, up
+	 to a limit, unless begin_history_batch() asked for more. */
+      ts_len = HIST_ALIGN (strlen (hist_batch_timestamp) + 1);
+      size = HIST_ALIGN (sizeof (HIST_BLOCK)) + ts_len + need;
+      if (size < hist_block_size)
+	size = hist_block_size;
+      hist_block_size = (size < HIST_BLOCK_MAX_SIZE / 2) ? size * 2 : HIST_BLOCK_MAX_SIZE;
+
+      hist_batch_block = (HIST_BLOCK *)xmalloc (size);
+      if (block && block->live == 0)
+	hist_release_block (block);
+      block = hist_batch_block;
+
+      block->next = hist_blocks;
+      block->end = (char *)block + size;
+      block->timestamp = (char *)block + HIST_ALIGN (sizeof (HIST_BLOCK));
+      block->avail = block->timestamp + ts_len;
+      block->live = 0;
+      strcpy (block->timestamp, hist_batch_timestamp);
+      hist_blocks = block;
+    }
+
+  temp = (HIST_ENTRY *)block->avail;
+  temp->line = block->avail + HIST_ALIGN (sizeof (HIST_ENTRY));
+  temp->data = (char *)NULL;
+  temp->timestamp = block->timestamp;
+  memcpy (temp->line, string, len);
+  temp->line[len] = '\0';
+  block->avail += need;
+  block->live++;
+
+  the_history[new_length] = (HIST_ENTRY *)NULL;
+  the_history[new_length - 1] = temp;
+  history_length = new_length;
+  _hs_history_index_add (temp->line);
+}
+
+/* Replace the line of history entry HIST with LINE, which must have been
+   allocated with xmalloc; HIST takes ownership of it. */
+void
+_hs_replace_history_line (HIST_ENTRY *hist, char *line)
+{
+  if (hist_find_block (hist->line) == 0)
+    FREE (hist->line);
+  hist->line = line;
+  _hs_history_index_invalidate ();
+}
+
+/* Finish adding entries with add_history_batch(). */
+void
+end_history_batch (void)
+{
+  HIST_BLOCK *block;
+
+  block = hist_batch_block;
+  hist_batch_block = (HIST_BLOCK *)NULL;
+  if (block && block->live == 0)
+    hist_release_block (block);
+
+  FREE (hist_batch_timestamp);
+  hist_batch_timestamp = (char *)NULL;
+  hist_block_size = HIST_BLOCK_MIN_SIZE;
+}
+
+/* Return the block that P points into, or NULL if P was allocated on its
+   own.  There are only a few blocks, since they grow geometrically. */
+static HIST_BLOCK *
+hist_find_block (const void *p)
+{
+  HIST_BLOCK *block;
+
+  for (block = hist_blocks; block; block = block->next)
+    if ((const char *)p > (const char *)block && (const char *)p < block->end)
+      return block;
+
+  return (HIST_BLOCK *)NULL;
+}
+
+/* Release one entry from BLOCK, freeing the block after its last entry. */
+static void
+hist_release_block (HIST_BLOCK *block)
+{
+  HIST_BLOCK **link;
+
+  if (block->live > 0)
+    block->live--;
+  if (block->live > 0 || block == hist_batch_block)
+    return;
+
+  for (link = &hist_blocks; *link; link = &(*link)->next)
+    if (*link == block)
+      {
+	*link = block->next;
+	break;
+      }
+
+  xfree (block);
+}
+/* end_clink_change */
+
 /* Change the time stamp of the most recent history entry to STRING. */
 void
 add_history_time (const char *string)
@@ -350,6 +556,9 @@ add_history_time (const char *string)
   if (string == 0 || history_length < 1)
     return;
   hs = the_history[history_length - 1];
+/* begin_clink_change */
+  if (hist_find_block (hs->timestamp) == 0)
+/* end_clink_change */
   FREE (hs->timestamp);
   hs->timestamp = savestring (string);
 }
@@ -360,9 +569,27 @@ histdata_t
 free_history_entry (HIST_ENTRY *hist)
 {
   histdata_t x;
+/* begin_clink_change */
+  HIST_BLOCK *block;
+/* end_clink_change */
 
   if (hist == 0)
     return ((histdata_t) 0);
+/* begin_clink_change */
+  block = hist_find_block (hist);
+  if (block)
+    {
+      /* The line or timestamp may have been replaced by separately allocated
+	 strings. */
+      if (hist_find_block (hist->line) != block)
+	FREE (hist->line);
+      if (hist_find_block (hist->timestamp) != block)
+	FREE (hist->timestamp);
+      x = hist->data;
+      hist_release_block (block);
+      return (x);
+    }
+/* end_clink_change */
   FREE (hist->line);
   FREE (hist->timestamp);
   x = hist->data;
@@ -407,6 +634,9 @@ replace_history_entry (int which, const char *line, histdata_t data)
   temp->data = data;
   temp->timestamp = savestring (old_value->timestamp);
   the_history[which] = temp;
+/* begin_clink_change */
+  _hs_history_index_replace (which);
+/* end_clink_change */
 
   return (old_value);
 }
@@ -435,12 +665,24 @@ _hs_append_history_line (int which, const char *line)
     newlen = minlen;
   /* Assume that realloc returns the same pointer and doesn't try a new
      alloc/copy if the new size is the same as the one last passed. */
+/* begin_clink_change */
+  if (hist_find_block (hent->line))
+    {
+      newline = malloc (newlen);
+      if (newline)
+	memcpy (newline, hent->line, curlen + 1);
+    }
+  else
+/* end_clink_change */
   newline = realloc (hent->line, newlen);
   if (newline)
     {
       hent->line = newline;
       hent->line[curlen++] = '\n';
       strcpy (hent->line + curlen, line);
+/* begin_clink_change */
+      _hs_history_index_replace (which);
+/* end_clink_change */
     }
 }
 
@@ -518,6 +760,9 @@ remove_history (int which)
 #endif
 
   history_length--;
+/* begin_clink_change */
+  _hs_history_index_remove (which, 1);
+/* end_clink_change */
 
   return (return_value);
 }
@@ -554,6 +799,9 @@ remove_history_range (int first, int last)
   memmove (start, end, (history_length - last) * sizeof (HIST_ENTRY *));
 
   history_length -= nentries;
+/* begin_clink_change */
+  _hs_history_index_remove (first, nentries);
+/* end_clink_change */
 
   return (return_value);
 }
@@ -578,6 +826,9 @@ stifle_history (int max)
 	the_history[j] = the_history[i];
       the_history[j] = (HIST_ENTRY *)NULL;
       history_length = j;
+/* begin_clink_change */
+      _hs_history_index_invalidate ();
+/* end_clink_change */
     }
 
   history_stifled = 1;
@@ -619,4 +870,7 @@ clear_history (void)
 
   history_offset = history_length = 0;
   history_base = 1;		/* reset history base to default */
+/* begin_clink_change */
+  _hs_history_index_invalidate ();
+/* end_clink_change */
 }
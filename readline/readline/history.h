@@ -86,6 +86,16 @@ extern void add_history PARAMS((const char *));
    STRING. */
 extern void add_history_time PARAMS((const char *));
 
+/* begin_clink_change */
+/* Add many entries at once:  call begin_history_batch() with the expected
+   number of entries and bytes of text (either may be 0 if unknown), then
+   add_history_batch() for each line, then end_history_batch().  The history
+   list is sized up front and entries are allocated from large blocks. */
+extern void begin_history_batch PARAMS((int, size_t));
+extern void add_history_batch PARAMS((const char *, int));
+extern void end_history_batch PARAMS((void));
+/* end_clink_change */
+
 /* Remove an entry from the history list.  WHICH is the magic number that
    tells us which element to delete.  The elements are numbered from 0. */
 extern HIST_ENTRY *remove_history PARAMS((int));
@@ -110,6 +110,16 @@ history_search_internal (const char *string, int direction, int flags)
       if ((reverse && i < 0) || (!reverse && i == history_length))
 	return (-1);
 
+/* begin_clink_change */
+      /* Skip to the next line that can contain STRING. */
+      if (patsearch == 0)
+	{
+	  i = _hs_history_index_next (string, string_len, anchored == ANCHORED_SEARCH, i, reverse ? -1 : 1);
+	  if (i < 0)
+	    return (-1);
+	}
+/* end_clink_change */
+
       line = the_history[i]->line;
       line_index = strlen (line);
 
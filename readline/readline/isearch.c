@@ -82,6 +82,25 @@ static char * const default_isearch_terminators = "\033\012";
 extern int find_streqn (const char *a, const char *b, int n);
 #undef STREQN
 #define STREQN(a, b, n) (find_streqn(a, b, n))
+
+extern int _hs_history_index_next (const char *, int, int, int, int);
+
+/* Skip to the next history line that can contain the search string.  The
+   last line is the current input line, which isn't in the history index. */
+static int
+next_isearch_line (_rl_search_cxt *cxt)
+{
+  int pos;
+
+  pos = cxt->history_pos;
+  if (pos < 0 || pos >= cxt->hlen - 1 || cxt->hlen - 1 != history_length)
+    return pos;
+
+  pos = _hs_history_index_next (cxt->search_string, cxt->search_string_index, 0, pos, cxt->direction);
+  if (pos < 0)
+    pos = (cxt->sflags & SF_REVERSE) ? -1 : cxt->hlen - 1;
+  return pos;
+}
 /* end_clink_change */
 
 _rl_search_cxt *
@@ -774,6 +793,9 @@ opcode_dispatch:
 	{
 	  /* Move to the next line. */
 	  cxt->history_pos += cxt->direction;
+/* begin_clink_change */
+	  cxt->history_pos = next_isearch_line (cxt);
+/* end_clink_change */
 
 	  /* At limit for direction? */
 	  if ((cxt->sflags & SF_REVERSE) ? (cxt->history_pos < 0) : (cxt->history_pos == cxt->hlen))
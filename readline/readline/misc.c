@@ -332,10 +332,17 @@ _rl_free_history_entry (HIST_ENTRY *entry)
   if (entry == 0)
     return;
 
+/* begin_clink_change */
+#if 0
   FREE (entry->line);
   FREE (entry->timestamp);
 
   xfree (entry);
+#else
+  /* Entries may have been added by add_history_batch(). */
+  free_history_entry (entry);
+#endif
+/* end_clink_change */
 }
 
 /* Perhaps put back the current line if it has changed. */
@@ -349,9 +356,15 @@ rl_maybe_replace_line (void)
   if (temp && ((UNDO_LIST *)(temp->data) != rl_undo_list))
     {
       temp = replace_history_entry (where_history (), rl_line_buffer, (histdata_t)rl_undo_list);
+/* begin_clink_change */
+#if 0
       xfree (temp->line);
       FREE (temp->timestamp);
       xfree (temp);
+#else
+      free_history_entry (temp);
+#endif
+/* end_clink_change */
     }
   return 0;
 }
@@ -470,8 +483,14 @@ _rl_revert_previous_lines (void)
 	    rl_do_undo ();
 	  /* And copy the reverted line back to the history entry, preserving
 	     the timestamp. */
+/* begin_clink_change */
+#if 0
 	  FREE (entry->line);
 	  entry->line = savestring (rl_line_buffer);
+#else
+	  _hs_replace_history_line (entry, savestring (rl_line_buffer));
+#endif
+/* end_clink_change */
 	}
       entry = previous_history ();
     }
@@ -533,6 +552,7 @@ rl_clear_history (void)
 
 /* begin_clink_change */
   history_prev_use_curr = 0;
+  _hs_history_index_invalidate ();
 /* end_clink_change */
 }
 
@@ -607,6 +607,7 @@ extern char *_rl_term_IC;
 extern char *_rl_term_forward_char;
 /* begin_clink_change */
 extern char *_rl_term_ch;
+extern char *_rl_term_UP;
 /* end_clink_change */
 extern int _rl_screenheight;
 extern int _rl_screenwidth;
@@ -154,7 +154,7 @@ find_streqn (const char *a, const char *b, int len)
 	  if (wc1 != wc2)
 	    return 0;
 	  a += v1;
-	  b += v1;
+	  b += v2;
 	  len -= v1;
 	  lenb -= v2;
 	}
@@ -158,6 +158,10 @@ char *_rl_term_ch;
 
 /* How to go up a line. */
 char *_rl_term_up;
+/* begin_clink_change */
+/* How to go up several lines at once. */
+char *_rl_term_UP;
+/* end_clink_change */
 
 /* A visible bell; char if the terminal can be made to flash the screen. */
 static char *_rl_visible_bell;
@@ -432,6 +436,9 @@ static const struct _tc_string tc_strings[] =
   { "DC", &_rl_term_DC },
   { "E3", &_rl_term_clrscroll },
   { "IC", &_rl_term_IC },
+/* begin_clink_change */
+  { "UP", &_rl_term_UP },
+/* end_clink_change */
   { "ce", &_rl_term_clreol },
 /* begin_clink_change */
   { "ch", &_rl_term_ch },
@@ -499,6 +506,9 @@ _rl_init_terminal_io (const char *terminal_name)
 
 #ifdef __MSDOS__
   _rl_term_im = _rl_term_ei = _rl_term_ic = _rl_term_IC = (char *)NULL;
+/* begin_clink_change */
+  _rl_term_UP = (char *)NULL;
+/* end_clink_change */
   _rl_term_up = _rl_term_dc = _rl_term_DC = _rl_visible_bell = (char *)NULL;
   _rl_term_ku = _rl_term_kd = _rl_term_kl = _rl_term_kr = (char *)NULL;
   _rl_term_mm = _rl_term_mo = (char *)NULL;
@@ -566,6 +576,9 @@ _rl_init_terminal_io (const char *terminal_name)
       _rl_screenchars = _rl_screenwidth * _rl_screenheight;
       _rl_term_cr = "\r";
       _rl_term_im = _rl_term_ei = _rl_term_ic = _rl_term_IC = (char *)NULL;
+/* begin_clink_change */
+      _rl_term_UP = (char *)NULL;
+/* end_clink_change */
       _rl_term_up = _rl_term_dc = _rl_term_DC = _rl_visible_bell = (char *)NULL;
       _rl_term_ku = _rl_term_kd = _rl_term_kl = _rl_term_kr = (char *)NULL;
       _rl_term_kh = _rl_term_kH = _rl_term_kI = _rl_term_kD = (char *)NULL;